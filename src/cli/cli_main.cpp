@@ -13,6 +13,7 @@
 #include <script/functions/functions.hpp>
 #include <script/profiler.hpp>
 #include <data/format/formats.hpp>
+#include <gfx/image_pool.hpp>
 #include <wx/process.h>
 
 DECLARE_TYPEOF_COLLECTION(ScriptParseError);
@@ -56,6 +57,8 @@ void CLISetInterface::onBeforeChangeSet() {
 }
 
 void CLISetInterface::onChangeSet() {
+  // scripts can use all cards, so they should be up to date
+  if (set) set->updateDelayed();
   Context& ctx = getContext();
   scope = ctx.openScope();
   ei.set = set;
@@ -114,6 +117,7 @@ void CLISetInterface::showUsage() {
   cli << _("   :pwd                Print the current working directory.\n");
   cli << _("   :cd                 Change the working directory.\n");
   cli << _("   :! <command>        Perform a shell command.\n");
+  cli << _("   :images             Show statistics of the decoded image pool.\n");
   cli << _("\n Commands can be abreviated to their first letter if there is no ambiguity.\n\n");
 }
 
@@ -163,6 +167,12 @@ void CLISetInterface::handleCommand(const String& command) {
             setExportInfoCwd();
           }
         }
+      } else if (before == _(":images")) {
+        ImagePoolStats stats = image_pool.stats();
+        cli << String::Format(_("images:   %d"), (int)stats.entries) << ENDL;
+        cli << String::Format(_("memory:   %.1f / %.1f MB"), stats.bytes / 1048576.0, stats.max_bytes / 1048576.0) << ENDL;
+        cli << String::Format(_("hits:     %d"), (int)stats.hits) << ENDL;
+        cli << String::Format(_("decoded:  %d"), (int)stats.misses) << ENDL;
       } else if (before == _(":pwd") || before == _(":p")) {
         cli << ei.directory_absolute << ENDL;
       } else if (before == _(":!")) {
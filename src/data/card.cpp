@@ -91,3 +91,27 @@ IMPLEMENT_REFLECTION(Card) {
   REFLECT(extra_data); // don't allow scripts to depend on style specific data
   REFLECT_NAMELESS(data);
 }
+
+/// The cards to write with Writer::writeParallel
+struct CardsToWrite {
+  const vector<CardP>* cards;
+  Game*                game;       ///< game_for_reading
+  StyleSheet*          stylesheet; ///< stylesheet_for_reading, used for the styling data of cards
+  vector<vector<WrittenKey> >* card_keys; ///< The keys written for each card are recorded here, if not nullptr
+};
+
+void write_card(Writer& writer, const Char* key, const void* items, size_t i) {
+  const CardsToWrite& to_write = *static_cast<const CardsToWrite*>(items);
+  WITH_DYNAMIC_ARG(game_for_reading,       to_write.game);
+  WITH_DYNAMIC_ARG(stylesheet_for_reading, to_write.stylesheet);
+  if (to_write.card_keys) writer.recordKeys(&(*to_write.card_keys)[i]);
+  writer.handle(key, (*to_write.cards)[i]);
+  writer.recordKeys(nullptr);
+}
+
+void Writer::handle(const Char* name, const vector<CardP>& cards, vector<vector<WrittenKey> >* card_keys) {
+  // cards don't depend on each other, so they can be written in parallel
+  if (card_keys) card_keys->assign(cards.size(), vector<WrittenKey>());
+  CardsToWrite to_write = { &cards, game_for_reading(), stylesheet_for_reading(), card_keys };
+  writeParallel(name, &to_write, cards.size(), write_card);
+}
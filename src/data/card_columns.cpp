@@ -0,0 +1,296 @@
+//+----------------------------------------------------------------------------+
+//| Description:  Magic Set Editor - Program to make Magic (tm) cards          |
+//| Copyright:    (C) 2001 - 2017 Twan van Laarhoven and Sean Hunt             |
+//| License:      GNU General Public License 2 or later (see file COPYING)     |
+//+----------------------------------------------------------------------------+
+
+// ----------------------------------------------------------------------------- : Includes
+
+#include <util/prec.hpp>
+#include <data/card_columns.hpp>
+#include <data/set.hpp>
+#include <data/game.hpp>
+#include <data/stylesheet.hpp>
+#include <data/card.hpp>
+#include <data/field.hpp>
+
+// ----------------------------------------------------------------------------- : File format
+
+/// Name of the cache file in the set package
+const Char* card_columns_file = _("set.cache");
+/// Start of the cache file
+const char  card_columns_magic[] = "MSE card columns";
+/// Version of the file format, change it when the format changes
+const UInt  card_columns_format = 2;
+
+/// Read everything from an input stream
+void read_all(wxInputStream& input, std::string& out) {
+  vector<char> buffer(64 * 1024);
+  while (true) {
+    input.Read(&buffer[0], buffer.size());
+    size_t size = input.LastRead();
+    if (size == 0) break;
+    out.append(&buffer[0], size);
+  }
+}
+
+void put_uint(std::string& out, UInt x) {
+  for (int i = 0 ; i < 4 ; ++i) {
+    out += (char)((x >> (8 * i)) & 0xFF);
+  }
+}
+void put_bytes(std::string& out, const std::string& bytes) {
+  put_uint(out, (UInt)bytes.size());
+  out += bytes;
+}
+void put_string(std::string& out, const String& str) {
+  wxCharBuffer utf8 = str.ToUTF8();
+  put_uint(out, (UInt)utf8.length());
+  out.append(utf8.data(), utf8.length());
+}
+
+/// Reads the cache file, instead of throwing errors it remembers that something was wrong
+class ColumnInput {
+  public:
+  ColumnInput(const std::string& data)
+    : ok(true), pos(data.data()), end(data.data() + data.size())
+  {}
+
+  bool ok; ///< Was everything read correctly?
+
+  /// Are there at least the given number of bytes left?
+  bool has(size_t bytes) {
+    if ((size_t)(end - pos) < bytes) ok = false;
+    return ok;
+  }
+  UInt getUInt() {
+    if (!has(4)) return 0;
+    UInt x = 0;
+    for (int i = 0 ; i < 4 ; ++i) {
+      x |= (UInt)(Byte)pos[i] << (8 * i);
+    }
+    pos += 4;
+    return x;
+  }
+  void getBytes(std::string& out) {
+    UInt size = getUInt();
+    if (!has(size)) return;
+    out.assign(pos, size);
+    pos += size;
+  }
+  String getString() {
+    UInt size = getUInt();
+    if (!has(size)) return String();
+    String out = wxString::FromUTF8(pos, size);
+    pos += size;
+    return out;
+  }
+  /// Check that the data starts with the given bytes
+  void expect(const char* data, size_t size) {
+    if (has(size) && memcmp(pos, data, size) != 0) ok = false;
+    pos += ok ? size : 0;
+  }
+
+  private:
+  const char* pos;
+  const char* end;
+};
+
+// ----------------------------------------------------------------------------- : Keys
+
+/// What the values in a column are read into
+enum ColumnTarget
+{  TARGET_NONE
+,  TARGET_NOTES
+,  TARGET_TIME_CREATED
+,  TARGET_TIME_MODIFIED
+,  TARGET_FIELD
+};
+
+/// What the values of a key of cards are read into, for TARGET_FIELD also sets the index of the field
+/** These are the keys that Card reads as a single value that nothing else depends on */
+ColumnTarget column_target(const Game& game, const String& key, size_t& field) {
+  if (cannocial_name_compare(key, _("notes")))         return TARGET_NOTES;
+  if (cannocial_name_compare(key, _("time_created")))  return TARGET_TIME_CREATED;
+  if (cannocial_name_compare(key, _("time_modified"))) return TARGET_TIME_MODIFIED;
+  for (size_t i = 0 ; i < game.card_fields.size() ; ++i) {
+    if (cannocial_name_compare(key, game.card_fields[i]->name.c_str())) {
+      field = i;
+      return TARGET_FIELD;
+    }
+  }
+  return TARGET_NONE;
+}
+
+// ----------------------------------------------------------------------------- : CardColumns
+
+String CardColumns::setVersions(const Set& set) {
+  if (!set.game || !set.stylesheet) return String();
+  return app_version.toString()
+       + _("\n") + set.game->relativeFilename()       + _(" ") + set.game->version.toString()
+       + _("\n") + set.stylesheet->relativeFilename() + _(" ") + set.stylesheet->version.toString();
+}
+
+bool CardColumns::build(const Set& set, const vector<vector<WrittenKey> >& card_keys, size_t text_size, UInt text_crc) {
+  columns.clear();
+  rest.assign(card_keys.size(), std::string());
+  versions = setVersions(set);
+  if (versions.empty() || card_keys.size() != set.cards.size()) return false;
+  this->text_size = text_size;
+  this->text_crc  = text_crc;
+  map<String,size_t>        column_of;   // column for each key, or npos if the key is not stored in a column
+  vector<map<String,UInt> > value_index; // index of each value in the column
+  for (size_t card = 0 ; card < card_keys.size() ; ++card) {
+    const vector<WrittenKey>& keys = card_keys[card];
+    for (size_t i = 0 ; i < keys.size() ; ++i) {
+      const WrittenKey& key = keys[i];
+      map<String,size_t>::iterator it = column_of.find(key.key);
+      if (it == column_of.end()) {
+        size_t field;
+        bool is_column = column_target(*set.game, key.key, field) != TARGET_NONE;
+        it = column_of.insert(make_pair(key.key, is_column ? columns.size() : String::npos)).first;
+        if (is_column) {
+          columns.push_back(Column());
+          columns.back().key = key.key;
+          value_index.push_back(map<String,UInt>());
+        }
+      }
+      size_t c = it->second;
+      if (c == String::npos || !key.simple || (card < columns[c].cells.size() && columns[c].cells[card])) {
+        // not stored in a column, a key with child keys, or a key that appears twice, which are left to the text reader
+        rest[card] += key.text;
+        continue;
+      }
+      Column& column = columns[c];
+      map<String,UInt>::iterator v = value_index[c].find(key.value);
+      if (v == value_index[c].end()) {
+        v = value_index[c].insert(make_pair(key.value, (UInt)column.values.size())).first;
+        column.values.push_back(key.value);
+      }
+      column.cells.resize(card + 1, 0);
+      column.cells[card] = v->second + 1;
+    }
+  }
+  for (size_t c = 0 ; c < columns.size() ; ++c) {
+    columns[c].cells.resize(size(), 0);
+  }
+  return true;
+}
+
+void CardColumns::write(Set& set) const {
+  std::string out;
+  out.append(card_columns_magic, sizeof(card_columns_magic) - 1);
+  put_uint(out, card_columns_format);
+  put_uint(out, (UInt)text_size);
+  put_uint(out, text_crc);
+  put_string(out, versions);
+  put_uint(out, (UInt)size());
+  for (size_t i = 0 ; i < size() ; ++i) {
+    put_bytes(out, rest[i]);
+  }
+  put_uint(out, (UInt)columns.size());
+  for (size_t c = 0 ; c < columns.size() ; ++c) {
+    const Column& column = columns[c];
+    put_string(out, column.key);
+    put_uint(out, (UInt)column.values.size());
+    for (size_t v = 0 ; v < column.values.size() ; ++v) {
+      put_string(out, column.values[v]);
+    }
+    for (size_t i = 0 ; i < size() ; ++i) {
+      put_uint(out, column.cells[i]);
+    }
+  }
+  set.openOut(card_columns_file)->Write(out.data(), out.size());
+  set.referenceFile(card_columns_file);
+}
+
+bool CardColumns::read(Set& set) {
+  // is there a cache for this set file?
+  size_t set_size;
+  UInt   set_crc;
+  if (!set.zipChecksum(set.typeName(), set_size, set_crc)) return false;
+  if (set.getFileInfos().find(card_columns_file) == set.getFileInfos().end()) return false;
+  String set_versions = setVersions(set);
+  if (set_versions.empty()) return false;
+  // read it all at once, and then take it apart
+  std::string data;
+  read_all(*set.openIn(card_columns_file), data);
+  ColumnInput in(data);
+  in.expect(card_columns_magic, sizeof(card_columns_magic) - 1);
+  if (in.getUInt() != card_columns_format) return false;
+  text_size = in.getUInt();
+  text_crc  = in.getUInt();
+  versions  = in.getString();
+  if (!in.ok || text_size != set_size || text_crc != set_crc || versions != set_versions) return false;
+  // cards
+  UInt cards = in.getUInt();
+  if (!in.has(cards)) return false;
+  rest.resize(cards);
+  for (UInt i = 0 ; i < cards && in.ok ; ++i) {
+    in.getBytes(rest[i]);
+  }
+  // columns
+  UInt column_count = in.getUInt();
+  if (!in.has(column_count)) return false;
+  columns.resize(column_count);
+  for (UInt c = 0 ; c < column_count && in.ok ; ++c) {
+    Column& column = columns[c];
+    column.key = in.getString();
+    UInt value_count = in.getUInt();
+    if (!in.has(value_count)) break;
+    column.values.resize(value_count);
+    for (UInt v = 0 ; v < value_count && in.ok ; ++v) {
+      column.values[v] = in.getString();
+    }
+    if (!in.has(4 * (size_t)cards)) break;
+    column.cells.resize(cards);
+    for (UInt i = 0 ; i < cards ; ++i) {
+      column.cells[i] = in.getUInt();
+      if (column.cells[i] > value_count) in.ok = false;
+    }
+  }
+  return in.ok;
+}
+
+bool CardColumns::readCards(Reader& reader, const Game& game, const deque<ReaderBlock>& blocks, vector<CardP>& cards) const {
+  // what each column is read into, the fields of the game could have changed without a new version
+  vector<ColumnTarget> targets(columns.size());
+  vector<size_t>       fields (columns.size());
+  for (size_t c = 0 ; c < columns.size() ; ++c) {
+    targets[c] = column_target(game, columns[c].key, fields[c]);
+    if (targets[c] == TARGET_NONE) return false;
+  }
+  cards.resize(size());
+  for (size_t i = 0 ; i < size() ; ++i) {
+    cards[i] = intrusive(new Card());
+  }
+  // read column by column, so the key of a column is only looked up once
+  for (size_t c = 0 ; c < columns.size() ; ++c) {
+    const Column& column = columns[c];
+    for (size_t i = 0 ; i < size() ; ++i) {
+      if (!column.cells[i]) continue;
+      const String& value = column.values[column.cells[i] - 1];
+      int line_number = blocks[i].line_number;
+      Card& card = *cards[i];
+      switch (targets[c]) {
+        case TARGET_NOTES:         reader.handleValue(value, line_number, card.notes);         break;
+        case TARGET_TIME_CREATED:  reader.handleValue(value, line_number, card.time_created);  break;
+        case TARGET_TIME_MODIFIED: reader.handleValue(value, line_number, card.time_modified); break;
+        default:                   reader.handleValue(value, line_number, card.data.at(fields[c]));
+      }
+    }
+  }
+  // the other keys are read as text
+  Reader block_reader(&reader);
+  ReaderBlock block;
+  for (size_t i = 0 ; i < size() ; ++i) {
+    if (rest[i].empty()) continue;
+    block.data        = rest[i];
+    block.line_number = blocks[i].line_number;
+    block.indent      = blocks[i].indent;
+    block.main_thread = true;
+    block_reader.readBlock(block, cards[i]);
+    reader.addWarnings(block);
+  }
+  return true;
+}
@@ -0,0 +1,73 @@
+//+----------------------------------------------------------------------------+
+//| Description:  Magic Set Editor - Program to make Magic (tm) cards          |
+//| Copyright:    (C) 2001 - 2017 Twan van Laarhoven and Sean Hunt             |
+//| License:      GNU General Public License 2 or later (see file COPYING)     |
+//+----------------------------------------------------------------------------+
+
+#ifndef HEADER_DATA_CARD_COLUMNS
+#define HEADER_DATA_CARD_COLUMNS
+
+// ----------------------------------------------------------------------------- : Includes
+
+#include <util/prec.hpp>
+#include <util/reflect.hpp>
+#include <deque>
+
+class Set;
+class Game;
+DECLARE_POINTER_TYPE(Card);
+
+// ----------------------------------------------------------------------------- : CardColumns
+
+/// The cards of a set stored by key instead of by card, used as a cache to read sets faster
+/** For each key the distinct values are stored once, and for each card the index of its value,
+ *  so choices and image filenames become indices into a small table.
+ *  Only the values of card fields, notes and times are stored in columns,
+ *  the other keys of a card (styling data, extra data, ...) are stored as the text that was written for them.
+ *  The columns are built while the set is written, from what the Writer records for each card.
+ *
+ *  The columns are stored in a binary file in the set package, next to the set file.
+ *  The set file stays canonical: the columns are only used if they were made from the same set file,
+ *  with the same size and CRC-32 checksum as in the zip file,
+ *  and with the same versions of the program, game and stylesheet.
+ */
+class CardColumns {
+  public:
+  /// Build the columns from the keys that were written for each card, when writing a set file of the given size and checksum
+  /** Returns false if the keys are not for all cards of the set */
+  bool build(const Set& set, const vector<vector<WrittenKey> >& card_keys, size_t text_size, UInt text_crc);
+  /// Write the columns to the cache file of a set
+  void write(Set& set) const;
+  /// Read the columns from the cache file of a set
+  /** Returns false if there is no cache file, or if it does not belong to the current set file */
+  bool read(Set& set);
+
+  /// Number of cards in the columns
+  inline size_t size() const { return rest.size(); }
+
+  /// Read the cards that are stored in the columns, with the card blocks that reader captured
+  /** Returns false if the columns don't fit the fields of the game, then no cards are read,
+   *  and they should be read from their blocks.
+   */
+  bool readCards(Reader& reader, const Game& game, const deque<ReaderBlock>& blocks, vector<CardP>& cards) const;
+
+  private:
+  /// The values of a key for all cards
+  struct Column {
+    String         key;
+    vector<String> values; ///< The distinct values
+    vector<UInt>   cells;  ///< For each card the index of its value + 1, or 0 if the card doesn't have the key
+  };
+  vector<Column>      columns;
+  vector<std::string> rest;       ///< For each card, the keys that are not in columns, as lines of UTF-8 text
+  // What the columns were made from
+  size_t text_size;
+  UInt   text_crc;
+  String versions;                ///< Program, game and stylesheet versions
+
+  /// The versions that this set is read with
+  static String setVersions(const Set& set);
+};
+
+// ----------------------------------------------------------------------------- : EOF
+#endif
@@ -106,6 +106,20 @@ Style::Style(const FieldP& field)
   , content_dependent(false)
 {}
 
+Style::Style(const Style& that)
+  : IntrusivePtrVirtualBase()
+  , fieldP(that.fieldP)
+  , z_index(that.z_index)
+  , left (that.left),  top   (that.top)
+  , width(that.width), height(that.height)
+  , right(that.right), bottom(that.bottom)
+  , angle(that.angle)
+  , visible(that.visible)
+  , mask(that.mask)
+  , automatic_side(that.automatic_side)
+  , content_dependent(that.content_dependent)
+{}
+
 Style::~Style() {}
 
 IMPLEMENT_REFLECTION(Style) {
@@ -219,6 +233,10 @@ void Style::checkContentDependencies(Context& ctx, const Dependency& dep) const
   mask   .initDependencies(ctx,dep);
 }
 
+void Style::getReferencedImages(vector<String>& out) const {
+  mask.getReferencedFiles(out);
+}
+
 void Style::markDependencyMember(const String& name, const Dependency& dep) const {
   // mark dependencies on content
   if (dep.type == DEP_DUMMY && dep.index == false && starts_with(name, _("content "))) {
@@ -93,6 +93,8 @@ inline String type_name(const Field&) {
 class Style : public IntrusivePtrVirtualBase {
   public:
   Style(const FieldP&);
+  /// Copy a style, the listeners are not copied
+  Style(const Style&);
   virtual ~Style();
   
   const FieldP       fieldP;          ///< Field this style is for, should have the right type!
@@ -151,6 +153,8 @@ class Style : public IntrusivePtrVirtualBase {
   virtual void markDependencyMember(const String& name, const Dependency&) const;
   /// Invalidate scripted images for this style
   virtual void invalidate() {}
+  /// Add the filenames of the images this style could draw, see ScriptableImage::getReferencedFiles
+  virtual void getReferencedImages(vector<String>& out) const;
   
   /// Add a StyleListener
   void addListener(StyleListener*);
@@ -171,6 +171,22 @@ ChoiceStyle::ChoiceStyle(const ChoiceFieldP& field)
   , content_width(0.0), content_height(0.0)
 {}
 
+ChoiceStyle::ChoiceStyle(const ChoiceStyle& that)
+  : Style(that)
+  , popup_style(that.popup_style)
+  , render_style(that.render_style)
+  , font(that.font)
+  , image(that.image)
+  , choice_images(that.choice_images)
+  , choice_images_initialized(that.choice_images_initialized)
+  , combine(that.combine)
+  , alignment(that.alignment)
+  , thumbnails(nullptr) // owned by the original
+  , content_width(that.content_width), content_height(that.content_height)
+{
+  image.clearCache();
+}
+
 ChoiceStyle::~ChoiceStyle() {
   delete thumbnails;
 }
@@ -232,6 +248,13 @@ void ChoiceStyle::checkContentDependencies(Context& ctx, const Dependency& dep)
     ci.second.initDependencies(ctx, dep);
   }
 }
+void ChoiceStyle::getReferencedImages(vector<String>& out) const {
+  Style::getReferencedImages(out);
+  image.getReferencedFiles(out);
+  FOR_EACH_CONST(ci, choice_images) {
+    ci.second.getReferencedFiles(out);
+  }
+}
 void ChoiceStyle::invalidate() {
   // TODO : this is also done in update(), once should be enough
   // Update choice images and thumbnails
@@ -137,6 +137,8 @@ enum ThumbnailStatus
 class ChoiceStyle : public Style {
   public:
   ChoiceStyle(const ChoiceFieldP& field);
+  /// Copy a style, the thumbnails and the cached image are not copied
+  ChoiceStyle(const ChoiceStyle&);
   DECLARE_STYLE_TYPE(Choice);
   ~ChoiceStyle();
   
@@ -160,6 +162,7 @@ class ChoiceStyle : public Style {
   virtual void initDependencies(Context&, const Dependency&) const;
   virtual void checkContentDependencies(Context&, const Dependency&) const;
   virtual void invalidate();
+  virtual void getReferencedImages(vector<String>& out) const;
 };
 
 // ----------------------------------------------------------------------------- : ChoiceValue
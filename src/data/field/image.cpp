@@ -31,6 +31,11 @@ int ImageStyle::update(Context& ctx) {
        | default_image.update(ctx) * CHANGE_DEFAULT;
 }
 
+void ImageStyle::getReferencedImages(vector<String>& out) const {
+  Style::getReferencedImages(out);
+  default_image.getReferencedFiles(out);
+}
+
 // ----------------------------------------------------------------------------- : ImageValue
 
 String ImageValue::toString() const {
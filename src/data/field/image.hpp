@@ -38,6 +38,7 @@ class ImageStyle : public Style {
   ScriptableImage default_image; ///< Placeholder
   
   virtual int update(Context&);
+  virtual void getReferencedImages(vector<String>& out) const;
 };
 
 // ----------------------------------------------------------------------------- : ImageValue
@@ -12,6 +12,7 @@
 #include <util/prec.hpp>
 #include <util/error.hpp>
 #include <data/settings.hpp>
+#include <gfx/gfx.hpp>
 
 class Game;
 DECLARE_POINTER_TYPE(Set);
@@ -91,9 +92,32 @@ FileFormatP mtg_editor_file_format();
 /// Export images for each card in a set to a list of files
 void export_images(Window* parent, const SetP& set);
 
+/// Statistics of exporting card images
+struct ExportImagesStats {
+  ExportImagesStats() : written(0), render_time(0), encode_time(0) {}
+  size_t written;     ///< Number of image files written
+  long   render_time; ///< Time spent drawing cards, in milliseconds
+  long   encode_time; ///< Time spent encoding and writing files, in milliseconds, summed over all threads
+};
+
+/// Receives progress reports while exporting card images
+class ExportImagesProgress {
+  public:
+  virtual ~ExportImagesProgress() {}
+  /// Called on the main thread with the number of images written so far
+  /** Return false to stop exporting more cards */
+  virtual bool onProgress(size_t written, size_t total) = 0;
+  /// Called when exporting is done
+  virtual void onFinished(const ExportImagesStats&) {}
+};
+
 /// Export the image for each card in a list of cards
+/** The cards are drawn one after another, and written to files by 'jobs' threads.
+ *  With software rendering on windows, the cards are also drawn by those threads.
+ *  If jobs <= 0, one thread per processor is used. */
 void export_images(const SetP& set, const vector<CardP>& cards,
-                   const String& path, const String& filename_template, FilenameConflicts conflicts);
+                   const String& path, const String& filename_template, FilenameConflicts conflicts,
+                   ExportImagesProgress* progress = nullptr, int jobs = 0);
 
 /// Export the image of a single card
 void export_image(const SetP& set, const CardP& card, const String& filename);
@@ -101,6 +125,17 @@ void export_image(const SetP& set, const CardP& card, const String& filename);
 /// Generate a bitmap image of a card
 Bitmap export_bitmap(const SetP& set, const CardP& card);
 
+/// Should exported card images be rendered in software, without drawing to a DC?
+/** Set from the command line with --software-render */
+extern bool software_rendering;
+
+/// Compression used for exported image files
+/** Set from the command line with --compression */
+extern ImageCompression export_compression;
+
+/// Generate an image of a card, using software rendering if it is enabled
+Image export_card_image(const SetP& set, const CardP& card);
+
 /// Export a set to Magic Workstation format
 void export_mws(Window* parent, const SetP& set);
 
@@ -14,42 +14,39 @@
 #include <data/stylesheet.hpp>
 #include <data/settings.hpp>
 #include <render/card/viewer.hpp>
+#include <script/script_manager.hpp>
+#include <gfx/canvas.hpp>
 #include <wx/filename.h>
+#include <wx/thread.h>
+#include <deque>
 
 DECLARE_TYPEOF_COLLECTION(CardP);
+DECLARE_TYPEOF_COLLECTION(ValueViewerP);
+DECLARE_TYPEOF_NO_REV(IndexMap<FieldP COMMA ValueP>);
 
 // ----------------------------------------------------------------------------- : Single card export
 
 void export_image(const SetP& set, const CardP& card, const String& filename) {
-  Image img = export_bitmap(set, card).ConvertToImage();
-  img.SaveFile(filename);  // can't use Bitmap::saveFile, it wants to know the file type
-              // but image.saveFile determines it automagicly
+  Image img = export_card_image(set, card);
+  save_image(img, filename, export_compression); // determines the file type from the extension
 }
 
+/// A viewer that draws cards at their normal size, unless the stylesheet settings say to use the zoom settings
 class UnzoomedDataViewer : public DataViewer {
   public:
-  UnzoomedDataViewer(bool use_zoom_settings)
-    : use_zoom_settings(use_zoom_settings)
-  {}
   virtual Rotation getRotation() const;
-  private:
-  bool use_zoom_settings;
 };
 Rotation UnzoomedDataViewer::getRotation() const {
-  if (use_zoom_settings) {
+  if (!stylesheet) stylesheet = set->stylesheet;
+  if (!settings.stylesheetSettingsFor(*stylesheet).card_normal_export()) {
     return DataViewer::getRotation();
   } else {
-    if (!stylesheet) stylesheet = set->stylesheet;
     return Rotation(0, stylesheet->getCardRect(), 1.0, 1.0, ROTATION_ATTACH_TOP_LEFT);
   }
 }
 
-Bitmap export_bitmap(const SetP& set, const CardP& card) {
-  if (!set) throw Error(_("no set"));
-  // create viewer
-  UnzoomedDataViewer viewer(!settings.stylesheetSettingsFor(set->stylesheetFor(card)).card_normal_export());
-  viewer.setSet(set);
-  viewer.setCard(card);
+/// Draw the card shown in a viewer to a bitmap
+Bitmap viewer_bitmap(DataViewer& viewer) {
   // size of cards
   RealSize size = viewer.getRotation().getExternalSize();
   // create bitmap & dc
@@ -63,18 +60,406 @@ Bitmap export_bitmap(const SetP& set, const CardP& card) {
   return bitmap;
 }
 
-// ----------------------------------------------------------------------------- : Multiple card export
+/// Draw the card shown in a viewer to an image canvas
+Image viewer_canvas_image(DataViewer& viewer) {
+  RealSize size = viewer.getRotation().getExternalSize();
+  ImageCanvas canvas((int) size.width, (int) size.height);
+  if (!canvas.getImage().Ok()) throw InternalError(_("Unable to create image"));
+  viewer.draw(canvas);
+  return canvas.getImage();
+}
+
+/// Draw the card shown in a viewer to an image, using software rendering if it is enabled
+Image viewer_image(DataViewer& viewer) {
+  if (!software_rendering) return viewer_bitmap(viewer).ConvertToImage();
+  return viewer_canvas_image(viewer);
+}
+
+Bitmap export_bitmap(const SetP& set, const CardP& card) {
+  if (!set) throw Error(_("no set"));
+  UnzoomedDataViewer viewer;
+  viewer.setSet(set);
+  viewer.setCard(card);
+  return viewer_bitmap(viewer);
+}
+
+bool software_rendering = false;
+ImageCompression export_compression = COMPRESSION_DEFAULT;
+
+Image export_card_image(const SetP& set, const CardP& card) {
+  if (!set) throw Error(_("no set"));
+  UnzoomedDataViewer viewer;
+  viewer.setSet(set);
+  viewer.setCard(card);
+  return viewer_image(viewer);
+}
+
+// ----------------------------------------------------------------------------- : Writing images
+
+/// Writes images to files on worker threads, so encoding happens while the next cards are drawn
+/** Drawing cards runs scripts and updates styles, that has to stay on the main thread.
+ *  Images and filenames are handed over with the mutex held,
+ *  so their (non-atomic) reference counts are never changed from two threads at once.
+ */
+class ImageWriterPool {
+  public:
+  ImageWriterPool(int jobs);
+  ~ImageWriterPool();
+  
+  /// Add an image to be written, blocks while too many images are waiting.
+  /** The image must not be shared with anything else, it is cleared. */
+  void write(Image& image, const String& filename);
+  /// Number of images that have been written so far
+  size_t written();
+  /// Total time spent encoding and writing, in milliseconds
+  long encodeTime();
+  /// Wait until all images are written, and stop the workers
+  void finish();
+  
+  private:
+  struct Job {
+    Image  image;
+    String filename;
+  };
+  class Worker : public wxThread {
+    public:
+    Worker(ImageWriterPool& pool) : wxThread(wxTHREAD_JOINABLE), pool(pool) {}
+    virtual ExitCode Entry();
+    private:
+    ImageWriterPool& pool;
+  };
+  
+  wxMutex         mutex;
+  wxCondition     changed;   ///< Signaled when a job is added, taken or completed
+  deque<Job>      queue;     ///< Images waiting to be written
+  size_t          max_queue; ///< Maximum number of waiting images, to bound memory use
+  size_t          done;      ///< Number of images written
+  long            encode_time;
+  bool            stopping;
+  vector<String>  failed;    ///< Files that could not be written
+  vector<Worker*> workers;
+  
+  /// Get the next job, returns false when the workers should stop
+  bool next(Job& job);
+};
+
+ImageWriterPool::ImageWriterPool(int jobs)
+  : changed(mutex), done(0), encode_time(0), stopping(false)
+{
+  if (jobs <= 0) jobs = wxThread::GetCPUCount();
+  jobs = max(1, jobs);
+  max_queue = 2 * jobs;
+  for (int i = 0 ; i < jobs ; ++i) {
+    Worker* worker = new Worker(*this);
+    if (worker->Create() != wxTHREAD_NO_ERROR || worker->Run() != wxTHREAD_NO_ERROR) {
+      delete worker;
+      break;
+    }
+    workers.push_back(worker);
+  }
+}
+
+ImageWriterPool::~ImageWriterPool() {
+  finish();
+}
+
+void ImageWriterPool::write(Image& image, const String& filename) {
+  if (workers.empty()) {
+    // no threads available, write it ourselves
+    wxStopWatch timer;
+    if (!save_image(image, filename, export_compression)) failed.push_back(filename);
+    encode_time += timer.Time();
+    image = Image();
+    ++done;
+    return;
+  }
+  wxMutexLocker lock(mutex);
+  while (queue.size() >= max_queue) changed.Wait();
+  queue.push_back(Job());
+  queue.back().image    = image;
+  queue.back().filename = filename;
+  image = Image();
+  changed.Broadcast();
+}
+
+size_t ImageWriterPool::written() {
+  wxMutexLocker lock(mutex);
+  return done;
+}
+
+long ImageWriterPool::encodeTime() {
+  wxMutexLocker lock(mutex);
+  return encode_time;
+}
+
+bool ImageWriterPool::next(Job& job) {
+  wxMutexLocker lock(mutex);
+  while (queue.empty() && !stopping) changed.Wait();
+  if (queue.empty()) return false;
+  job = queue.front();
+  queue.pop_front();
+  changed.Broadcast();
+  return true;
+}
+
+wxThread::ExitCode ImageWriterPool::Worker::Entry() {
+  Job job;
+  while (pool.next(job)) {
+    wxStopWatch timer;
+    bool ok = save_image(job.image, job.filename, export_compression);
+    long time = timer.Time();
+    wxMutexLocker lock(pool.mutex);
+    if (!ok) pool.failed.push_back(job.filename);
+    pool.encode_time += time;
+    job = Job();
+    ++pool.done;
+    pool.changed.Broadcast();
+  }
+  return 0;
+}
 
+void ImageWriterPool::finish() {
+  {
+    wxMutexLocker lock(mutex);
+    stopping = true;
+    changed.Broadcast();
+  }
+  for (size_t i = 0 ; i < workers.size() ; ++i) {
+    workers[i]->Wait();
+    delete workers[i];
+  }
+  workers.clear();
+  // report errors from the main thread
+  for (size_t i = 0 ; i < failed.size() ; ++i) {
+    handle_error(Error(_("Unable to write image file: ") + failed[i]));
+  }
+  failed.clear();
+}
+
+// ----------------------------------------------------------------------------- : Drawing cards on threads
+
+/// Can cards be drawn on worker threads?
+/** Cards are then drawn to an ImageCanvas, but the value viewers still make bitmaps,
+ *  which wx only allows outside the main thread on windows.
+ */
+#ifdef __WXMSW__
+  const bool can_draw_cards_in_threads = true;
+#else
+  const bool can_draw_cards_in_threads = false;
+#endif
+
+/// A viewer for drawing cards on a worker thread
+/** It has its own copies of the styles and its own script context,
+ *  so drawing a card doesn't change anything that is used by other threads.
+ *  The set, the stylesheets and this viewer must be prepared on the main thread, see prepare().
+ */
+class ThreadDataViewer : public UnzoomedDataViewer {
+  public:
+  ThreadDataViewer(const SetP& set);
+  
+  /// Copy the styles of the stylesheet of a card, and make sure the card has its extra data
+  /** Must be called from the main thread for all cards before showCard is used from another thread. */
+  void prepare(const CardP& card);
+  /// Show a card, using our own copies of the styles
+  void showCard(const CardP& card);
+  
+  virtual Context& getContext() const;
+  
+  protected:
+  virtual void updateStyles(bool only_content_dependent);
+  virtual void onAction(const Action&, bool undone) {} // the main thread is waiting for us, the set doesn't change
+  
+  private:
+  struct Styles {
+    IndexMap<FieldP,StyleP> card_style, extra_card_style;
+  };
+  mutable SetScriptContext       scripts;
+  map<const StyleSheet*, Styles> styles;
+};
+
+ThreadDataViewer::ThreadDataViewer(const SetP& set)
+  : scripts(*set)
+{
+  setSet(set);
+}
+
+void ThreadDataViewer::prepare(const CardP& card) {
+  const StyleSheet& card_stylesheet = set->stylesheetFor(card);
+  Styles& s = styles[&card_stylesheet];
+  s.card_style      .cloneFrom(card_stylesheet.card_style);
+  s.extra_card_style.cloneFrom(card_stylesheet.extra_card_style);
+  card->extraDataFor(card_stylesheet);
+  set->stylingDataFor(card);
+  settings.stylesheetSettingsFor(card_stylesheet);
+}
+
+void ThreadDataViewer::showCard(const CardP& card) {
+  StyleSheetP card_stylesheet = set->stylesheetForP(card);
+  Styles& s = styles[card_stylesheet.get()];
+  this->card = card;
+  stylesheet = card_stylesheet;
+  setStyles(card_stylesheet, s.card_style, &s.extra_card_style);
+  setData(card->data, &card->extraDataFor(*card_stylesheet));
+  onChangeSize();
+}
+
+Context& ThreadDataViewer::getContext() const {
+  return scripts.getContext(card);
+}
+
+void ThreadDataViewer::updateStyles(bool only_content_dependent) {
+  Context& ctx = getContext();
+  if (!only_content_dependent) {
+    // update extra card fields, without events, nobody else is showing this card right now
+    FOR_EACH(v, card->extraDataFor(*stylesheet)) {
+      v->update(ctx);
+    }
+  }
+  FOR_EACH(v, viewers) {
+    Style& s = *v->getStyle();
+    if (only_content_dependent && !s.content_dependent) continue;
+    try {
+      if (int change = s.update(ctx)) {
+        s.tellListeners(change | (only_content_dependent ? CHANGE_ALREADY_PREPARED : 0));
+      }
+    } catch (const ScriptError& e) {
+      handle_error(ScriptError(e.what() + _("\n  while updating styles for '") + s.fieldP->name + _("'")));
+    }
+  }
+}
+
+/// Draws cards and writes them to files on worker threads, each with its own ThreadDataViewer
+class CardDrawPool {
+  public:
+  CardDrawPool(const SetP& set, const vector<pair<CardP,String> >& targets);
+  
+  /// Draw and write all cards with the given number of threads, and report progress from this thread
+  /** Returns false if no threads could be started, nothing is written in that case */
+  bool run(int jobs, ExportImagesProgress* progress, ExportImagesStats& stats);
+  
+  private:
+  class Worker : public wxThread {
+    public:
+    Worker(CardDrawPool& pool) : wxThread(wxTHREAD_JOINABLE), pool(pool), viewer(pool.set) {}
+    virtual ExitCode Entry();
+    CardDrawPool&    pool;
+    ThreadDataViewer viewer;
+  };
+  
+  SetP                               set;
+  const vector<pair<CardP,String> >& targets;
+  wxMutex        mutex;
+  wxCondition    changed;     ///< Signaled when a card is done
+  size_t         next_target; ///< First target that no thread has taken yet
+  size_t         done;        ///< Number of targets that are done
+  size_t         written;     ///< Number of images written
+  long           render_time, encode_time;
+  bool           stopping;
+  vector<String> failed;      ///< Files that could not be written
+  
+  /// Take the next target, returns false when the workers should stop
+  bool next(size_t& i);
+};
+
+CardDrawPool::CardDrawPool(const SetP& set, const vector<pair<CardP,String> >& targets)
+  : set(set), targets(targets), changed(mutex)
+  , next_target(0), done(0), written(0), render_time(0), encode_time(0), stopping(false)
+{}
+
+bool CardDrawPool::next(size_t& i) {
+  wxMutexLocker lock(mutex);
+  if (stopping || next_target >= targets.size()) return false;
+  i = next_target++;
+  return true;
+}
+
+wxThread::ExitCode CardDrawPool::Worker::Entry() {
+  size_t i;
+  while (pool.next(i)) {
+    wxStopWatch timer;
+    Image img;
+    try {
+      viewer.showCard(pool.targets[i].first);
+      img = viewer_canvas_image(viewer);
+    } catch (const Error& e) {
+      handle_error(e);
+    }
+    long render = timer.Time();
+    timer.Start();
+    bool ok = img.Ok() && save_image(img, pool.targets[i].second, export_compression);
+    long encode = timer.Time();
+    img = Image();
+    wxMutexLocker lock(pool.mutex);
+    if (ok) ++pool.written;
+    else    pool.failed.push_back(pool.targets[i].second);
+    pool.render_time += render;
+    pool.encode_time += encode;
+    ++pool.done;
+    pool.changed.Broadcast();
+  }
+  return 0;
+}
+
+bool CardDrawPool::run(int jobs, ExportImagesProgress* progress, ExportImagesStats& stats) {
+  if (jobs <= 0) jobs = wxThread::GetCPUCount();
+  jobs = max(1, min(jobs, (int)targets.size()));
+  // everything the workers share must be ready before they start
+  set->updateDelayed();
+  vector<Worker*> workers;
+  for (int j = 0 ; j < jobs ; ++j) {
+    Worker* worker = new Worker(*this);
+    for (size_t i = 0 ; i < targets.size() ; ++i) {
+      worker->viewer.prepare(targets[i].first);
+    }
+    if (worker->Create() != wxTHREAD_NO_ERROR || worker->Run() != wxTHREAD_NO_ERROR) {
+      delete worker;
+      break;
+    }
+    workers.push_back(worker);
+  }
+  if (workers.empty()) return false;
+  // report progress until the workers are done
+  {
+    wxMutexLocker lock(mutex);
+    while (done < targets.size()) {
+      changed.WaitTimeout(100);
+      if (progress && !stopping) {
+        size_t n = written;
+        mutex.Unlock();
+        bool go_on = progress->onProgress(n, targets.size());
+        mutex.Lock();
+        if (!go_on) stopping = true;
+      }
+      if (stopping && next_target == done) break; // nothing in progress anymore
+    }
+  }
+  for (size_t j = 0 ; j < workers.size() ; ++j) {
+    workers[j]->Wait();
+    delete workers[j];
+  }
+  // report errors from the main thread
+  for (size_t i = 0 ; i < failed.size() ; ++i) {
+    handle_error(Error(_("Unable to write image file: ") + failed[i]));
+  }
+  stats.written     = written;
+  stats.render_time = render_time;
+  stats.encode_time = encode_time;
+  return true;
+}
+
+// ----------------------------------------------------------------------------- : Multiple card export
 
 void export_images(const SetP& set, const vector<CardP>& cards,
-                   const String& path, const String& filename_template, FilenameConflicts conflicts)
+                   const String& path, const String& filename_template, FilenameConflicts conflicts,
+                   ExportImagesProgress* progress, int jobs)
 {
   wxBusyCursor busy;
   // Script
   ScriptP filename_script = parse(filename_template, nullptr, true);
   // Path
   wxFileName fn(path);
-  // Export
+  // Determine all filenames up front, so the conflicts only depend on files that existed before exporting
+  vector<pair<CardP,String> > targets;
   std::set<String> used; // for CONFLICT_NUMBER_OVERWRITE
   FOR_EACH_CONST(card, cards) {
     // filename for this card
@@ -85,9 +470,37 @@ void export_images(const SetP& set, const vector<CardP>& cards,
     fn.SetFullName(filename);
     // does the file exist?
     if (!resolve_filename_conflicts(fn, conflicts, used)) continue;
-    // write image
     filename = fn.GetFullPath();
     used.insert(filename);
-    export_image(set, card, filename);
+    targets.push_back(make_pair(card, filename));
+  }
+  ExportImagesStats stats;
+  if (software_rendering && can_draw_cards_in_threads && !targets.empty()
+      && CardDrawPool(set, targets).run(jobs, progress, stats)) {
+    // the cards were drawn and written on other threads
+    if (progress) {
+      progress->onProgress(stats.written, targets.size());
+      progress->onFinished(stats);
+    }
+    return;
+  }
+  // Draw the cards on this thread, reusing the viewers, while other threads write the images
+  UnzoomedDataViewer viewer;
+  viewer.setSet(set);
+  ImageWriterPool writer(jobs);
+  for (size_t i = 0 ; i < targets.size() ; ++i) {
+    if (progress && !progress->onProgress(writer.written(), targets.size())) break;
+    wxStopWatch timer;
+    viewer.setCard(targets[i].first);
+    Image img = viewer_image(viewer);
+    stats.render_time += timer.Time();
+    writer.write(img, targets[i].second);
+  }
+  writer.finish();
+  stats.written     = writer.written();
+  stats.encode_time = writer.encodeTime();
+  if (progress) {
+    progress->onProgress(stats.written, targets.size());
+    progress->onFinished(stats);
   }
 }
@@ -16,12 +16,17 @@
 #include <data/field.hpp>
 #include <data/field/text.hpp>    // for 0.2.7 fix
 #include <data/field/information.hpp>
+#include <data/card_columns.hpp>
 #include <util/tagged_string.hpp> // for 0.2.7 fix
 #include <util/order_cache.hpp>
 #include <util/delayed_index_maps.hpp>
+#include <util/io/package_manager.hpp>
+#include <util/parallel.hpp>
 #include <script/script_manager.hpp>
 #include <script/profiler.hpp>
 #include <wx/sstream.h>
+#include <wx/thread.h>
+#include <deque>
 
 DECLARE_TYPEOF_COLLECTION(CardP);
 DECLARE_TYPEOF_NO_REV(IndexMap<FieldP COMMA ValueP>);
@@ -67,6 +72,12 @@ void Set::updateStyles(const CardP& card, bool only_content_dependent) {
 void Set::updateDelayed() {
   script_manager->updateDelayed();
 }
+void Set::updateDelayedKeywords() {
+  script_manager->updateDelayedKeywords();
+}
+bool Set::updateSomeDelayed(long max_time) {
+  return script_manager->updateSomeDelayed(max_time);
+}
 
 Context& Set::getContextForThumbnails() {
   assert(!wxThread::IsMain());
@@ -176,9 +187,16 @@ IMPLEMENT_REFLECTION(Set) {
   if (game) {
     REFLECT_IF_READING {
       data.init(game->set_fields);
+      // load what the game needs in the background, while we read the rest of the set
+      package_manager.prefetch(game);
     }
     WITH_DYNAMIC_ARG(game_for_reading, game.get());
     REFLECT(stylesheet);
+    REFLECT_IF_READING if (stylesheet) {
+      vector<String> images;
+      stylesheet->getCardImages(images);
+      package_manager.prefetch(stylesheet, images);
+    }
     WITH_DYNAMIC_ARG(stylesheet_for_reading, stylesheet.get());
     REFLECT_N("set_info", data);
     if (stylesheet) {
@@ -200,11 +218,17 @@ void Set::reflect_cards (Tag& tag) {
   REFLECT(cards);
 }
 
+/// Minimum number of cards before the cards are also stored in columns
+const size_t min_cards_for_columns = 256;
+
 template <>
 void Set::reflect_cards<Writer> (Writer& tag) {
   // When writing to a directory, we write each card in a separate file.
   // We don't do this in zipfiles because it leads to bloat.
-  if (isZipfile()) {
+  if (isZipfile() && writing_package() == this && cards.size() >= min_cards_for_columns) {
+    // remember what is written for each card, to store them in columns as well
+    tag.handle(_("cards"), cards, &written_card_keys);
+  } else if (isZipfile()) {
     REFLECT(cards);
   } else {
     set<String> used;
@@ -231,6 +255,111 @@ void Set::reflect_cards<Writer> (Writer& tag) {
   }
 }
 
+// ----------------------------------------------------------------------------- : Reading cards
+
+/// Minimum number of cards before cards are read on worker threads
+const size_t min_cards_for_threads = 64;
+
+/// Reads captured card blocks into cards, using worker threads when there are enough of them
+/** Card blocks are independent, except for cards with their own stylesheet,
+ *  loading that stylesheet has to happen on the main thread.
+ *  Each block is read with its own Reader, the warnings are added to the main Reader in the order of the cards.
+ */
+class CardBlockReader : private ParallelBody {
+  public:
+  /// Read blocks into cards, cards that are already read are skipped
+  CardBlockReader(Reader& reader, deque<ReaderBlock>& blocks, vector<CardP>& cards);
+  
+  /// Read all blocks
+  void read();
+  
+  private:
+  Reader&             parent;
+  deque<ReaderBlock>& blocks;
+  vector<CardP>&      cards;
+  vector<ErrorP>      errors;      ///< Error from reading each block, if any
+  vector<char>        unknown;     ///< Did reading a block throw something that is not an Error?
+  
+  /// Read a block, unless it is already read or must be read on the main thread
+  virtual void run(size_t i);
+  /// Read a block, and keep the error if that fails
+  void readBlock(size_t i);
+};
+
+CardBlockReader::CardBlockReader(Reader& reader, deque<ReaderBlock>& blocks, vector<CardP>& cards)
+  : parent(reader), blocks(blocks)
+  , cards(cards), errors(blocks.size()), unknown(blocks.size(), false)
+{}
+
+void CardBlockReader::run(size_t i) {
+  if (!blocks[i].main_thread && !cards[i]) readBlock(i);
+}
+
+void CardBlockReader::readBlock(size_t i) {
+  try {
+    Reader reader(&parent);
+    reader.readBlock(blocks[i], cards[i]);
+  } catch (const Error& e) {
+    errors[i] = ErrorP(e.clone());
+  } catch (...) {
+    // we can't keep this exception, the block is read again on the main thread to throw it there
+    unknown[i] = true;
+  }
+}
+
+void CardBlockReader::read() {
+  // blocks that must be read on the main thread, before there are other threads
+  for (size_t i = 0 ; i < blocks.size() ; ++i) {
+    if (blocks[i].main_thread && !cards[i]) readBlock(i);
+  }
+  // the other blocks, the clipboard package is not shared with other threads
+  parallel_for(blocks.size(), clipboard_package() ? blocks.size() + 1 : min_cards_for_threads, *this);
+  // results, in order
+  for (size_t i = 0 ; i < blocks.size() ; ++i) {
+    parent.addWarnings(blocks[i]);
+    if (errors[i]) errors[i]->rethrow();
+    if (unknown[i]) {
+      cards[i] = CardP();
+      Reader reader(&parent);
+      reader.readBlock(blocks[i], cards[i]);
+    }
+  }
+}
+
+template <>
+void Set::reflect_cards<Reader> (Reader& tag) {
+  // Cards are independent, so first find all card blocks, and then read them in parallel.
+  deque<ReaderBlock> blocks(1);
+  while (tag.captureBlock(_("card"), blocks.back(), _("stylesheet"))) {
+    blocks.push_back(ReaderBlock());
+  }
+  blocks.pop_back();
+  if (blocks.empty()) return;
+  // cards that are stored in the columns don't have to be read from their blocks
+  vector<CardP> new_cards(blocks.size());
+  if (blocks.size() >= min_cards_for_columns && tag.getPackage() == this) {
+    CardColumns columns;
+    if (columns.read(*this) && columns.size() == blocks.size()) {
+      columns.readCards(tag, *game, blocks, new_cards);
+    }
+  }
+  CardBlockReader reader(tag, blocks, new_cards);
+  reader.read();
+  cards.insert(cards.end(), new_cards.begin(), new_cards.end());
+}
+
+void Set::writeCaches(size_t file_size, UInt file_crc) {
+  vector<vector<WrittenKey> > card_keys;
+  card_keys.swap(written_card_keys);
+  if (card_keys.empty()) return;
+  try {
+    CardColumns columns;
+    if (columns.build(*this, card_keys, file_size, file_crc)) columns.write(*this);
+  } catch (const Error&) {
+    // the columns are only a cache, the set file has been written
+  }
+}
+
 // ----------------------------------------------------------------------------- : Script utilities
 
 ScriptValueP make_iterator(const Set& set) {
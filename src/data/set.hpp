@@ -73,6 +73,11 @@ class Set : public Packaged {
   void updateStyles(const CardP& card, bool only_content_dependent);
   /// Update scripts that were delayed
   void updateDelayed();
+  /// Update the scripts that were delayed because keywords changed
+  void updateDelayedKeywords();
+  /// Update some of the scripts that were delayed, for at most max_time milliseconds
+  /** Returns true if there is more to update */
+  bool updateSomeDelayed(long max_time);
   /// A context for performing scripts
   /** Should only be used from the thumbnail thread! */
   Context& getContextForThumbnails();
@@ -125,6 +130,8 @@ class Set : public Packaged {
   virtual VCSP getVCS() {
     return vcs;
   }
+  /// Store the cards in columns as well, to read them faster
+  virtual void writeCaches(size_t file_size, UInt file_crc);
 
   private:
   DECLARE_REFLECTION();
@@ -138,6 +145,8 @@ class Set : public Packaged {
   /// Cache of cards ordered by some criterion
   map<pair<ScriptValueP,ScriptValueP>,OrderCacheP> order_cache;
   map<ScriptValueP,int>                            filter_cache;
+  /// The keys written for each card when the set was last saved, for writeCaches
+  vector<vector<WrittenKey> >                      written_card_keys;
 };
 
 inline String type_name(const Set&) {
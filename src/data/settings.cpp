@@ -165,6 +165,7 @@ Settings settings;
 
 Settings::Settings()
   : locale               (_("en"))
+  , append_on_save       (false)
   , set_window_maximized (false)
   , set_window_width     (790)
   , set_window_height    (300)
@@ -173,6 +174,7 @@ Settings::Settings()
   , symbol_grid_size     (30)
   , symbol_grid          (true)
   , symbol_grid_snap     (false)
+  , image_pool_size      (256)
   , print_layout         (LAYOUT_NO_SPACE)
   #if USE_OLD_STYLE_UPDATE_CHECKER
   , updates_url          (_("http://magicseteditor.sourceforge.net/updates"))
@@ -252,6 +254,7 @@ IMPLEMENT_REFLECTION_NO_SCRIPT(Settings) {
   REFLECT(default_image_dir);
   REFLECT(default_symbol_dir);
   REFLECT(default_export_dir);
+  REFLECT(append_on_save);
   REFLECT(set_window_maximized);
   REFLECT(set_window_width);
   REFLECT(set_window_height);
@@ -260,6 +263,7 @@ IMPLEMENT_REFLECTION_NO_SCRIPT(Settings) {
   REFLECT(symbol_grid_size);
   REFLECT(symbol_grid);
   REFLECT(symbol_grid_snap);
+  REFLECT(image_pool_size);
   REFLECT(default_game);
   REFLECT(print_layout);
   REFLECT(apprentice_location);
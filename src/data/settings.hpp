@@ -147,6 +147,7 @@ class Settings {
   String default_image_dir;  ///< Where to look for images to import
   String default_symbol_dir; ///< Where to look for .mse-symbol files
   String default_export_dir; ///< Where to export to by default
+  bool   append_on_save;     ///< Save sets by appending to the file, this doesn't keep a .bak file
   
   // --------------------------------------------------- : Set window
   bool set_window_maximized;
@@ -160,6 +161,9 @@ class Settings {
   bool symbol_grid;
   bool symbol_grid_snap;
   
+  // --------------------------------------------------- : Images
+  UInt image_pool_size; ///< Memory for keeping decoded images around, in MB
+  
   // --------------------------------------------------- : Default pacakge selections
   String default_game;
   
@@ -15,6 +15,7 @@
 
 DECLARE_TYPEOF_COLLECTION(StyleSheet*);
 DECLARE_TYPEOF_COLLECTION(FieldP);
+DECLARE_TYPEOF_NO_REV(IndexMap<FieldP COMMA StyleP>);
 
 // ----------------------------------------------------------------------------- : StyleSheet
 
@@ -87,6 +88,15 @@ StyleP StyleSheet::styleFor(const FieldP& field) {
   }
 }
 
+void StyleSheet::getCardImages(vector<String>& out) const {
+  FOR_EACH_CONST(s, card_style) {
+    s->getReferencedImages(out);
+  }
+  FOR_EACH_CONST(s, extra_card_style) {
+    s->getReferencedImages(out);
+  }
+}
+
 
 void mark_dependency_value(const StyleSheet& stylesheet, const Dependency& dep) {
   stylesheet.game->dependent_scripts_stylesheet.add(dep);
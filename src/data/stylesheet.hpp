@@ -56,6 +56,8 @@ class StyleSheet : public Packaged {
   
   /// Return the style for a given field, it is not specified what type of field this is.
   StyleP styleFor(const FieldP& field);
+  /// Add the filenames of the images the card styles could draw, see Style::getReferencedImages
+  void getCardImages(vector<String>& out) const;
   
   /// Load a StyleSheet, given a Game and the name of the StyleSheet
   static StyleSheetP byGameAndName(const Game& game, const String& name);
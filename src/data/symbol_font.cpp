@@ -21,6 +21,204 @@ DECLARE_TYPEOF_COLLECTION(SymbolFont::DrawableSymbol);
 DECLARE_TYPEOF_COLLECTION(SymbolInFontP);
 DECLARE_TYPEOF_COLLECTION(InsertSymbolMenuP);
 
+// ----------------------------------------------------------------------------- : SymbolGlyphCache
+
+/// Symbol sizes are rounded to this fraction of a pixel, so small zoom changes reuse the same glyphs
+const int symbol_size_steps = 4;
+/// Number of different sizes to keep
+const size_t max_symbol_atlases = 6;
+/// Number of runs of symbols to keep
+const size_t max_symbol_runs = 64;
+/// Minimum width of an atlas image
+const int symbol_atlas_width = 512;
+
+inline int quantize_symbol_size(double size) {
+  return max(1, to_int(size * symbol_size_steps));
+}
+inline double symbol_size_from_key(int size_key) {
+  return (double)size_key / symbol_size_steps;
+}
+
+/// The rendered symbols of a symbol font.
+/** For each (quantized) size all symbols are packed into a single atlas image,
+ *  on shelves: rows of glyphs that are as high as the highest glyph in them.
+ *  Only the most recently used sizes are kept.
+ *  Runs of symbols that were drawn before are kept as a single bitmap,
+ *  so drawing a mana cost that is used on many cards is a single blit.
+ */
+class SymbolGlyphCache {
+  public:
+  SymbolGlyphCache() : clock(0) {}
+
+  /// Find or render a symbol, returns the rectangle of the symbol in the atlas for size_key
+  wxRect glyph(SymbolFont& font, SymbolInFont& sym, int size_key);
+  /// The atlas image for the given size, only valid until the next call to glyph
+  const Image& atlas(int size_key);
+
+  /// A run of glyphs, relative to the top-left of the run
+  struct RunKey {
+    int size_key;
+    vector<pair<const SymbolInFont*, wxPoint> > glyphs;
+    inline bool operator == (const RunKey& that) const {
+      return size_key == that.size_key && glyphs == that.glyphs;
+    }
+  };
+  /// Find a run of glyphs that was drawn before, or nullptr
+  const Bitmap* findRun(const RunKey& key);
+  /// Store a run
+  void storeRun(const RunKey& key, const Bitmap& bmp);
+
+  /// Forget all glyphs, for example because a symbol image changed
+  void clear();
+
+  private:
+  struct Atlas {
+    int   size_key;
+    UInt  last_use;
+    Image image;
+    int   shelf_x, shelf_y, shelf_height; ///< The shelf that is being filled
+    map<const SymbolInFont*, wxRect> glyphs;
+  };
+  UInt clock;
+  vector<Atlas> atlases;
+  vector<pair<RunKey, Bitmap> > runs; ///< most recently used first
+
+  Atlas& findAtlas(int size_key);
+  /// Make room for a w*h image in an atlas
+  wxRect place(Atlas& atlas, int w, int h);
+};
+
+/// A fully transparent image
+Image transparent_image(int w, int h) {
+  Image out(w, h, true);
+  out.InitAlpha();
+  memset(out.GetAlpha(), 0, w * h);
+  return out;
+}
+
+/// Copy an image with alpha into a larger, transparent one
+Image grow_image(const Image& img, int w, int h) {
+  Image out = transparent_image(w, h);
+  int ow = img.GetWidth();
+  for (int y = 0 ; y < img.GetHeight() ; ++y) {
+    memcpy(out.GetData()  + 3 * y * w, img.GetData()  + 3 * y * ow, 3 * ow);
+    memcpy(out.GetAlpha() +     y * w, img.GetAlpha() +     y * ow,     ow);
+  }
+  return out;
+}
+
+/// Draw src (with alpha) over dst (with alpha) at (x,y)
+void blend_over(Image& dst, const Image& src, const wxRect& src_rect, int x, int y) {
+  int dw = dst.GetWidth(), sw = src.GetWidth();
+  for (int dy = 0 ; dy < src_rect.height ; ++dy) {
+    const Byte* s  = src.GetData()  + 3 * ((src_rect.y + dy) * sw + src_rect.x);
+    const Byte* sa = src.GetAlpha() +      (src_rect.y + dy) * sw + src_rect.x;
+    Byte*       d  = dst.GetData()  + 3 * ((y + dy) * dw + x);
+    Byte*       da = dst.GetAlpha() +      (y + dy) * dw + x;
+    for (int dx = 0 ; dx < src_rect.width ; ++dx, s += 3, d += 3, ++sa, ++da) {
+      int a = *sa;
+      if (a == 0) continue;
+      if (a == 255 || *da == 0) {
+        d[0] = s[0]; d[1] = s[1]; d[2] = s[2]; *da = a;
+        continue;
+      }
+      int b   = *da * (255 - a) / 255; // remaining weight of the destination
+      int out = a + b;
+      d[0] = (s[0] * a + d[0] * b) / out;
+      d[1] = (s[1] * a + d[1] * b) / out;
+      d[2] = (s[2] * a + d[2] * b) / out;
+      *da = out;
+    }
+  }
+}
+
+SymbolGlyphCache::Atlas& SymbolGlyphCache::findAtlas(int size_key) {
+  ++clock;
+  for (size_t i = 0 ; i < atlases.size() ; ++i) {
+    if (atlases[i].size_key == size_key) {
+      atlases[i].last_use = clock;
+      return atlases[i];
+    }
+  }
+  // drop the least recently used size
+  if (atlases.size() >= max_symbol_atlases) {
+    size_t oldest = 0;
+    for (size_t i = 1 ; i < atlases.size() ; ++i) {
+      if (atlases[i].last_use < atlases[oldest].last_use) oldest = i;
+    }
+    atlases.erase(atlases.begin() + oldest);
+  }
+  Atlas a;
+  a.size_key = size_key;
+  a.last_use = clock;
+  a.shelf_x = a.shelf_y = a.shelf_height = 0;
+  atlases.push_back(a);
+  return atlases.back();
+}
+
+wxRect SymbolGlyphCache::place(Atlas& atlas, int w, int h) {
+  int aw = atlas.image.Ok() ? atlas.image.GetWidth()  : max(symbol_atlas_width, w);
+  int ah = atlas.image.Ok() ? atlas.image.GetHeight() : 0;
+  if (atlas.shelf_x + w > aw) {
+    // start a new shelf
+    atlas.shelf_y     += atlas.shelf_height;
+    atlas.shelf_x      = 0;
+    atlas.shelf_height = 0;
+  }
+  wxRect rect(atlas.shelf_x, atlas.shelf_y, w, h);
+  atlas.shelf_x     += w;
+  atlas.shelf_height = max(atlas.shelf_height, h);
+  // grow the image?
+  int need_w = max(aw, w), need_h = atlas.shelf_y + atlas.shelf_height;
+  if (!atlas.image.Ok()) {
+    atlas.image = transparent_image(need_w, max(need_h, 1));
+  } else if (need_w > aw || need_h > ah) {
+    atlas.image = grow_image(atlas.image, need_w, max(need_h, 2 * ah));
+  }
+  return rect;
+}
+
+wxRect SymbolGlyphCache::glyph(SymbolFont& font, SymbolInFont& sym, int size_key) {
+  Atlas& atlas = findAtlas(size_key);
+  map<const SymbolInFont*, wxRect>::const_iterator it = atlas.glyphs.find(&sym);
+  if (it != atlas.glyphs.end()) return it->second;
+  // render
+  Image img = sym.getImage(font, symbol_size_from_key(size_key));
+  if (!img.HasAlpha()) img.InitAlpha();
+  wxRect rect = place(atlas, img.GetWidth(), img.GetHeight());
+  int aw = atlas.image.GetWidth(), w = img.GetWidth();
+  for (int y = 0 ; y < img.GetHeight() ; ++y) {
+    memcpy(atlas.image.GetData()  + 3 * ((rect.y + y) * aw + rect.x), img.GetData()  + 3 * y * w, 3 * w);
+    memcpy(atlas.image.GetAlpha() +      (rect.y + y) * aw + rect.x,  img.GetAlpha() +     y * w,     w);
+  }
+  atlas.glyphs.insert(make_pair(&sym, rect));
+  return rect;
+}
+
+const Image& SymbolGlyphCache::atlas(int size_key) {
+  return findAtlas(size_key).image;
+}
+
+const Bitmap* SymbolGlyphCache::findRun(const RunKey& key) {
+  for (size_t i = 0 ; i < runs.size() ; ++i) {
+    if (runs[i].first == key) {
+      rotate(runs.begin(), runs.begin() + i, runs.begin() + i + 1);
+      return &runs.front().second;
+    }
+  }
+  return nullptr;
+}
+
+void SymbolGlyphCache::storeRun(const RunKey& key, const Bitmap& bmp) {
+  runs.insert(runs.begin(), make_pair(key, bmp));
+  if (runs.size() > max_symbol_runs) runs.pop_back();
+}
+
+void SymbolGlyphCache::clear() {
+  atlases.clear();
+  runs.clear();
+}
+
 // ----------------------------------------------------------------------------- : SymbolFont
 
 // SymbolFont that is used for SymbolInFonts constructed with the default constructor
@@ -32,10 +230,13 @@ SymbolFont::SymbolFont()
   , spacing(1,1)
   , scale_text(false)
   , processed_insert_symbol_menu(nullptr)
+  , glyphs(new SymbolGlyphCache)
+  , glyphs_lock(wxMUTEX_RECURSIVE)
 {}
 
 SymbolFont::~SymbolFont() {
   delete processed_insert_symbol_menu;
+  delete glyphs;
 }
 
 String SymbolFont::typeNameStatic() { return _("symbol-font"); }
@@ -72,17 +273,15 @@ class SymbolInFont : public IntrusivePtrBase<SymbolInFont> {
   /// Get a shrunk, zoomed image
   Image getImage(Package& pkg, double size);
   
-  /// Get a shrunk, zoomed bitmap
-  Bitmap getBitmap(Package& pkg, double size);
-  
   /// Get a bitmap with the given size
   Bitmap getBitmap(Package& pkg, wxSize size);
   
   /// Size of a (zoomed) bitmap
   /** This is the size of the resulting image, it does NOT convert back to internal coordinates */
-  RealSize size(Package& pkg, double size);
+  RealSize size(SymbolFont& font, double size);
   
-  void update(Context& ctx);
+  /// Update scripts, returns true if the image has changed
+  bool update(Context& ctx);
   
   String           code;      ///< Code for this symbol
   Scriptable<bool> enabled;    ///< Is this symbol enabled?
@@ -99,8 +298,6 @@ class SymbolInFont : public IntrusivePtrBase<SymbolInFont> {
   ScriptableImage  image;      ///< The image for this symbol
   double           img_size;    ///< Font size used by the image
   wxSize           actual_size;  ///< Actual image size, only known after loading the image
-  /// Cached bitmaps for different sizes
-  map<double, Bitmap> bitmaps;
   
   DECLARE_REFLECTION();
 };
@@ -133,15 +330,6 @@ Image SymbolInFont::getImage(Package& pkg, double size) {
   resample(img, resampled_image);
   return resampled_image;
 }
-Bitmap SymbolInFont::getBitmap(Package& pkg, double size) {
-  // is this bitmap already loaded/generated?
-  Bitmap& bmp = bitmaps[size];
-  if (!bmp.Ok()) {
-    // generate image, convert to bitmap, store for later use
-    bmp = Bitmap(getImage(pkg, size));
-  }
-  return bmp;
-}
 Bitmap SymbolInFont::getBitmap(Package& pkg, wxSize size) {
   // generate new bitmap
   if (!image.isReady()) {
@@ -150,27 +338,32 @@ Bitmap SymbolInFont::getBitmap(Package& pkg, wxSize size) {
   return Bitmap( image.generate(GeneratedImage::Options(size.x, size.y, &pkg, nullptr, ASPECT_BORDER)) );
 }
 
-RealSize SymbolInFont::size(Package& pkg, double size) {
+RealSize SymbolInFont::size(SymbolFont& font, double size) {
   if (actual_size.GetWidth() == 0) {
-    // we don't know what size the image will be
-    getBitmap(pkg, size);
+    // we don't know what size the image will be, render it
+    wxMutexLocker lock(font.glyphs_lock);
+    font.glyphs->glyph(font, *this, quantize_symbol_size(size));
   }
   return wxSize(actual_size * (int) (size) / (int) (img_size));
 }
 
-void SymbolInFont::update(Context& ctx) {
-  if (image.update(ctx)) {
-    // image has changed, cache is no longer valid
-    bitmaps.clear();
-  }
+bool SymbolInFont::update(Context& ctx) {
+  bool changed = image.update(ctx);
   enabled.update(ctx);
   if (text_font)
     text_font->update(ctx);
+  return changed;
 }
 void SymbolFont::update(Context& ctx) const {
+  wxMutexLocker lock(const_cast<wxMutex&>(glyphs_lock));
   // update all symbol-in-fonts
+  bool changed = false;
   FOR_EACH_CONST(sym, symbols) {
-    sym->update(ctx);
+    changed |= sym->update(ctx);
+  }
+  if (changed) {
+    // images have changed, cache is no longer valid
+    glyphs->clear();
   }
 }
 
@@ -281,27 +474,80 @@ void SymbolFont::draw(RotatedDC& dc, Context& ctx, const RealRect& rect, double
   draw(dc, rect, font_size, align, symbols);
 }
 
+/// A symbol to draw as part of a run
+struct SymbolFont::RunGlyph {
+  RunGlyph(const SymbolInFont* symbol, const wxRect& rect, const RealPoint& pos)
+    : symbol(symbol), rect(rect), pos(pos)
+  {}
+  const SymbolInFont* symbol;
+  wxRect    rect; ///< Rectangle in the atlas
+  RealPoint pos;  ///< Internal position to draw at
+};
+
 void SymbolFont::draw(RotatedDC& dc, RealRect rect, double font_size, const Alignment& align, const SplitSymbols& text) {
+  wxMutexLocker lock(glyphs_lock);
+  int size_key = quantize_symbol_size(dc.trS(font_size));
+  vector<RunGlyph> run;
   FOR_EACH_CONST(sym, text) {
     RealSize size = dc.trInvS(symbolSize(dc.trS(font_size), sym));
     RealRect sym_rect = split_left(rect, size);
-    drawSymbol(dc, sym_rect, font_size, align, *sym.symbol, sym.draw_text);
+    // draw aligned in the rectangle
+    wxRect glyph_rect = glyphs->glyph(*this, *sym.symbol, size_key);
+    RealSize  bmp_size = dc.trInvS(RealSize(glyph_rect.width, glyph_rect.height));
+    RealPoint bmp_pos  = align_in_rect(align, bmp_size, sym_rect);
+    run.push_back(RunGlyph(sym.symbol, glyph_rect, bmp_pos));
+    if (!sym.draw_text.empty() && sym.symbol->text_font) {
+      // the text goes on top of the symbol, so the run has to be drawn first
+      drawRun(dc, size_key, run);
+      drawSymbolText(dc, RealRect(bmp_pos, bmp_size), font_size, *sym.symbol, sym.draw_text);
+    }
   }
+  drawRun(dc, size_key, run);
 }
 
-void SymbolFont::drawSymbol(RotatedDC& dc, RealRect sym_rect, double font_size, const Alignment& align, SymbolInFont& sym, const String& text) {
-  // 1. draw symbol
-  // find bitmap
-  Bitmap bmp = sym.getBitmap(*this, dc.trS(font_size));
-  // draw aligned in the rectangle
-  RealSize  bmp_size = dc.trInvS(RealSize(bmp));
-  RealPoint bmp_pos  = align_in_rect(align, bmp_size, sym_rect);
-  dc.DrawBitmap(bmp, bmp_pos);
-  
-  // 2. draw text
-  if (text.empty() || !sym.text_font) return;
-  // only use the bitmap rectangle
-  sym_rect = RealRect(bmp_pos, bmp_size);
+void SymbolFont::drawRun(RotatedDC& dc, int size_key, vector<RunGlyph>& run) {
+  if (run.empty()) return;
+  if (!is_rad0(dc.getAngle())) {
+    // rotated, draw symbols one at a time
+    for (size_t i = 0 ; i < run.size() ; ++i) {
+      dc.DrawImage(glyphs->atlas(size_key).GetSubImage(run[i].rect), run[i].pos);
+    }
+    run.clear();
+    return;
+  }
+  // positions in pixels, relative to the top-left of the run
+  vector<wxPoint> pos(run.size());
+  int x0 = INT_MAX, y0 = INT_MAX, x1 = INT_MIN, y1 = INT_MIN;
+  for (size_t i = 0 ; i < run.size() ; ++i) {
+    RealPoint p = dc.tr(run[i].pos);
+    pos[i] = wxPoint(to_int(p.x), to_int(p.y));
+    x0 = min(x0, pos[i].x); x1 = max(x1, pos[i].x + run[i].rect.width);
+    y0 = min(y0, pos[i].y); y1 = max(y1, pos[i].y + run[i].rect.height);
+  }
+  SymbolGlyphCache::RunKey key;
+  key.size_key = size_key;
+  for (size_t i = 0 ; i < run.size() ; ++i) {
+    key.glyphs.push_back(make_pair(run[i].symbol, wxPoint(pos[i].x - x0, pos[i].y - y0)));
+  }
+  // drawn before?
+  const Bitmap* cached = glyphs->findRun(key);
+  Bitmap bmp;
+  if (cached) {
+    bmp = *cached;
+  } else {
+    Image img = transparent_image(max(1, x1 - x0), max(1, y1 - y0));
+    const Image& atlas = glyphs->atlas(size_key);
+    for (size_t i = 0 ; i < run.size() ; ++i) {
+      blend_over(img, atlas, run[i].rect, pos[i].x - x0, pos[i].y - y0);
+    }
+    bmp = Bitmap(img);
+    glyphs->storeRun(key, bmp);
+  }
+  dc.DrawPreRotatedBitmap(bmp, RealRect(dc.trInv(RealPoint(x0, y0)), dc.trInvS(RealSize(x1 - x0, y1 - y0))));
+  run.clear();
+}
+
+void SymbolFont::drawSymbolText(RotatedDC& dc, RealRect sym_rect, double font_size, SymbolInFont& sym, const String& text) {
   // subtract margins from size
   sym_rect.x      += font_size * sym.text_margin_left;
   sym_rect.y      += font_size * sym.text_margin_top;
@@ -335,6 +581,7 @@ void SymbolFont::drawSymbol(RotatedDC& dc, RealRect sym_rect, double font_size,
 
 Image SymbolFont::getImage(double font_size, const DrawableSymbol& sym) {
   if (!sym.symbol) return Image(1,1);
+  wxMutexLocker lock(glyphs_lock);
   if (sym.draw_text.empty() || !sym.symbol->text_font) return sym.symbol->getImage(*this, font_size);
   // with text
   Bitmap bmp(sym.symbol->getImage(*this, font_size));
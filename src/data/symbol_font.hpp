@@ -14,6 +14,7 @@
 #include <util/io/package.hpp>
 #include <data/font.hpp>
 #include <wx/regex.h>
+#include <wx/thread.h>
 
 DECLARE_POINTER_TYPE(Font);
 DECLARE_POINTER_TYPE(SymbolFont);
@@ -21,6 +22,7 @@ DECLARE_POINTER_TYPE(SymbolInFont);
 DECLARE_POINTER_TYPE(InsertSymbolMenu);
 class RotatedDC;
 struct CharInfo;
+class SymbolGlyphCache;
 
 // ----------------------------------------------------------------------------- : SymbolFont
 
@@ -89,6 +91,8 @@ class SymbolFont : public Packaged {
   bool scale_text;  ///< Should text be scaled down to fit in a symbol?
   InsertSymbolMenuP insert_symbol_menu;
   wxMenu* processed_insert_symbol_menu;
+  SymbolGlyphCache* glyphs; ///< Rendered symbols
+  wxMutex glyphs_lock;      ///< Guards glyphs and the symbol images, cards can be drawn on multiple threads
   
   friend class SymbolInFont;
   friend class InsertSymbolMenu;
@@ -98,8 +102,11 @@ class SymbolFont : public Packaged {
   /** may return nullptr */
   SymbolInFont* defaultSymbol() const;
   
-  /// Draws a single symbol inside the given rectangle
-  void drawSymbol  (RotatedDC& dc, RealRect sym_rect, double font_size, const Alignment& align, SymbolInFont& sym, const String& text);
+  struct RunGlyph;
+  /// Draws a run of symbols with a single blit
+  void drawRun     (RotatedDC& dc, int size_key, vector<RunGlyph>& run);
+  /// Draws the text on top of a symbol, bmp_rect is the rectangle of the symbol image
+  void drawSymbolText(RotatedDC& dc, RealRect bmp_rect, double font_size, SymbolInFont& sym, const String& text);
   
   /// Size of a single symbol, including spacing
   RealSize symbolSize       (double font_size, const DrawableSymbol& sym);
@@ -0,0 +1,166 @@
+//+----------------------------------------------------------------------------+
+//| Description:  Magic Set Editor - Program to make Magic (tm) cards          |
+//| Copyright:    (C) 2001 - 2017 Twan van Laarhoven and Sean Hunt             |
+//| License:      GNU General Public License 2 or later (see file COPYING)     |
+//+----------------------------------------------------------------------------+
+
+// ----------------------------------------------------------------------------- : Includes
+
+#include <util/prec.hpp>
+#include <gfx/gfx.hpp>
+
+// ----------------------------------------------------------------------------- : Gaussian kernel
+
+// Both directions are blurred separately. Pixels outside the image count as transparent.
+// Rows are processed one at a time; the vertical passes keep a value for each column,
+// so their inner loops are straight loops over a row that the compiler can vectorize.
+
+/// Below this sigma a box blur is a bad approximation, and a gaussian kernel is cheap anyway
+const double min_box_sigma = 2.0;
+
+/// The weights of a normalized gaussian kernel, from -radius to radius
+void gaussian_kernel(double sigma, vector<float>& kernel) {
+  int radius = max(1, (int)ceil(3 * sigma));
+  kernel.resize(2 * radius + 1);
+  double sigsqr2 = 1 / (2 * sigma * sigma);
+  double total = 0;
+  for (int d = -radius ; d <= radius ; ++d) {
+    total += kernel[d + radius] = (float)exp(-d * d * sigsqr2);
+  }
+  for (size_t i = 0 ; i < kernel.size() ; ++i) {
+    kernel[i] = (float)(kernel[i] / total);
+  }
+}
+
+void gaussian_blur_rows(const float* in, float* out, int w, int h, const vector<float>& kernel) {
+  int radius = (int)kernel.size() / 2;
+  for (int y = 0 ; y < h ; ++y) {
+    const float* row_in  = in  + y * w;
+    float*       row_out = out + y * w;
+    for (int x = 0 ; x < w ; ++x) {
+      int d_start = max(-radius, -x), d_end = min(radius, w - 1 - x);
+      float sum = 0;
+      for (int d = d_start ; d <= d_end ; ++d) {
+        sum += row_in[x + d] * kernel[d + radius];
+      }
+      row_out[x] = sum;
+    }
+  }
+}
+
+void gaussian_blur_columns(const float* in, float* out, int w, int h, const vector<float>& kernel) {
+  int radius = (int)kernel.size() / 2;
+  for (int y = 0 ; y < h ; ++y) {
+    float* row_out = out + y * w;
+    fill(row_out, row_out + w, 0.f);
+    int d_start = max(-radius, -y), d_end = min(radius, h - 1 - y);
+    for (int d = d_start ; d <= d_end ; ++d) {
+      const float* row_in = in + (y + d) * w;
+      float factor = kernel[d + radius];
+      for (int x = 0 ; x < w ; ++x) {
+        row_out[x] += row_in[x] * factor;
+      }
+    }
+  }
+}
+
+// ----------------------------------------------------------------------------- : Box blur
+
+/// Widths of three box blurs that together approximate a gaussian with the given sigma
+/** See "Fast Almost-Gaussian Filtering", Peter Kovesi */
+void box_sizes_for_gauss(double sigma, int radii[3]) {
+  const int n = 3;
+  int wl = (int)floor(sqrt(12 * sigma * sigma / n + 1));
+  if (wl % 2 == 0) wl--;
+  int wu = wl + 2;
+  int m = (int)floor((12 * sigma * sigma - n * wl * wl - 4 * n * wl - 3 * n) / (-4 * wl - 4) + 0.5);
+  for (int i = 0 ; i < n ; ++i) {
+    radii[i] = ((i < m ? wl : wu) - 1) / 2;
+  }
+}
+
+/// Box blur with the given radius, a running sum over each row
+void box_blur_rows(const float* in, float* out, int w, int h, int radius) {
+  float scale = 1.f / (2 * radius + 1);
+  for (int y = 0 ; y < h ; ++y) {
+    const float* row_in  = in  + y * w;
+    float*       row_out = out + y * w;
+    // invariant: before writing x, sum contains row_in[x-radius .. x+radius]
+    float sum = 0;
+    for (int x = 0 ; x < min(radius, w) ; ++x) sum += row_in[x];
+    for (int x = 0 ; x < w ; ++x) {
+      if (x + radius < w)  sum += row_in[x + radius];
+      row_out[x] = sum * scale;
+      if (x - radius >= 0) sum -= row_in[x - radius];
+    }
+  }
+}
+
+/// Box blur with the given radius, a running sum for each column at the same time
+void box_blur_columns(const float* in, float* out, int w, int h, int radius, float* sums) {
+  float scale = 1.f / (2 * radius + 1);
+  fill(sums, sums + w, 0.f);
+  for (int y = 0 ; y < min(radius, h) ; ++y) {
+    const float* row_in = in + y * w;
+    for (int x = 0 ; x < w ; ++x) sums[x] += row_in[x];
+  }
+  for (int y = 0 ; y < h ; ++y) {
+    if (y + radius < h) {
+      const float* row_in = in + (y + radius) * w;
+      for (int x = 0 ; x < w ; ++x) sums[x] += row_in[x];
+    }
+    float* row_out = out + y * w;
+    for (int x = 0 ; x < w ; ++x) row_out[x] = sums[x] * scale;
+    if (y - radius >= 0) {
+      const float* row_in = in + (y - radius) * w;
+      for (int x = 0 ; x < w ; ++x) sums[x] -= row_in[x];
+    }
+  }
+}
+
+// ----------------------------------------------------------------------------- : Blur
+
+void blur_alpha(const Byte* in, Byte* out, int w, int h, double sigma_x, double sigma_y, BlurMethod method) {
+  size_t n = (size_t)w * h;
+  if (n == 0) return;
+  vector<float> a(in, in + n), b(n);
+  // blur horizontally, from a to b
+  if (sigma_x <= 0) {
+    b = a;
+  } else if (method == BLUR_GAUSSIAN || sigma_x < min_box_sigma) {
+    vector<float> kernel;
+    gaussian_kernel(sigma_x, kernel);
+    gaussian_blur_rows(&a[0], &b[0], w, h, kernel);
+  } else {
+    int radii[3];
+    box_sizes_for_gauss(sigma_x, radii);
+    box_blur_rows(&a[0], &b[0], w, h, radii[0]);
+    box_blur_rows(&b[0], &a[0], w, h, radii[1]);
+    box_blur_rows(&a[0], &b[0], w, h, radii[2]);
+  }
+  // blur vertically, from b to a
+  if (sigma_y <= 0) {
+    a = b;
+  } else if (method == BLUR_GAUSSIAN || sigma_y < min_box_sigma) {
+    vector<float> kernel;
+    gaussian_kernel(sigma_y, kernel);
+    gaussian_blur_columns(&b[0], &a[0], w, h, kernel);
+  } else {
+    int radii[3];
+    box_sizes_for_gauss(sigma_y, radii);
+    vector<float> sums(w);
+    box_blur_columns(&b[0], &a[0], w, h, radii[0], &sums[0]);
+    box_blur_columns(&a[0], &b[0], w, h, radii[1], &sums[0]);
+    box_blur_columns(&b[0], &a[0], w, h, radii[2], &sums[0]);
+  }
+  // store
+  for (size_t i = 0 ; i < n ; ++i) {
+    out[i] = (Byte)max(0, min(255, (int)(a[i] + 0.5f)));
+  }
+}
+
+void blur_alpha(Image& img, double sigma, BlurMethod method) {
+  if (!img.HasAlpha()) return;
+  Byte* alpha = img.GetAlpha();
+  blur_alpha(alpha, alpha, img.GetWidth(), img.GetHeight(), sigma, sigma, method);
+}
@@ -0,0 +1,176 @@
+//+----------------------------------------------------------------------------+
+//| Description:  Magic Set Editor - Program to make Magic (tm) cards          |
+//| Copyright:    (C) 2001 - 2017 Twan van Laarhoven and Sean Hunt             |
+//| License:      GNU General Public License 2 or later (see file COPYING)     |
+//+----------------------------------------------------------------------------+
+
+// ----------------------------------------------------------------------------- : Includes
+
+#include <util/prec.hpp>
+#include <gfx/canvas.hpp>
+#include <gfx/rasterize.hpp>
+
+// ----------------------------------------------------------------------------- : Blending
+
+/// Blend a color into a pixel with the given opacity in [0..255]
+inline void blend_pixel(Byte* p, Byte r, Byte g, Byte b, int alpha) {
+  p[0] = p[0] + ((r - p[0]) * alpha) / 255;
+  p[1] = p[1] + ((g - p[1]) * alpha) / 255;
+  p[2] = p[2] + ((b - p[2]) * alpha) / 255;
+}
+
+// ----------------------------------------------------------------------------- : ImageCanvas
+
+ImageCanvas::ImageCanvas(int width, int height)
+  : image(width, height) // initialized to black
+  , clip(0, 0, width, height)
+{}
+
+void ImageCanvas::setClip(const wxRect& rect) {
+  clip = rect.Intersect(wxRect(0, 0, GetWidth(), GetHeight()));
+}
+void ImageCanvas::resetClip() {
+  clip = wxRect(0, 0, GetWidth(), GetHeight());
+}
+
+void ImageCanvas::clear(const Color& color) {
+  fillRect(clip, AColor(color, 255));
+}
+
+void ImageCanvas::fillRect(const wxRect& rect, const AColor& color) {
+  wxRect r = rect.Intersect(clip);
+  if (r.IsEmpty() || color.alpha == 0) return;
+  int width = GetWidth();
+  Byte* data = image.GetData();
+  for (int y = r.y ; y < r.y + r.height ; ++y) {
+    Byte* p = data + 3 * (y * width + r.x);
+    for (int x = 0 ; x < r.width ; ++x, p += 3) {
+      if (color.alpha == 255) {
+        p[0] = color.Red(); p[1] = color.Green(); p[2] = color.Blue();
+      } else {
+        blend_pixel(p, color.Red(), color.Green(), color.Blue(), color.alpha);
+      }
+    }
+  }
+}
+
+void ImageCanvas::drawImage(const Image& img, int x, int y, ImageCombine combine) {
+  if (combine > COMBINE_NORMAL) {
+    // combine with what is already there, the result gets the alpha of img, see combine_image
+    Image source = getSubImage(wxRect(x, y, img.GetWidth(), img.GetHeight()));
+    combine_image(source, img, combine);
+    drawImage(source, x, y, COMBINE_NORMAL);
+    return;
+  }
+  int iw = img.GetWidth();
+  wxRect r = wxRect(x, y, iw, img.GetHeight()).Intersect(clip);
+  if (r.IsEmpty()) return;
+  int width = GetWidth();
+  Byte* data = image.GetData();
+  const Byte* src   = img.GetData();
+  const Byte* alpha = img.HasAlpha() ? img.GetAlpha() : nullptr;
+  bool mask = img.HasMask();
+  Byte mr = img.GetMaskRed(), mg = img.GetMaskGreen(), mb = img.GetMaskBlue();
+  for (int py = r.y ; py < r.y + r.height ; ++py) {
+    Byte*       p = data + 3 * (py * width + r.x);
+    const Byte* s = src  + 3 * ((py - y) * iw + r.x - x);
+    const Byte* a = alpha ? alpha + (py - y) * iw + r.x - x : nullptr;
+    for (int px = 0 ; px < r.width ; ++px, p += 3, s += 3) {
+      int opacity = a ? *a++ : 255;
+      if (mask && s[0] == mr && s[1] == mg && s[2] == mb) opacity = 0;
+      if (opacity == 255) {
+        p[0] = s[0]; p[1] = s[1]; p[2] = s[2];
+      } else if (opacity > 0) {
+        blend_pixel(p, s[0], s[1], s[2], opacity);
+      }
+    }
+  }
+}
+
+void ImageCanvas::drawCoverage(const Byte* coverage, int x, int y, int w, int h, const AColor& color, int repeat) {
+  wxRect r = wxRect(x, y, w, h).Intersect(clip);
+  if (r.IsEmpty() || color.alpha == 0) return;
+  int width = GetWidth();
+  Byte* data = image.GetData();
+  for (int py = r.y ; py < r.y + r.height ; ++py) {
+    Byte*       p = data + 3 * (py * width + r.x);
+    const Byte* c = coverage + (py - y) * w + r.x - x;
+    for (int px = 0 ; px < r.width ; ++px, p += 3, ++c) {
+      int opacity = (*c * color.alpha) / 255;
+      if (opacity == 0) continue;
+      for (int i = 0 ; i < repeat ; ++i) {
+        blend_pixel(p, color.Red(), color.Green(), color.Blue(), opacity);
+      }
+    }
+  }
+}
+
+void ImageCanvas::drawCoverage(const CoverageBuffer& coverage, int x, int y, const AColor& color) {
+  int width = GetWidth();
+  Byte* data = image.GetData();
+  for (int cy = 0 ; cy < coverage.height ; ++cy) {
+    Byte* p = data + 3 * ((y + cy) * width + x);
+    for (int cx = 0 ; cx < coverage.width ; ++cx, p += 3) {
+      int opacity = (int)(coverage.at(cx, cy) * color.alpha + 0.5f);
+      if (opacity >= 255) {
+        p[0] = color.Red(); p[1] = color.Green(); p[2] = color.Blue();
+      } else if (opacity > 0) {
+        blend_pixel(p, color.Red(), color.Green(), color.Blue(), opacity);
+      }
+    }
+  }
+}
+
+bool ImageCanvas::pointsBounds(const vector<RealPoint>& points, double margin, wxRect& out) const {
+  if (points.empty()) return false;
+  double x0 = points[0].x, y0 = points[0].y, x1 = x0, y1 = y0;
+  for (size_t i = 1 ; i < points.size() ; ++i) {
+    x0 = min(x0, points[i].x); y0 = min(y0, points[i].y);
+    x1 = max(x1, points[i].x); y1 = max(y1, points[i].y);
+  }
+  int l = (int)floor(x0 - margin), t = (int)floor(y0 - margin);
+  int r = (int)ceil (x1 + margin), b = (int)ceil (y1 + margin);
+  out = wxRect(l, t, r - l, b - t).Intersect(clip);
+  return !out.IsEmpty();
+}
+
+void ImageCanvas::fillPolygon(const vector<RealPoint>& points, const AColor& color) {
+  wxRect r;
+  if (color.alpha == 0 || !pointsBounds(points, 0, r)) return;
+  vector<Vector2D> moved(points.size());
+  for (size_t i = 0 ; i < points.size() ; ++i) {
+    moved[i] = Vector2D(points[i].x - r.x, points[i].y - r.y);
+  }
+  ScanlineRasterizer rasterizer(r.width, r.height);
+  rasterizer.addPolygon(moved);
+  CoverageBuffer coverage;
+  rasterizer.render(coverage, FILL_EVEN_ODD);
+  drawCoverage(coverage, r.x, r.y, color);
+}
+
+void ImageCanvas::strokePolyline(const vector<RealPoint>& points, double pen_width, const AColor& color, bool closed) {
+  wxRect r;
+  if (color.alpha == 0 || !pointsBounds(points, pen_width * 0.5 + 1, r)) return;
+  vector<Vector2D> moved(points.size());
+  for (size_t i = 0 ; i < points.size() ; ++i) {
+    moved[i] = Vector2D(points[i].x - r.x, points[i].y - r.y);
+  }
+  ScanlineRasterizer rasterizer(r.width, r.height);
+  rasterizer.addStroke(moved, pen_width, closed);
+  CoverageBuffer coverage;
+  rasterizer.render(coverage, FILL_NONZERO);
+  drawCoverage(coverage, r.x, r.y, color);
+}
+
+Image ImageCanvas::getSubImage(const wxRect& rect) const {
+  Image out(rect.width, rect.height); // initialized to black
+  wxRect r = rect.Intersect(wxRect(0, 0, GetWidth(), GetHeight()));
+  if (r.IsEmpty()) return out;
+  int width = GetWidth();
+  for (int y = r.y ; y < r.y + r.height ; ++y) {
+    memcpy(out.GetData() + 3 * ((y - rect.y) * rect.width + r.x - rect.x),
+           image.GetData() + 3 * (y * width + r.x),
+           3 * r.width);
+  }
+  return out;
+}
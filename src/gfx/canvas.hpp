@@ -0,0 +1,72 @@
+//+----------------------------------------------------------------------------+
+//| Description:  Magic Set Editor - Program to make Magic (tm) cards          |
+//| Copyright:    (C) 2001 - 2017 Twan van Laarhoven and Sean Hunt             |
+//| License:      GNU General Public License 2 or later (see file COPYING)     |
+//+----------------------------------------------------------------------------+
+
+#ifndef HEADER_GFX_CANVAS
+#define HEADER_GFX_CANVAS
+
+/** @file gfx/canvas.hpp
+ *
+ *  Drawing into a plain image buffer, without a DC.
+ */
+
+// ----------------------------------------------------------------------------- : Includes
+
+#include <util/prec.hpp>
+#include <util/real_point.hpp>
+#include <gfx/gfx.hpp>
+
+class CoverageBuffer;
+
+// ----------------------------------------------------------------------------- : ImageCanvas
+
+/// An image that can be drawn on, the software equivalent of a wxMemoryDC.
+/** All drawing is anti aliased and done directly on the pixels of an Image,
+ *  so unlike a DC, different canvases can be used from different threads.
+ *  Coordinates are in pixels, drawing is clipped to the clipping rectangle.
+ */
+class ImageCanvas {
+  public:
+  ImageCanvas(int width, int height);
+
+  inline int GetWidth()  const { return image.GetWidth();  }
+  inline int GetHeight() const { return image.GetHeight(); }
+  /// The image drawn so far
+  inline const Image& getImage() const { return image; }
+
+  /// Restrict drawing to a rectangle
+  void setClip(const wxRect& rect);
+  /// Allow drawing on the whole canvas
+  void resetClip();
+
+  /// Fill the clipping rectangle with a color
+  void clear(const Color& color);
+  /// Fill a rectangle with a color, blending if it is translucent
+  void fillRect(const wxRect& rect, const AColor& color);
+  /// Draw an image with its top-left corner at (x,y), using its alpha channel or mask
+  void drawImage(const Image& img, int x, int y, ImageCombine combine = COMBINE_NORMAL);
+  /// Draw a color, using w*h bytes of alpha coverage, repeat times
+  void drawCoverage(const Byte* coverage, int x, int y, int w, int h, const AColor& color, int repeat = 1);
+
+  /// Fill a polygon with a color, using the even-odd rule
+  void fillPolygon(const vector<RealPoint>& points, const AColor& color);
+  /// Draw the outline of a polygon with a pen of the given width
+  void strokePolyline(const vector<RealPoint>& points, double pen_width, const AColor& color, bool closed = true);
+
+  /// Get a copy of a part of the canvas, used to save the background
+  Image getSubImage(const wxRect& rect) const;
+
+  private:
+  Image  image;
+  wxRect clip;
+
+  /// Draw coverage from a rasterizer whose origin is at (x,y)
+  void drawCoverage(const CoverageBuffer& coverage, int x, int y, const AColor& color);
+  /// The rectangle of the clipped bounding box of some points, returns false if it is empty
+  bool pointsBounds(const vector<RealPoint>& points, double margin, wxRect& out) const;
+};
+
+// ----------------------------------------------------------------------------- : EOF
+#endif
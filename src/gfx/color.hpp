@@ -129,8 +129,11 @@ Color saturate(const Color& c, double amount);
  */
 RGB recolor(RGB x, RGB cr, RGB cg, RGB cb, RGB cw);
 void recolor(Image& img, RGB cr, RGB cg, RGB cb, RGB cw);
+/// Recolor n pixels
+void recolor(RGB* data, size_t n, RGB cr, RGB cg, RGB cb, RGB cw);
 /// Like recolor: map green to similar black/white and blue to complementary white/black
 void recolor(Image& img, RGB cr);
+void recolor(RGB* data, size_t n, RGB cr);
 
 /// Fills an image with the specified color
 void fill_image(Image& image, RGB color);
@@ -8,12 +8,15 @@
 
 #include <util/prec.hpp>
 #include <gfx/generated_image.hpp>
+#include <gfx/image_pool.hpp>
 #include <util/io/package.hpp>
 #include <util/error.hpp>
 #include <data/symbol.hpp>
 #include <data/field/symbol.hpp>
 #include <render/symbol/filter.hpp>
 #include <gui/util.hpp> // load_resource_image
+#include <wx/thread.h>
+#include <algorithm>
 
 // ----------------------------------------------------------------------------- : GeneratedImage
 
@@ -24,7 +27,7 @@ GeneratedImageP GeneratedImage::toImage(const ScriptValueP& thisP) const {
 }
 
 Image GeneratedImage::generateConform(const Options& options) const {
-  return conform_image(generate(options),options);
+  return conform_image(generateReduced(options),options);
 }
 
 Image conform_image(const Image& img, const GeneratedImage::Options& options) {
@@ -78,6 +81,48 @@ Image conform_image(const Image& img, const GeneratedImage::Options& options) {
   return image;
 }
 
+// ----------------------------------------------------------------------------- : PixelFilterImage
+
+Image PixelFilterImage::generate(const Options& opt) const {
+  return generateChain(opt, false);
+}
+Image PixelFilterImage::generateReduced(const Options& opt) const {
+  // the filters don't care about the size
+  return generateChain(opt, true);
+}
+
+Image PixelFilterImage::generateChain(const Options& opt, bool reduced) const {
+  // find the chain of pixel filters, outermost first
+  vector<const PixelFilterImage*> filters;
+  bool need_alpha = false;
+  const GeneratedImage* source = this;
+  while (const PixelFilterImage* filter = dynamic_cast<const PixelFilterImage*>(source)) {
+    if (filter->changesPixels()) {
+      filters.push_back(filter);
+      need_alpha = need_alpha || filter->needsAlpha();
+    }
+    source = filter->image.get();
+  }
+  Image img = reduced ? source->generateReduced(opt) : source->generate(opt);
+  if (filters.empty()) return img;
+  int w = img.GetWidth(), h = img.GetHeight();
+  if (need_alpha && !img.HasAlpha()) {
+    img.SetAlpha(); // uninitialized
+    memset(img.GetAlpha(), 255, w * h);
+  }
+  // apply, innermost filter first
+  Byte* data  = img.GetData();
+  Byte* alpha = img.HasAlpha() ? img.GetAlpha() : nullptr;
+  for (int y = 0 ; y < h ; ++y) {
+    Byte* row_rgb   = data + 3 * y * w;
+    Byte* row_alpha = alpha ? alpha + y * w : nullptr;
+    for (size_t i = filters.size() ; i > 0 ; --i) {
+      filters[i - 1]->filterRow(row_rgb, row_alpha, w);
+    }
+  }
+  return img;
+}
+
 // ----------------------------------------------------------------------------- : BlankImage
 
 Image BlankImage::generate(const Options& opt) const {
@@ -158,10 +203,11 @@ bool SetMaskImage::operator == (const GeneratedImage& that) const {
                && *mask  == *that2->mask;
 }
 
-Image SetAlphaImage::generate(const Options& opt) const {
-  Image img = image->generate(opt);
-  set_alpha(img, alpha);
-  return img;
+void SetAlphaImage::filterRow(Byte* rgb, Byte* row_alpha, int n) const {
+  Byte b_alpha = Byte(alpha * 255);
+  for (int i = 0 ; i < n ; ++i) {
+    row_alpha[i] = (row_alpha[i] * b_alpha) / 255;
+  }
 }
 bool SetAlphaImage::operator == (const GeneratedImage& that) const {
   const SetAlphaImage* that2 = dynamic_cast<const SetAlphaImage*>(&that);
@@ -171,9 +217,6 @@ bool SetAlphaImage::operator == (const GeneratedImage& that) const {
 
 // ----------------------------------------------------------------------------- : SetCombineImage
 
-Image SetCombineImage::generate(const Options& opt) const {
-  return image->generate(opt);
-}
 ImageCombine SetCombineImage::combine() const {
   return image_combine;
 }
@@ -185,10 +228,8 @@ bool SetCombineImage::operator == (const GeneratedImage& that) const {
 
 // ----------------------------------------------------------------------------- : SaturateImage
 
-Image SaturateImage::generate(const Options& opt) const {
-  Image img = image->generate(opt);
-  saturate(img, amount);
-  return img;
+void SaturateImage::filterRow(Byte* rgb, Byte* alpha, int n) const {
+  saturate(rgb, n, amount);
 }
 bool SaturateImage::operator == (const GeneratedImage& that) const {
   const SaturateImage* that2 = dynamic_cast<const SaturateImage*>(&that);
@@ -198,10 +239,8 @@ bool SaturateImage::operator == (const GeneratedImage& that) const {
 
 // ----------------------------------------------------------------------------- : InvertImage
 
-Image InvertImage::generate(const Options& opt) const {
-  Image img = image->generate(opt);
-  invert(img);
-  return img;
+void InvertImage::filterRow(Byte* rgb, Byte* alpha, int n) const {
+  invert(rgb, n);
 }
 bool InvertImage::operator == (const GeneratedImage& that) const {
   const InvertImage* that2 = dynamic_cast<const InvertImage*>(&that);
@@ -210,10 +249,8 @@ bool InvertImage::operator == (const GeneratedImage& that) const {
 
 // ----------------------------------------------------------------------------- : RecolorImage
 
-Image RecolorImage::generate(const Options& opt) const {
-  Image img = image->generate(opt);
-  recolor(img, color);
-  return img;
+void RecolorImage::filterRow(Byte* rgb, Byte* alpha, int n) const {
+  recolor((RGB*)rgb, n, color);
 }
 bool RecolorImage::operator == (const GeneratedImage& that) const {
   const RecolorImage* that2 = dynamic_cast<const RecolorImage*>(&that);
@@ -221,10 +258,8 @@ bool RecolorImage::operator == (const GeneratedImage& that) const {
                && color == that2->color;
 }
 
-Image RecolorImage2::generate(const Options& opt) const {
-  Image img = image->generate(opt);
-  recolor(img, red,green,blue,white);
-  return img;
+void RecolorImage2::filterRow(Byte* rgb, Byte* alpha, int n) const {
+  recolor((RGB*)rgb, n, red,green,blue,white);
 }
 bool RecolorImage2::operator == (const GeneratedImage& that) const {
   const RecolorImage2* that2 = dynamic_cast<const RecolorImage2*>(&that);
@@ -237,9 +272,13 @@ bool RecolorImage2::operator == (const GeneratedImage& that) const {
 
 // ----------------------------------------------------------------------------- : FlipImage
 
-Image FlipImageHorizontal::generate(const Options& opt) const {
-  Image img = image->generate(opt);
-  return flip_image_horizontal(img);
+void FlipImageHorizontal::filterRow(Byte* rgb, Byte* alpha, int n) const {
+  for (int i = 0, j = n - 1 ; i < j ; ++i, --j) {
+    swap(rgb[3*i    ], rgb[3*j    ]);
+    swap(rgb[3*i + 1], rgb[3*j + 1]);
+    swap(rgb[3*i + 2], rgb[3*j + 2]);
+    if (alpha) swap(alpha[i], alpha[j]);
+  }
 }
 bool FlipImageHorizontal::operator == (const GeneratedImage& that) const {
   const FlipImageHorizontal* that2 = dynamic_cast<const FlipImageHorizontal*>(&that);
@@ -317,56 +356,6 @@ bool CropImage::operator == (const GeneratedImage& that) const {
 
 // ----------------------------------------------------------------------------- : DropShadowImage
 
-/// Preform a gaussian blur, from the image in of w*h bytes to out
-/** out is scaled some scaling, this is the return value */
-UInt gaussian_blur(Byte* in, UInt* out, int w, int h, double radius) {
-  // blur horizontally
-  UInt* blur_x = new UInt[w*h]; // scaled by total_x, so in [0..255*total_x]
-  memset(blur_x, 0, w*h*sizeof(UInt));
-  UInt total_x = 0;
-  {
-    double sigma = radius * w;
-    double mult = (1 << 8) / (sqrt(2 * M_PI) * sigma);
-    double sigsqr2 = 1 / (2 * sigma * sigma);
-    int range = min(w, (int)(3*sigma));
-    for (int d = -range ; d <= range ; ++d) {
-      UInt factor = (int)( mult * exp(-d * d * sigsqr2) );
-      total_x += factor;
-      if (factor > 0) {
-        int x_start = max(0, -d), x_end = min(w, w-d);
-        for (int y = 0 ; y < h ; ++y) {
-          for (int x = x_start ; x < x_end ; ++x) {
-            blur_x[x + y*w] += in[x + d + y*w] * factor;
-          }
-        }
-      }
-    }
-  }
-  // blur vertically
-  memset(out, 0, w*h*sizeof(UInt));
-  UInt total_y = 0;
-  {
-    double sigma = radius * h;
-    double mult = (1 << 8) / (sqrt(2 * M_PI) * sigma);
-    double sigsqr2 = 1 / (2 * sigma * sigma);
-    int range = min(h, (int)(3*sigma));
-    for (int d = -range ; d <= range ; ++d) {
-      UInt factor = (UInt)( mult * exp(-d * d * sigsqr2) );
-      total_y += factor;
-      if (factor > 0) {
-        int y_start = max(0, -d), y_end = min(h, h-d);
-        for (int y = y_start ; y < y_end ; ++y) {
-          for (int x = 0 ; x < w ; ++x) {
-            out[x + y*w] += blur_x[x + (d + y)*w] * factor;
-          }
-        }
-      }
-    }
-  }
-  delete[] blur_x;
-  return total_x * total_y;
-}
-
 Image DropShadowImage::generate(const Options& opt) const {
   // sub image
   Image img = image->generate(opt);
@@ -376,9 +365,11 @@ Image DropShadowImage::generate(const Options& opt) const {
   }
   int w = img.GetWidth(), h = img.GetHeight();
   Byte* alpha = img.GetAlpha();
-  // blur
-  UInt* shadow = new UInt[w*h];
-  UInt total = 255 * gaussian_blur(alpha, shadow, w, h, shadow_blur_radius);
+  // blur, the radius is relative to the size of the image
+  vector<Byte> shadow(w*h);
+  if (w > 0 && h > 0) {
+    blur_alpha(alpha, &shadow[0], w, h, shadow_blur_radius * w, shadow_blur_radius * h);
+  }
   // combine
   Byte* data = img.GetData();
   int dw = int(w * offset_x), dh = int(h * offset_y);
@@ -390,7 +381,7 @@ Image DropShadowImage::generate(const Options& opt) const {
     for (int x = x_start ; x < x_end ; ++x) {
       int p  = x + y * w; // pixel we are working on
       int a = alpha[p];
-      int shad = ((((255 - a)*sa)>>16) * shadow[p - delta]) / total; // amount of shadow to add
+      int shad = ((((255 - a)*sa)>>16) * shadow[p - delta]) / 255; // amount of shadow to add
       int factor = max(1, a + shad); // divide by this
       data[3 * p    ] = (a * data[3 * p    ] + shad * shadow_color.Red()  ) / factor;
       data[3 * p + 1] = (a * data[3 * p + 1] + shad * shadow_color.Green()) / factor;
@@ -399,8 +390,6 @@ Image DropShadowImage::generate(const Options& opt) const {
     }
   }
   //memset(data,0,3*w*h);
-  // cleanup
-  delete[] shadow;
   return img;
 }
 bool DropShadowImage::operator == (const GeneratedImage& that) const {
@@ -414,12 +403,14 @@ bool DropShadowImage::operator == (const GeneratedImage& that) const {
 // ----------------------------------------------------------------------------- : PackagedImage
 
 Image PackagedImage::generate(const Options& opt) const {
-  // TODO : use opt.width and opt.height?
+  Options full(0, 0, opt.package, opt.local_package);
+  return generateReduced(full);
+}
+Image PackagedImage::generateReduced(const Options& opt) const {
   // open file from package
   if (!opt.package) throw ScriptError(_("Can only load images in a context where an image is expected"));
-  InputStreamP file = opt.package->openIn(filename);
   Image img;
-  if (image_load_file(img, *file)) {
+  if (image_pool.load(img, *opt.package, filename, max(0, opt.width), max(0, opt.height))) {
     if (img.HasMask()) img.InitAlpha(); // we can't handle masks
     return img;
   } else {
@@ -448,6 +439,76 @@ bool BuiltInImage::operator == (const GeneratedImage& that) const {
 
 // ----------------------------------------------------------------------------- : SymbolToImage
 
+/// Cache of rendered and filtered symbols
+/** The same symbol variation is usually shown on every card (the set symbol in each rarity),
+ *  so the result of rendering it can be shared by all cards.
+ *  Entries are identified by the Package::fileIdentity of the symbol file, the age of its last change,
+ *  the variation and the size. Entries for older ages of a symbol are removed when a newer one is stored.
+ */
+class SymbolImageCache {
+  public:
+  /// Find a rendered symbol, returns a copy of the image
+  bool find(const String& key, Age age, const SymbolVariation& variation, int width, int height, Image& out) {
+    wxMutexLocker lock(mutex);
+    for (size_t i = 0 ; i < entries.size() ; ++i) {
+      const Entry& e = entries[i];
+      if (e.age == age && e.width == width && e.height == height
+          && e.key == key && (e.variation.get() == &variation || *e.variation == variation)) {
+        out = e.image.Copy(); // the caller may modify the image
+        // move to front
+        rotate(entries.begin(), entries.begin() + i, entries.begin() + i + 1);
+        return true;
+      }
+    }
+    return false;
+  }
+  /// Store a rendered symbol
+  void store(const String& key, Age age, const SymbolVariationP& variation, int width, int height, const Image& image) {
+    wxMutexLocker lock(mutex);
+    // remove entries for older versions of this symbol
+    for (size_t i = 0 ; i < entries.size() ; ) {
+      const Entry& e = entries[i];
+      if (e.key == key && e.age < age) {
+        entries.erase(entries.begin() + i);
+      } else {
+        ++i;
+      }
+    }
+    Entry e;
+    e.key       = key;
+    e.age       = age;
+    e.variation = variation;
+    e.width     = width;
+    e.height    = height;
+    e.image     = image.Copy();
+    entries.insert(entries.begin(), e);
+    if (entries.size() > max_entries) entries.pop_back();
+  }
+  /// Remove all entries
+  void clear() {
+    wxMutexLocker lock(mutex);
+    entries.clear();
+  }
+  private:
+  struct Entry {
+    Entry() : age(0) {}
+    String           key;      ///< fileIdentity of the symbol file, empty for the default symbol
+    Age              age;
+    SymbolVariationP variation;
+    int              width, height;
+    Image            image;
+  };
+  static const size_t max_entries = 32;
+  wxMutex mutex;
+  vector<Entry> entries; ///< most recently used first
+};
+SymbolImageCache symbol_image_cache;
+
+void clear_symbol_image_cache() {
+  symbol_image_cache.clear();
+}
+
+
 SymbolToImage::SymbolToImage(bool is_local, const String& filename, Age age, const SymbolVariationP& variation)
   : is_local(is_local), filename(filename), age(age), variation(variation)
 {}
@@ -457,20 +518,32 @@ Image SymbolToImage::generate(const Options& opt) const {
   // TODO : use opt.width and opt.height?
   Package* package = is_local ? opt.local_package : opt.package;
   if (!package) throw ScriptError(_("Can only load images in a context where an image is expected"));
+  int size = max(100, 3*max(opt.width,opt.height));
+  int width = size, height = size;
+  if (opt.width > 1 && opt.height > 1) {
+    width  = size * opt.width  / max(opt.width,opt.height);
+    height = size * opt.height / max(opt.width,opt.height);
+  }
+  // rendered before?
+  Image img;
+  String key = filename.empty() ? String() : package->fileIdentity(filename);
+  bool cacheable = filename.empty() || !key.empty();
+  if (cacheable && symbol_image_cache.find(key, age, *variation, width, height, img)) {
+    return img;
+  }
   SymbolP the_symbol;
   if (filename.empty()) {
     the_symbol = default_symbol();
   } else {
     the_symbol = package->readFile<SymbolP>(filename);
   }
-  int size = max(100, 3*max(opt.width,opt.height));
   if (opt.width <= 1 || opt.height <= 1) {
-    return render_symbol(the_symbol, *variation->filter, variation->border_radius, size, size);
+    img = render_symbol(the_symbol, *variation->filter, variation->border_radius, size, size);
   } else {
-    int width  = size * opt.width  / max(opt.width,opt.height);
-    int height = size * opt.height / max(opt.width,opt.height);
-    return render_symbol(the_symbol, *variation->filter, variation->border_radius, width, height, false, true);
+    img = render_symbol(the_symbol, *variation->filter, variation->border_radius, width, height, false, true);
   }
+  if (cacheable) symbol_image_cache.store(key, age, variation, width, height, img);
+  return img;
 }
 bool SymbolToImage::operator == (const GeneratedImage& that) const {
   const SymbolToImage* that2 = dynamic_cast<const SymbolToImage*>(&that);
@@ -490,12 +563,16 @@ ImageValueToImage::ImageValueToImage(const String& filename, Age age)
 ImageValueToImage::~ImageValueToImage() {}
 
 Image ImageValueToImage::generate(const Options& opt) const {
-  // TODO : use opt.width and opt.height?
+  return load(opt, 0, 0);
+}
+Image ImageValueToImage::generateReduced(const Options& opt) const {
+  return load(opt, max(0, opt.width), max(0, opt.height));
+}
+Image ImageValueToImage::load(const Options& opt, int min_width, int min_height) const {
   if (!opt.local_package) throw ScriptError(_("Can only load images in a context where an image is expected"));
   Image image;
   if (!filename.empty()) {
-    InputStreamP image_file = opt.local_package->openIn(filename);
-    image_load_file(image, *image_file);
+    image_pool.load(image, *opt.local_package, filename, min_width, min_height);
   }
   if (!image.Ok()) {
     image = Image(max(1,opt.width), max(1,opt.height));
@@ -47,6 +47,11 @@ class GeneratedImage : public ScriptValue {
   Image generateConform(const Options&) const;
   /// Generate the image
   virtual Image generate(const Options&) const = 0;
+  /// Generate the image, when it is resized to the size in the options afterwards
+  /** The result can be smaller than that of generate(), but it is not smaller than the requested size,
+   *  so the image can be decoded at a reduced resolution.
+   */
+  virtual Image generateReduced(const Options& opt) const { return generate(opt); }
   /// How must the image be combined with the background?
   virtual ImageCombine combine() const { return COMBINE_DEFAULT; }
   /// Equality should mean that every pixel in the generated images is the same if the same options are used
@@ -82,6 +87,31 @@ class SimpleFilterImage : public GeneratedImage {
   GeneratedImageP image;
 };
 
+// ----------------------------------------------------------------------------- : PixelFilterImage
+
+/// A filter that changes every row of an image independently of the other rows
+/** A chain of directly nested PixelFilterImages is applied in a single pass:
+ *  the innermost other image is generated, and then for each row all filters are applied in turn,
+ *  while that row is still in the cache. No intermediate images are made.
+ */
+class PixelFilterImage : public SimpleFilterImage {
+  public:
+  inline PixelFilterImage(const GeneratedImageP& image)
+    : SimpleFilterImage(image)
+  {}
+  virtual Image generate(const Options& opt) const;
+  virtual Image generateReduced(const Options& opt) const;
+  protected:
+  /// Apply the filter to a row of n pixels, alpha is nullptr if the image has no alpha channel
+  virtual void filterRow(Byte* rgb, Byte* alpha, int n) const = 0;
+  /// Does filterRow need an alpha channel?
+  virtual bool needsAlpha() const { return false; }
+  /// Does filterRow change anything at all?
+  virtual bool changesPixels() const { return true; }
+  private:
+  Image generateChain(const Options& opt, bool reduced) const;
+};
+
 // ----------------------------------------------------------------------------- : BlankImage
 
 /// An image generator that returns a blank image
@@ -162,13 +192,15 @@ class SetMaskImage : public SimpleFilterImage {
 };
 
 /// Change the alpha channel of an image
-class SetAlphaImage : public SimpleFilterImage {
+class SetAlphaImage : public PixelFilterImage {
   public:
   inline SetAlphaImage(const GeneratedImageP& image, double alpha)
-    : SimpleFilterImage(image), alpha(alpha)
+    : PixelFilterImage(image), alpha(alpha)
   {}
-  virtual Image generate(const Options& opt) const;
   virtual bool operator == (const GeneratedImage& that) const;
+  protected:
+  virtual void filterRow(Byte* rgb, Byte* alpha, int n) const;
+  virtual bool needsAlpha() const { return true; }
   private:
   double alpha;
 };
@@ -176,14 +208,16 @@ class SetAlphaImage : public SimpleFilterImage {
 // ----------------------------------------------------------------------------- : SetCombineImage
 
 /// Change the combine mode
-class SetCombineImage : public SimpleFilterImage {
+class SetCombineImage : public PixelFilterImage {
   public:
   inline SetCombineImage(const GeneratedImageP& image, ImageCombine image_combine)
-    : SimpleFilterImage(image), image_combine(image_combine)
+    : PixelFilterImage(image), image_combine(image_combine)
   {}
-  virtual Image generate(const Options& opt) const;
   virtual ImageCombine combine() const;
   virtual bool operator == (const GeneratedImage& that) const;
+  protected:
+  virtual void filterRow(Byte* rgb, Byte* alpha, int n) const {}
+  virtual bool changesPixels() const { return false; }
   private:
   ImageCombine image_combine;
 };
@@ -191,13 +225,14 @@ class SetCombineImage : public SimpleFilterImage {
 // ----------------------------------------------------------------------------- : SaturateImage
 
 /// Saturate/desaturate an image
-class SaturateImage : public SimpleFilterImage {
+class SaturateImage : public PixelFilterImage {
   public:
   inline SaturateImage(const GeneratedImageP& image, double amount)
-    : SimpleFilterImage(image), amount(amount)
+    : PixelFilterImage(image), amount(amount)
   {}
-  virtual Image generate(const Options& opt) const;
   virtual bool operator == (const GeneratedImage& that) const;
+  protected:
+  virtual void filterRow(Byte* rgb, Byte* alpha, int n) const;
   private:
   double amount;
 };
@@ -205,36 +240,39 @@ class SaturateImage : public SimpleFilterImage {
 // ----------------------------------------------------------------------------- : InvertImage
 
 /// Invert an image
-class InvertImage : public SimpleFilterImage {
+class InvertImage : public PixelFilterImage {
   public:
   inline InvertImage(const GeneratedImageP& image)
-    : SimpleFilterImage(image)
+    : PixelFilterImage(image)
   {}
-  virtual Image generate(const Options& opt) const;
   virtual bool operator == (const GeneratedImage& that) const;
+  protected:
+  virtual void filterRow(Byte* rgb, Byte* alpha, int n) const;
 };
 
 // ----------------------------------------------------------------------------- : RecolorImage
 
 /// Recolor an image
-class RecolorImage : public SimpleFilterImage {
+class RecolorImage : public PixelFilterImage {
   public:
   inline RecolorImage(const GeneratedImageP& image, Color color)
-    : SimpleFilterImage(image), color(color)
+    : PixelFilterImage(image), color(color)
   {}
-  virtual Image generate(const Options& opt) const;
   virtual bool operator == (const GeneratedImage& that) const;
+  protected:
+  virtual void filterRow(Byte* rgb, Byte* alpha, int n) const;
   private:
   Color color;
 };
 /// Recolor an image, with custom colors
-class RecolorImage2 : public SimpleFilterImage {
+class RecolorImage2 : public PixelFilterImage {
   public:
   inline RecolorImage2(const GeneratedImageP& image, Color red, Color green, Color blue, Color white)
-    : SimpleFilterImage(image), red(red), green(green), blue(blue), white(white)
+    : PixelFilterImage(image), red(red), green(green), blue(blue), white(white)
   {}
-  virtual Image generate(const Options& opt) const;
   virtual bool operator == (const GeneratedImage& that) const;
+  protected:
+  virtual void filterRow(Byte* rgb, Byte* alpha, int n) const;
   private:
   Color red,green,blue,white;
 };
@@ -242,13 +280,14 @@ class RecolorImage2 : public SimpleFilterImage {
 // ----------------------------------------------------------------------------- : FlipImage
 
 /// Flip an image horizontally
-class FlipImageHorizontal : public SimpleFilterImage {
+class FlipImageHorizontal : public PixelFilterImage {
   public:
   inline FlipImageHorizontal(const GeneratedImageP& image)
-    : SimpleFilterImage(image)
+    : PixelFilterImage(image)
   {}
-  virtual Image generate(const Options& opt) const;
   virtual bool operator == (const GeneratedImage& that) const;
+  protected:
+  virtual void filterRow(Byte* rgb, Byte* alpha, int n) const;
 };
 
 /// Flip an image vertically
@@ -329,6 +368,7 @@ class PackagedImage : public GeneratedImage {
     : filename(filename)
   {}
   virtual Image generate(const Options& opt) const;
+  virtual Image generateReduced(const Options& opt) const;
   virtual bool operator == (const GeneratedImage& that) const;
   private:
   String filename;
@@ -350,6 +390,9 @@ class BuiltInImage : public GeneratedImage {
 
 // ----------------------------------------------------------------------------- : SymbolToImage
 
+/// Remove all symbols that SymbolToImage rendered from its cache
+void clear_symbol_image_cache();
+
 /// Use a symbol as an image
 class SymbolToImage : public GeneratedImage {
   public:
@@ -378,12 +421,15 @@ class ImageValueToImage : public GeneratedImage {
   ImageValueToImage(const String& filename, Age age);
   ~ImageValueToImage();
   virtual Image generate(const Options& opt) const;
+  virtual Image generateReduced(const Options& opt) const;
   virtual bool operator == (const GeneratedImage& that) const;
   virtual bool local() const { return true; }
   private:
   ImageValueToImage(const ImageValueToImage&); // copy ctor
   String filename;
   Age    age; ///< Age the symbol was last updated
+  /// Load the image, at least min_width*min_height in size
+  Image load(const Options& opt, int min_width, int min_height) const;
 };
 
 // ----------------------------------------------------------------------------- : EOF
@@ -19,6 +19,8 @@
 #include <util/angle.hpp>
 #include <gfx/color.hpp>
 
+class ImageCanvas;
+
 // ----------------------------------------------------------------------------- : Resampling
 
 /// Resample (resize) an image, uses bilenear filtering
@@ -52,8 +54,21 @@ void sharp_resample_and_clip(const Image& img_in, Image& img_out, wxRect rect, i
  *  pos     = the position to draw
  *  rect    = rectangle to draw in (a rectangle somewhere around pos)
  *  stretch = amount to stretch in the direction of the text after drawing
+ *
+ *  The rendered text is cached, so drawing the same text in the same font and at the same
+ *  sub-pixel position again only needs to composite it in the right color.
  */
 void draw_resampled_text(DC& dc, const RealPoint& pos, const RealRect& rect, double stretch, Radians angle, AColor color, const String& text, int blur_radius = 0, int repeat = 1);
+/// Draw resampled text onto a canvas, in the given font
+void draw_resampled_text(ImageCanvas& canvas, const wxFont& font, const RealPoint& pos, const RealRect& rect, double stretch, Radians angle, AColor color, const String& text, int blur_radius = 0, int repeat = 1);
+/// Measure text in a font, like wxDC::GetTextExtent, for drawing resampled text onto a canvas
+/** Can be used from any thread, the measurements are cached. */
+void get_text_extent(const wxFont& font, const String& text, int* w, int* h);
+/// The height of a line of text in a font, like wxDC::GetCharHeight
+int get_char_height(const wxFont& font);
+/// Remove all cached text runs and measurements
+/** Must be called before wxWidgets shuts down, because the caches hold bitmaps */
+void clear_text_run_cache();
 
 // scaling factor to use when drawing resampled text
 extern const int text_scaling;
@@ -88,9 +103,26 @@ void mask_blend(Image& img1, const Image& img2, const Image& mask);
 
 /// Saturate an image
 void saturate(Image& image, double amount);
+/// Saturate n pixels of rgb data
+void saturate(Byte* rgb, size_t n, double amount);
 
 /// Invert the colors in an image
 void invert(Image& img);
+/// Invert n pixels of rgb data
+void invert(Byte* rgb, size_t n);
+
+/// How to blur an image
+enum BlurMethod
+{  BLUR_GAUSSIAN ///< An exact gaussian kernel, the cost grows with the radius
+,  BLUR_BOX      ///< Three box blurs approximating a gaussian, constant cost per pixel
+};
+
+/// Blur w*h bytes of alpha from in to out (which may be the same), with a gaussian of standard deviation sigma_x/sigma_y pixels
+/** Pixels outside the image are treated as transparent.
+ *  For small sigmas BLUR_BOX uses the exact kernel, since that is both better and cheap. */
+void blur_alpha(const Byte* in, Byte* out, int w, int h, double sigma_x, double sigma_y, BlurMethod method = BLUR_BOX);
+/// Blur the alpha channel of an image
+void blur_alpha(Image& img, double sigma, BlurMethod method = BLUR_BOX);
 
 // ----------------------------------------------------------------------------- : Combining
 
@@ -143,7 +175,9 @@ void set_alpha(Image& img, Byte* alphas, const wxSize& alphas_size);
 void set_alpha(Image& img, double alpha);
 
 /// An alpha mask is an alpha channel that can be copied to another image
-/** It is created by treating black in the source image as transparent and white (red) as opaque
+/** It is created by treating black in the source image as transparent and white (red) as opaque.
+ *  Each row is split into spans that are fully transparent, fully opaque or partial,
+ *  so operations on the mask can skip the (usually large) uniform areas.
  */
 class AlphaMask : public IntrusivePtrBase<AlphaMask> {
   public:
@@ -183,13 +217,49 @@ class AlphaMask : public IntrusivePtrBase<AlphaMask> {
   inline bool isLoaded() const { return alpha; }
   
   private:
+  /// Kinds of spans
+  enum SpanType { SPAN_TRANSPARENT, SPAN_OPAQUE, SPAN_PARTIAL };
+  /// A run of pixels in a row
+  struct Span {
+    Span(int start, int end, SpanType type) : start(start), end(end), type(type) {}
+    int      start, end; ///< Pixels [start,end)
+    SpanType type;
+  };
+  
   wxSize size; ///< Size of the mask
   Byte* alpha; ///< Data of alpha mask
-  mutable int *lefts, *rights; ///< Row sizes
+  vector<Span> spans;     ///< Spans of all rows
+  vector<UInt> row_spans; ///< Row y has the spans [row_spans[y], row_spans[y+1])
+  vector<int>  lefts, rights; ///< Row sizes
   
-  /// Compute lefts and rights from alpha
-  void loadRowSizes() const;
+  /// Split the rows into spans, and determine the row sizes
+  void loadSpans();
+  /// The first pixel in row y with at least the given alpha, or size.x if there is none
+  int firstAtLeast(int y, Byte threshold) const;
+  /// The last pixel in row y with at least the given alpha, or -1 if there is none
+  int lastAtLeast(int y, Byte threshold) const;
 };
 
+/// Share AlphaMasks between users
+DECLARE_POINTER_TYPE(AlphaMask);
+
+// ----------------------------------------------------------------------------- : Saving
+
+/// How much effort to spend on compressing image files
+enum ImageCompression
+{  COMPRESSION_FAST    ///< Quick to write, larger files, for previews and caches
+,  COMPRESSION_DEFAULT ///< The defaults of the image library
+,  COMPRESSION_BEST    ///< Smallest files (or best JPEG quality), slow to write, for releases
+};
+
+/// Save an image to a file, the file type is determined from the extension
+/** The encoder options are stored in img, so it should not be shared with other images,
+ *  otherwise the pixel data is copied first.
+ *  Returns false if the file could not be written.
+ */
+bool save_image(Image& img, const String& filename, ImageCompression compression = COMPRESSION_DEFAULT);
+/// Save an image to a file of the given type
+bool save_image(Image& img, const String& filename, wxBitmapType type, ImageCompression compression = COMPRESSION_DEFAULT);
+
 // ----------------------------------------------------------------------------- : EOF
 #endif
@@ -0,0 +1,109 @@
+//+----------------------------------------------------------------------------+
+//| Description:  Magic Set Editor - Program to make Magic (tm) cards          |
+//| Copyright:    (C) 2001 - 2017 Twan van Laarhoven and Sean Hunt             |
+//| License:      GNU General Public License 2 or later (see file COPYING)     |
+//+----------------------------------------------------------------------------+
+
+// ----------------------------------------------------------------------------- : Includes
+
+#include <util/prec.hpp>
+#include <gfx/image_pool.hpp>
+#include <util/io/package.hpp>
+#include <gui/util.hpp> // image_load_file
+
+// ----------------------------------------------------------------------------- : ImagePool
+
+ImagePool image_pool;
+
+/// Memory used by the pixels of an image
+size_t image_bytes(const Image& img) {
+  return (size_t)img.GetWidth() * img.GetHeight() * (img.HasAlpha() ? 4 : 3);
+}
+
+ImagePool::ImagePool()
+  : bytes(0), max_bytes(256 << 20)
+  , hits(0), misses(0)
+{}
+
+bool ImagePool::load(Image& out, Package& package, const String& filename, int min_width, int min_height) {
+  String key = package.fileIdentity(filename);
+  if (key.empty()) {
+    // can't be identified, let image_load_file throw the appropriate error
+    return image_load_file(out, package, filename, min_width, min_height);
+  }
+  // in the pool?
+  bool full_size = min_width <= 0 && min_height <= 0;
+  {
+    wxMutexLocker lock(mutex);
+    size_t best = entries.size();
+    for (size_t i = 0 ; i < entries.size() ; ++i) {
+      const Entry& e = entries[i];
+      if (e.key == key && e.image.GetWidth() >= min_width && e.image.GetHeight() >= min_height
+          && !(full_size && e.reduced)
+          && (best == entries.size() || e.bytes < entries[best].bytes)) {
+        best = i;
+      }
+    }
+    if (best < entries.size()) {
+      out = entries[best].image.Copy(); // the caller may modify the image
+      // move to front
+      rotate(entries.begin(), entries.begin() + best, entries.begin() + best + 1);
+      ++hits;
+      return true;
+    }
+    ++misses;
+  }
+  // decode, without holding the lock
+  Entry e;
+  if (!image_load_file(out, package, filename, min_width, min_height, &e.reduced)) return false;
+  e.key   = key;
+  e.bytes = image_bytes(out);
+  {
+    wxMutexLocker lock(mutex);
+    if (e.bytes > max_bytes) return true; // would push out everything else
+    // another thread may have decoded the same image in the meantime
+    for (size_t i = 0 ; i < entries.size() ; ++i) {
+      const Entry& other = entries[i];
+      if (other.key == key && other.reduced == e.reduced
+          && other.image.GetWidth() == out.GetWidth() && other.image.GetHeight() == out.GetHeight()) {
+        rotate(entries.begin(), entries.begin() + i, entries.begin() + i + 1);
+        return true;
+      }
+    }
+    e.image = out.Copy();
+    entries.insert(entries.begin(), e);
+    bytes += e.bytes;
+    shrink();
+  }
+  return true;
+}
+
+void ImagePool::shrink() {
+  while (bytes > max_bytes && !entries.empty()) {
+    bytes -= entries.back().bytes;
+    entries.pop_back();
+  }
+}
+
+void ImagePool::setMaxBytes(size_t max_bytes) {
+  wxMutexLocker lock(mutex);
+  this->max_bytes = max_bytes;
+  shrink();
+}
+
+void ImagePool::clear() {
+  wxMutexLocker lock(mutex);
+  entries.clear();
+  bytes = 0;
+}
+
+ImagePoolStats ImagePool::stats() {
+  wxMutexLocker lock(mutex);
+  ImagePoolStats s;
+  s.entries   = entries.size();
+  s.bytes     = bytes;
+  s.max_bytes = max_bytes;
+  s.hits      = hits;
+  s.misses    = misses;
+  return s;
+}
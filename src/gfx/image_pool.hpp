@@ -0,0 +1,83 @@
+//+----------------------------------------------------------------------------+
+//| Description:  Magic Set Editor - Program to make Magic (tm) cards          |
+//| Copyright:    (C) 2001 - 2017 Twan van Laarhoven and Sean Hunt             |
+//| License:      GNU General Public License 2 or later (see file COPYING)     |
+//+----------------------------------------------------------------------------+
+
+#ifndef HEADER_GFX_IMAGE_POOL
+#define HEADER_GFX_IMAGE_POOL
+
+/** @file gfx/image_pool.hpp
+ *
+ *  Sharing decoded images between everything that loads them from packages.
+ */
+
+// ----------------------------------------------------------------------------- : Includes
+
+#include <util/prec.hpp>
+#include <wx/thread.h>
+
+class Package;
+
+// ----------------------------------------------------------------------------- : ImagePool
+
+/// Statistics of an ImagePool
+struct ImagePoolStats {
+  size_t entries;   ///< Number of decoded images in the pool
+  size_t bytes;     ///< Memory used by those images
+  size_t max_bytes; ///< Memory ceiling
+  size_t hits;      ///< Number of loads that didn't have to decode the file
+  size_t misses;    ///< Number of loads that did
+};
+
+/// A process wide pool of images decoded from files in packages
+/** The same frame image is used by many styles and viewers, from multiple threads,
+ *  with the pool it is only decoded once.
+ *  Images are identified by Package::fileIdentity, so a modified file is decoded again.
+ *  Reduced size decodes (see image_load_file) are kept as separate entries,
+ *  a load with a minimum size is satisfied by the smallest entry that is large enough,
+ *  a load without one only by an image at the size in the file.
+ *  The least recently used images are dropped when the pool uses more memory than its ceiling.
+ *
+ *  The images in the pool are never handed out, loading returns a copy,
+ *  since the callers modify the pixels in place and wxImage reference counts are not thread safe.
+ */
+class ImagePool {
+  public:
+  ImagePool();
+
+  /// Load an image from a package, at least min_width*min_height in size (0 for no minimum)
+  /** Returns false if the file is not a valid image, throws if it doesn't exist. */
+  bool load(Image& out, Package& package, const String& filename, int min_width = 0, int min_height = 0);
+
+  /// Change the memory ceiling, in bytes
+  void setMaxBytes(size_t max_bytes);
+  /// Remove all images from the pool
+  void clear();
+  /// Get statistics about the pool
+  ImagePoolStats stats();
+
+  private:
+  struct Entry {
+    String key;
+    Image  image;
+    size_t bytes;
+    bool   reduced; ///< Was the image decoded at less than its size in the file?
+  };
+  wxMutex       mutex;
+  vector<Entry> entries; ///< most recently used first
+  size_t bytes, max_bytes;
+  size_t hits, misses;
+
+  /// Remove least recently used entries until the pool fits, mutex must be locked
+  void shrink();
+};
+
+/// The global image pool
+extern ImagePool image_pool;
+
+/// Memory used by the pixels of an image
+size_t image_bytes(const Image& img);
+
+// ----------------------------------------------------------------------------- : EOF
+#endif
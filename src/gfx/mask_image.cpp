@@ -12,8 +12,8 @@
 
 // ----------------------------------------------------------------------------- : AlphaMask
 
-AlphaMask::AlphaMask()                 : alpha(nullptr), lefts(nullptr), rights(nullptr) {}
-AlphaMask::AlphaMask(const Image& img) : alpha(nullptr), lefts(nullptr), rights(nullptr) {
+AlphaMask::AlphaMask()                 : alpha(nullptr) {}
+AlphaMask::AlphaMask(const Image& img) : alpha(nullptr) {
   load(img);
 }
 AlphaMask::~AlphaMask() {
@@ -22,8 +22,10 @@ AlphaMask::~AlphaMask() {
 
 void AlphaMask::clear() {
   delete[] alpha;  alpha  = nullptr;
-  delete[] lefts;  lefts  = nullptr;
-  delete[] rights; rights = nullptr;
+  spans.clear();
+  row_spans.clear();
+  lefts.clear();
+  rights.clear();
 }
 
 void AlphaMask::load(const Image& img) {
@@ -36,19 +38,111 @@ void AlphaMask::load(const Image& img) {
     delete[] alpha;
     alpha = new Byte[n];
   }
-  delete[] lefts;  lefts  = nullptr;
-  delete[] rights; rights = nullptr;
   // Copy red chanel to alpha
   Byte* from = img.GetData(), *to = alpha;
   for (size_t i = 0 ; i < n ; ++i) {
     to[i] = from[3*i];
   }
+  loadSpans();
+}
+
+/// Uniform runs shorter than this are made part of a partial span, they are not worth skipping
+const int min_uniform_span = 8;
+
+void AlphaMask::loadSpans() {
+  spans.clear();
+  row_spans.resize(size.y + 1);
+  row_spans[0] = 0;
+  for (int y = 0 ; y < size.y ; ++y) {
+    const Byte* row = alpha + y * size.x;
+    int partial_start = -1;
+    int x = 0;
+    while (x < size.x) {
+      Byte v = row[x];
+      int end = x + 1;
+      bool uniform = v == 0 || v == 255;
+      if (uniform) {
+        while (end < size.x && row[end] == v) ++end;
+        uniform = end - x >= min_uniform_span;
+      }
+      if (uniform) {
+        if (partial_start >= 0) {
+          spans.push_back(Span(partial_start, x, SPAN_PARTIAL));
+          partial_start = -1;
+        }
+        spans.push_back(Span(x, end, v == 0 ? SPAN_TRANSPARENT : SPAN_OPAQUE));
+      } else if (partial_start < 0) {
+        partial_start = x;
+      }
+      x = end;
+    }
+    if (partial_start >= 0) {
+      spans.push_back(Span(partial_start, size.x, SPAN_PARTIAL));
+    }
+    row_spans[y + 1] = (UInt)spans.size();
+  }
+  // for each row: determine left and rightmost white pixel
+  lefts.resize(size.y);
+  rights.resize(size.y);
+  for (int y = 0 ; y < size.y ; ++y) {
+    int left  = firstAtLeast(y, 128); // white enough
+    int right = lastAtLeast(y, 128);
+    lefts[y]  = left;
+    rights[y] = max(0, right);
+  }
+}
+
+int AlphaMask::firstAtLeast(int y, Byte threshold) const {
+  const Byte* row = alpha + y * size.x;
+  for (UInt i = row_spans[y] ; i < row_spans[y + 1] ; ++i) {
+    const Span& s = spans[i];
+    if (s.type == SPAN_OPAQUE) return s.start;
+    if (s.type == SPAN_PARTIAL) {
+      for (int x = s.start ; x < s.end ; ++x) {
+        if (row[x] >= threshold) return x;
+      }
+    }
+  }
+  return size.x;
+}
+
+int AlphaMask::lastAtLeast(int y, Byte threshold) const {
+  const Byte* row = alpha + y * size.x;
+  for (UInt i = row_spans[y + 1] ; i > row_spans[y] ; --i) {
+    const Span& s = spans[i - 1];
+    if (s.type == SPAN_OPAQUE) return s.end - 1;
+    if (s.type == SPAN_PARTIAL) {
+      for (int x = s.end - 1 ; x >= s.start ; --x) {
+        if (row[x] >= threshold) return x;
+      }
+    }
+  }
+  return -1;
 }
 
 
 void AlphaMask::setAlpha(Image& img) const {
   if (!alpha) return;
-  set_alpha(img, alpha, size);
+  if (!img.HasAlpha() || img.GetWidth() != size.x || img.GetHeight() != size.y) {
+    set_alpha(img, alpha, size);
+    return;
+  }
+  // merge, opaque spans leave the image unchanged
+  Byte* im = img.GetAlpha();
+  for (int y = 0 ; y < size.y ; ++y) {
+    Byte*       im_row = im    + y * size.x;
+    const Byte* al_row = alpha + y * size.x;
+    for (UInt i = row_spans[y] ; i < row_spans[y + 1] ; ++i) {
+      const Span& s = spans[i];
+      if (s.type == SPAN_TRANSPARENT) {
+        memset(im_row + s.start, 0, s.end - s.start);
+      } else if (s.type == SPAN_PARTIAL) {
+        for (int x = s.start ; x < s.end ; ++x) {
+          im_row[x] = (im_row[x] * al_row[x]) / 255;
+        }
+      }
+    }
+  }
 }
 
 void AlphaMask::setAlpha(Bitmap& bmp) const {
@@ -99,34 +193,30 @@ void AlphaMask::convexHull(vector<wxPoint>& points) const {
   // Left side, top to bottom
   int miny = size.y, maxy = -1, lastx = 0;
   for (int y = 0 ; y < size.y ; ++y) {
-    for (int x = 0 ; x < size.x ; ++x) {
-      if (alpha[x + y * size.x] >= 20) {
-        // opaque pixel
-        miny = min(miny,y);
-        maxy = y;
-        if (y == miny) {
-          add_convex_point(points, x-1, y-1);
-        }
-        add_convex_point(points, x-1, y);
-        lastx = x;
-        break;
+    int x = firstAtLeast(y, 20);
+    if (x < size.x) {
+      // opaque pixel
+      miny = min(miny,y);
+      maxy = y;
+      if (y == miny) {
+        add_convex_point(points, x-1, y-1);
       }
+      add_convex_point(points, x-1, y);
+      lastx = x;
     }
   }
   if (maxy == -1) return; // No image
   add_convex_point(points, lastx-1, maxy+1);
   // Right side, bottom to top
   for (int y = maxy ; y >= miny ; --y) {
-    for (int x = size.x - 1 ; x >= 0 ; --x) {
-      if (alpha[x + y * size.x] >= 20) {
-        // opaque pixel
-        if (y == maxy) {
-          add_convex_point(points, x+1, y+1);
-        }
-        add_convex_point(points, x+1, y);
-        lastx = x;
-        break;
+    int x = lastAtLeast(y, 20);
+    if (x >= 0) {
+      // opaque pixel
+      if (y == maxy) {
+        add_convex_point(points, x+1, y+1);
       }
+      add_convex_point(points, x+1, y);
+      lastx = x;
     }
   }
   add_convex_point(points, lastx+1, miny-1);
@@ -141,26 +231,8 @@ Image AlphaMask::colorImage(const Color& color) const {
 
 // ----------------------------------------------------------------------------- : Contour Mask
 
-void AlphaMask::loadRowSizes() const {
-  if (lefts || !alpha) return;
-  lefts  = new int[size.y];
-  rights = new int[size.y];
-  // for each row: determine left and rightmost white pixel
-  for (int y = 0 ; y < size.y ; ++y) {
-    lefts[y]  = size.x;
-    rights[y] = 0;
-    for (int x = 0 ; x < size.x ; ++x) {
-      if (alpha[y * size.x + x] >= 128) { // white enough
-        rights[y] = x;
-        if (x < lefts[y]) lefts[y] = x;
-      }
-    }
-  }
-}
-
 double AlphaMask::rowLeft (double y, const RealSize& resize) const {
-  loadRowSizes();
-  if (!lefts || y < 0 || y >= resize.height) {
+  if (!alpha || y < 0 || y >= resize.height) {
     // no mask, or outside it
     return 0;
   }
@@ -168,8 +240,7 @@ double AlphaMask::rowLeft (double y, const RealSize& resize) const {
 }
 
 double AlphaMask::rowRight(double y, const RealSize& resize) const {
-  loadRowSizes();
-  if (!rights || y < 0 || y >= resize.height) {
+  if (!alpha || y < 0 || y >= resize.height) {
     // no mask, or outside it
     return resize.width;
   }
@@ -0,0 +1,181 @@
+//+----------------------------------------------------------------------------+
+//| Description:  Magic Set Editor - Program to make Magic (tm) cards          |
+//| Copyright:    (C) 2001 - 2017 Twan van Laarhoven and Sean Hunt             |
+//| License:      GNU General Public License 2 or later (see file COPYING)     |
+//+----------------------------------------------------------------------------+
+
+// ----------------------------------------------------------------------------- : Includes
+
+#include <util/prec.hpp>
+#include <gfx/rasterize.hpp>
+
+// ----------------------------------------------------------------------------- : CoverageBuffer
+
+void CoverageBuffer::resize(int width, int height) {
+  this->width  = width;
+  this->height = height;
+  data.assign(width * height, 0.f);
+}
+
+// ----------------------------------------------------------------------------- : ScanlineRasterizer
+
+ScanlineRasterizer::ScanlineRasterizer(int width, int height)
+  : width(width), height(height)
+  , accum((width + 2) * height, 0.f)
+  , min_y(height), max_y(0)
+{}
+
+void ScanlineRasterizer::addPolygon(const vector<Vector2D>& points) {
+  size_t n = points.size();
+  for (size_t i = 0 ; i < n ; ++i) {
+    addLine(points[i], points[(i + 1) % n]);
+  }
+}
+
+void ScanlineRasterizer::addPolygonOriented(const vector<Vector2D>& points) {
+  size_t n = points.size();
+  double area = 0;
+  for (size_t i = 0 ; i < n ; ++i) {
+    area += cross(points[i], points[(i + 1) % n]);
+  }
+  if (area >= 0) {
+    addPolygon(points);
+  } else {
+    for (size_t i = 0 ; i < n ; ++i) {
+      addLine(points[(i + 1) % n], points[i]);
+    }
+  }
+}
+
+void ScanlineRasterizer::addStroke(const vector<Vector2D>& points, double pen_width, bool closed) {
+  double radius = pen_width * 0.5;
+  if (radius <= 0) return;
+  // a circle for the round joins, with an error of at most 0.1 pixel
+  int segments = radius > 0.1 ? (int)ceil(M_PI / acos(1 - 0.1 / radius)) : 8;
+  segments = max(8, min(128, segments));
+  vector<Vector2D> circle(segments), shape(segments);
+  for (int i = 0 ; i < segments ; ++i) {
+    double a = i * 2 * M_PI / segments;
+    circle[i] = Vector2D(cos(a), sin(a)) * radius;
+  }
+  // every edge becomes a rectangle, every corner a circle, together they form the stroke
+  vector<Vector2D> quad(4);
+  size_t n = points.size();
+  for (size_t i = 0 ; i < n ; ++i) {
+    const Vector2D& a = points[i];
+    const Vector2D& b = points[(i + 1) % n];
+    for (int j = 0 ; j < segments ; ++j) shape[j] = a + circle[j];
+    addPolygonOriented(shape);
+    if (!closed && i + 1 == n) break;
+    double len = (b - a).length();
+    if (len <= 0) continue;
+    Vector2D normal = Vector2D(a.y - b.y, b.x - a.x) * (radius / len);
+    quad[0] = a + normal;
+    quad[1] = b + normal;
+    quad[2] = b - normal;
+    quad[3] = a - normal;
+    addPolygonOriented(quad);
+  }
+}
+
+void ScanlineRasterizer::addLine(const Vector2D& a, const Vector2D& b) {
+  // split the line where it crosses the left or right side,
+  // the parts outside are projected onto that side, this doesn't change the coverage inside the buffer
+  double ts[4] = {0, 1, 1, 1};
+  int count = 1;
+  if (a.x != b.x) {
+    double t_left  = (0     - a.x) / (b.x - a.x);
+    double t_right = (width - a.x) / (b.x - a.x);
+    if (t_left  > 0 && t_left  < 1) ts[count++] = t_left;
+    if (t_right > 0 && t_right < 1) ts[count++] = t_right;
+    if (count == 3 && ts[1] > ts[2]) swap(ts[1], ts[2]);
+  }
+  Vector2D prev = a;
+  for (int i = 1 ; i <= count ; ++i) {
+    Vector2D next = i == count ? b : a + (b - a) * ts[i];
+    addClippedLine(Vector2D(max(0., min((double)width, prev.x)), prev.y),
+                   Vector2D(max(0., min((double)width, next.x)), next.y));
+    prev = next;
+  }
+}
+
+void ScanlineRasterizer::addClippedLine(const Vector2D& a, const Vector2D& b) {
+  if (a.y == b.y) return; // horizontal lines don't change the coverage
+  // always go down, remember the direction for the winding number
+  double dir = 1;
+  Vector2D p0 = a, p1 = b;
+  if (p0.y > p1.y) {
+    swap(p0, p1);
+    dir = -1;
+  }
+  if (p1.y <= 0 || p0.y >= height) return;
+  double dxdy = (p1.x - p0.x) / (p1.y - p0.y);
+  double x = p0.x;
+  if (p0.y < 0) x -= p0.y * dxdy;
+  int y_start = max(0, (int)floor(p0.y));
+  int y_end   = min(height, (int)ceil(p1.y));
+  min_y = min(min_y, y_start);
+  max_y = max(max_y, y_end);
+  // Each row the line crosses adds its signed height (d) to the accumulator,
+  // spread over the pixels it passes through in proportion to the area right of the line.
+  // After summing each row from left to right this gives the covered area of every pixel.
+  for (int y = y_start ; y < y_end ; ++y) {
+    float* row = &accum[y * (width + 2)];
+    double dy    = min(y + 1., p1.y) - max((double)y, p0.y);
+    double xnext = max(0., min((double)width, x + dxdy * dy));
+    double d     = dy * dir;
+    double x0 = min(x, xnext), x1 = max(x, xnext);
+    double x0floor = floor(x0), x1ceil = ceil(x1);
+    int    x0i = (int)x0floor,  x1i = (int)x1ceil;
+    if (x1i <= x0i + 1) {
+      // within a single pixel
+      double xmf = 0.5 * (x + xnext) - x0floor;
+      row[x0i]     += (float)(d - d * xmf);
+      row[x0i + 1] += (float)(d * xmf);
+    } else {
+      // spans multiple pixels
+      double s   = 1 / (x1 - x0);
+      double x0f = x0 - x0floor;
+      double a0  = 0.5 * s * (1 - x0f) * (1 - x0f);
+      double x1f = x1 - x1ceil + 1;
+      double am  = 0.5 * s * x1f * x1f;
+      row[x0i] += (float)(d * a0);
+      if (x1i == x0i + 2) {
+        row[x0i + 1] += (float)(d * (1 - a0 - am));
+      } else {
+        double a1 = s * (1.5 - x0f);
+        row[x0i + 1] += (float)(d * (a1 - a0));
+        for (int xi = x0i + 2 ; xi < x1i - 1 ; ++xi) {
+          row[xi] += (float)(d * s);
+        }
+        double a2 = a1 + (x1i - x0i - 3) * s;
+        row[x1i - 1] += (float)(d * (1 - a2 - am));
+      }
+      row[x1i] += (float)(d * am);
+    }
+    x = xnext;
+  }
+}
+
+void ScanlineRasterizer::render(CoverageBuffer& out, FillRule rule) {
+  out.resize(width, height);
+  for (int y = min_y ; y < max_y && width > 0 ; ++y) {
+    float* row = &accum[y * (width + 2)];
+    float* dst = &out.data[y * width];
+    float acc = 0;
+    for (int x = 0 ; x < width ; ++x) {
+      acc += row[x];
+      float c = fabs(acc);
+      if (rule == FILL_NONZERO) {
+        dst[x] = min(c, 1.f);
+      } else {
+        c -= 2 * floor(c * 0.5f);
+        dst[x] = c > 1 ? 2 - c : c;
+      }
+    }
+    fill(row, row + width + 2, 0.f);
+  }
+  // reset
+  min_y = height;
+  max_y = 0;
+}
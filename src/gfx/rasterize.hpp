@@ -0,0 +1,78 @@
+//+----------------------------------------------------------------------------+
+//| Description:  Magic Set Editor - Program to make Magic (tm) cards          |
+//| Copyright:    (C) 2001 - 2017 Twan van Laarhoven and Sean Hunt             |
+//| License:      GNU General Public License 2 or later (see file COPYING)     |
+//+----------------------------------------------------------------------------+
+
+#ifndef HEADER_GFX_RASTERIZE
+#define HEADER_GFX_RASTERIZE
+
+/** @file gfx/rasterize.hpp
+ *
+ *  Software rasterization of polygons with anti aliasing
+ */
+
+// ----------------------------------------------------------------------------- : Includes
+
+#include <util/prec.hpp>
+#include <util/vector2d.hpp>
+
+// ----------------------------------------------------------------------------- : CoverageBuffer
+
+/// A buffer of coverage values, one for each pixel, in the range [0...1]
+class CoverageBuffer {
+  public:
+  inline CoverageBuffer() : width(0), height(0) {}
+
+  int width, height;
+  vector<float> data; ///< The coverage, row by row
+
+  /// Change the size of the buffer, and set all coverage to 0
+  void resize(int width, int height);
+
+  inline float& at(int x, int y)       { return data[y * width + x]; }
+  inline float  at(int x, int y) const { return data[y * width + x]; }
+};
+
+// ----------------------------------------------------------------------------- : ScanlineRasterizer
+
+/// How to determine what is inside a polygon
+enum FillRule
+{  FILL_EVEN_ODD ///< Inside if a ray crosses an odd number of edges, like wxODDEVEN_RULE
+,  FILL_NONZERO  ///< Inside if the winding number is not zero, overlapping polygons are united
+};
+
+/// Rasterizes polygons with anti aliasing, by computing the exact area of each pixel that is covered.
+/** Edges are accumulated with add*, then render() turns them into coverage.
+ *  Points are in pixel coordinates, pixel (x,y) covers the square from (x,y) to (x+1,y+1).
+ *  Everything outside the buffer is clipped.
+ */
+class ScanlineRasterizer {
+  public:
+  ScanlineRasterizer(int width, int height);
+
+  /// Add a closed polygon
+  void addPolygon(const vector<Vector2D>& points);
+  /// Add a closed polygon, in counter clockwise orientation, so it can be united with FILL_NONZERO
+  void addPolygonOriented(const vector<Vector2D>& points);
+  /// Add the outline of a polygon, drawn with a pen of the given width with round joins.
+  /** If closed is false the last point is not connected to the first one.
+   *  Should be rendered with FILL_NONZERO */
+  void addStroke(const vector<Vector2D>& points, double pen_width, bool closed = true);
+
+  /// Resolve the added polygons to coverage in out, and reset the rasterizer
+  void render(CoverageBuffer& out, FillRule rule);
+
+  private:
+  int width, height;
+  vector<float> accum;  ///< Accumulated area differences, (width+2) values per row
+  int min_y, max_y;     ///< Rows that have been touched
+
+  /// Add an edge, clipping it against the left and right sides
+  void addLine(const Vector2D& a, const Vector2D& b);
+  /// Add an edge with 0 <= x <= width
+  void addClippedLine(const Vector2D& a, const Vector2D& b);
+};
+
+// ----------------------------------------------------------------------------- : EOF
+#endif
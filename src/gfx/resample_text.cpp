@@ -8,8 +8,11 @@
 
 #include <util/prec.hpp>
 #include <gfx/gfx.hpp>
+#include <gfx/canvas.hpp>
 #include <util/error.hpp>
 #include <gui/util.hpp> // clearDC_black
+#include <wx/thread.h>
+#include <algorithm>
 #if defined(__WXMSW__) && wxUSE_WXDIB
   #include <wx/msw/dib.h>
 #endif
@@ -141,69 +144,368 @@ void downsample_to_alpha(Bitmap& bmp_in, Image& img_out) {
   delete[] temp;
 }
 
-// simple blur
-int blur_alpha_pixel(Byte* in, int x, int y, int width, int height) {
-  return (2 * (                      in[0])      + // center
-          (x == 0          ? in[0] : in[-1])     + // left
-          (y == 0          ? in[0] : in[-width]) + // up
-          (x == width - 1  ? in[0] : in[1])      + // right
-          (y == height - 1 ? in[0] : in[width])    // down
-         ) / 6;
-}
-
-// TODO: move me?
-void blur_image_alpha(Image& img) {
-  int width = img.GetWidth(), height = img.GetHeight();
-  Byte* data = img.GetAlpha();
-  for (int y = 0 ; y < height ; ++y) {
-    for (int x = 0 ; x < width ; ++x) {
-      *data = blur_alpha_pixel(data, x, y, width, height);
-      ++data;
+// ----------------------------------------------------------------------------- : Text run cache
+
+// Rendering a run of text is expensive: it is drawn at text_scaling times the size,
+// read back from the bitmap and downsampled. The resulting alpha coverage only depends
+// on the font, the text and the subpixel placement, so we keep it around.
+
+/// Everything that influences the coverage of a rendered run of text
+struct TextRunKey {
+  String  text;
+  String  font;        ///< Native description of the font, includes the size
+  bool    underline;
+  int     xsub, ysub;  ///< Sub-pixel position, in units of 1/text_scaling pixels
+  int     width, height; ///< Size of the run before stretching
+  double  stretch;
+  Radians angle;
+  int     blur_radius;
+  
+  bool operator < (const TextRunKey& k) const {
+    if (xsub        != k.xsub)        return xsub        < k.xsub;
+    if (ysub        != k.ysub)        return ysub        < k.ysub;
+    if (width       != k.width)       return width       < k.width;
+    if (height      != k.height)      return height      < k.height;
+    if (blur_radius != k.blur_radius) return blur_radius < k.blur_radius;
+    if (underline   != k.underline)   return underline   < k.underline;
+    if (stretch     != k.stretch)     return stretch     < k.stretch;
+    if (angle       != k.angle)       return angle       < k.angle;
+    if (text        != k.text)        return text        < k.text;
+    return font < k.font;
+  }
+};
+
+/// A rendered run of text
+struct TextRun {
+  int          width, height; ///< Size of the run after stretching
+  vector<Byte> coverage;    ///< Alpha coverage, width*height bytes
+  UInt         last_use;    ///< Time of last use, for eviction
+  AColor       color;       ///< Color of the bitmap
+  Bitmap       bitmap;      ///< Bitmap of the run in color, only created and used from the main thread
+  
+  inline size_t memoryUse() const {
+    return coverage.size() + (bitmap.Ok() ? 4 * width * height : 0);
+  }
+};
+
+/// Cache of rendered text runs, shared between all DCs (and threads)
+class TextRunCache {
+  public:
+  TextRunCache() : memory(0), time(0) {}
+  
+  /// Find a run in the cache, and make a bitmap of it in the given color
+  bool find(const TextRunKey& key, AColor color, Bitmap& bmp_out);
+  /// Add a run to the cache, and make a bitmap of it in the given color
+  void store(const TextRunKey& key, const Image& coverage, AColor color, Bitmap& bmp_out);
+  /// Find a run in the cache, and copy its coverage
+  bool findCoverage(const TextRunKey& key, vector<Byte>& coverage_out, int& width_out, int& height_out);
+  /// Add a run to the cache, without making a bitmap
+  void storeCoverage(const TextRunKey& key, const Image& coverage);
+  /// Remove all runs
+  void clear();
+  
+  private:
+  typedef map<TextRunKey,TextRun> Runs;
+  wxMutex lock;  ///< Runs can be rendered from other threads
+  Runs    runs;
+  size_t  memory;
+  UInt    time;
+  
+  /// Add or replace a run, must hold the lock
+  TextRun& add(const TextRunKey& key, const Image& coverage);
+  /// Colorize a run, must hold the lock
+  void makeBitmap(TextRun& run, AColor color, Bitmap& bmp_out);
+  /// Remove the least recently used half of the runs, must hold the lock
+  void evict();
+};
+
+/// Maximum amount of memory used for cached text runs
+const size_t text_run_cache_max_memory = 32 * 1024 * 1024;
+
+TextRunCache text_run_cache;
+
+/// Guards all use of wx for rendering and measuring glyphs, which is not thread safe
+wxMutex glyph_lock;
+
+// ----------------------------------------------------------------------------- : Measuring text
+
+/// Measures text for drawing to a canvas, the measurements are cached
+/** The canvas has no DC, so we keep a DC of our own for measuring. */
+class TextMeasurer {
+  public:
+  TextMeasurer() : measure_dc(nullptr) {}
+  ~TextMeasurer() { clear(); }
+  
+  void getTextExtent(const wxFont& font, const String& text, int* w, int* h);
+  int  getCharHeight(const wxFont& font);
+  /// Forget all measurements, and release the DC
+  void clear();
+  
+  private:
+  typedef pair<String,String> Key; ///< Native description of the font, text
+  map<Key,wxSize> extents;
+  map<String,int> char_heights;
+  wxMemoryDC*     measure_dc;
+  Bitmap          measure_bitmap;
+  
+  /// The DC to measure with, in the given font, must hold the glyph_lock
+  wxDC& dc(const wxFont& font);
+};
+
+/// Maximum number of cached measurements
+const size_t text_measurer_max_entries = 100000;
+
+TextMeasurer text_measurer;
+
+void TextMeasurer::getTextExtent(const wxFont& font, const String& text, int* w, int* h) {
+  wxMutexLocker locker(glyph_lock);
+  Key key(font.GetNativeFontInfoDesc(), text);
+  map<Key,wxSize>::const_iterator it = extents.find(key);
+  wxSize size;
+  if (it != extents.end()) {
+    size = it->second;
+  } else {
+    dc(font).GetTextExtent(text, &size.x, &size.y);
+    if (extents.size() >= text_measurer_max_entries) extents.clear();
+    extents.insert(make_pair(key, size));
+  }
+  if (w) *w = size.x;
+  if (h) *h = size.y;
+}
+
+int TextMeasurer::getCharHeight(const wxFont& font) {
+  wxMutexLocker locker(glyph_lock);
+  String key = font.GetNativeFontInfoDesc();
+  map<String,int>::const_iterator it = char_heights.find(key);
+  if (it != char_heights.end()) return it->second;
+  int h = dc(font).GetCharHeight();
+  char_heights.insert(make_pair(key, h));
+  return h;
+}
+
+void TextMeasurer::clear() {
+  wxMutexLocker locker(glyph_lock);
+  extents.clear();
+  char_heights.clear();
+  if (measure_dc) {
+    measure_dc->SelectObject(wxNullBitmap);
+    delete measure_dc;
+    measure_dc = nullptr;
+  }
+  measure_bitmap = Bitmap();
+}
+
+wxDC& TextMeasurer::dc(const wxFont& font) {
+  if (!measure_dc) {
+    measure_bitmap = Bitmap(1, 1);
+    measure_dc = new wxMemoryDC;
+    measure_dc->SelectObject(measure_bitmap);
+  }
+  measure_dc->SetFont(font);
+  return *measure_dc;
+}
+
+void get_text_extent(const wxFont& font, const String& text, int* w, int* h) {
+  text_measurer.getTextExtent(font, text, w, h);
+}
+int get_char_height(const wxFont& font) {
+  return text_measurer.getCharHeight(font);
+}
+
+bool TextRunCache::find(const TextRunKey& key, AColor color, Bitmap& bmp_out) {
+  wxMutexLocker locker(lock);
+  Runs::iterator it = runs.find(key);
+  if (it == runs.end()) return false;
+  it->second.last_use = ++time;
+  makeBitmap(it->second, color, bmp_out);
+  return true;
+}
+
+void TextRunCache::store(const TextRunKey& key, const Image& coverage, AColor color, Bitmap& bmp_out) {
+  wxMutexLocker locker(lock);
+  makeBitmap(add(key, coverage), color, bmp_out);
+}
+
+bool TextRunCache::findCoverage(const TextRunKey& key, vector<Byte>& coverage_out, int& width_out, int& height_out) {
+  wxMutexLocker locker(lock);
+  Runs::iterator it = runs.find(key);
+  if (it == runs.end()) return false;
+  it->second.last_use = ++time;
+  coverage_out = it->second.coverage;
+  width_out    = it->second.width;
+  height_out   = it->second.height;
+  return true;
+}
+
+void TextRunCache::storeCoverage(const TextRunKey& key, const Image& coverage) {
+  wxMutexLocker locker(lock);
+  add(key, coverage);
+}
+
+void TextRunCache::clear() {
+  wxMutexLocker locker(lock);
+  runs.clear();
+  memory = 0;
+}
+
+void clear_text_run_cache() {
+  text_run_cache.clear();
+  text_measurer.clear();
+}
+
+TextRun& TextRunCache::add(const TextRunKey& key, const Image& coverage) {
+  if (memory > text_run_cache_max_memory) evict();
+  TextRun& run = runs[key];
+  memory -= run.memoryUse();
+  run.bitmap   = Bitmap();
+  run.width    = coverage.GetWidth();
+  run.height   = coverage.GetHeight();
+  run.coverage.assign(coverage.GetAlpha(), coverage.GetAlpha() + run.width * run.height);
+  run.last_use = ++time;
+  memory += run.memoryUse();
+  return run;
+}
+
+void TextRunCache::makeBitmap(TextRun& run, AColor color, Bitmap& bmp_out) {
+  bool main = wxThread::IsMain();
+  if (main && run.bitmap.Ok() && run.color == color) {
+    bmp_out = run.bitmap;
+    return;
+  }
+  // composite coverage with the color
+  Image img(run.width, run.height, false);
+  fill_image(img, color);
+  img.InitAlpha();
+  Byte* alpha = img.GetAlpha();
+  size_t n = run.coverage.size();
+  if (color.alpha == 255) {
+    memcpy(alpha, &run.coverage[0], n);
+  } else {
+    for (size_t i = 0 ; i < n ; ++i) {
+      alpha[i] = (run.coverage[i] * color.alpha) / 255;
+    }
+  }
+  bmp_out = Bitmap(img);
+  if (main) {
+    // wxBitmaps are not thread safe, so only the main thread gets to keep them
+    memory -= run.memoryUse();
+    run.color  = color;
+    run.bitmap = bmp_out;
+    memory += run.memoryUse();
+  }
+}
+
+void TextRunCache::evict() {
+  // find the median age
+  vector<UInt> uses;
+  uses.reserve(runs.size());
+  FOR_EACH(r, runs) uses.push_back(r.second.last_use);
+  if (uses.empty()) return;
+  nth_element(uses.begin(), uses.begin() + uses.size() / 2, uses.end());
+  UInt cutoff = uses[uses.size() / 2];
+  // remove older runs
+  for (Runs::iterator it = runs.begin() ; it != runs.end() ; ) {
+    if (it->second.last_use <= cutoff) {
+      memory -= it->second.memoryUse();
+      runs.erase(it++);
+    } else {
+      ++it;
     }
   }
 }
 
+// ----------------------------------------------------------------------------- : Drawing
+
+// Render the coverage of a run of text, by first drawing it using a larger font and then downsampling it.
+// The result is stored in the alpha channel of img_out
+void render_text_coverage(const wxFont& font, const TextRunKey& key, Image& img_out) {
+  int w = key.width, h = key.height;
+  double ca = fabs(cos(key.angle)), sa = fabs(sin(key.angle));
+  {
+    wxMutexLocker locker(glyph_lock);
+    // draw text
+    Bitmap buffer(w * text_scaling, h * text_scaling, 24); // should be initialized to black
+    wxMemoryDC mdc;
+    mdc.SelectObject(buffer);
+    clearDC_black(mdc);
+    // now draw the text
+    mdc.SetFont(font);
+    mdc.SetTextForeground(*wxWHITE);
+    mdc.DrawRotatedText(key.text, key.xsub, key.ysub, rad_to_deg(key.angle));
+    // get image
+    mdc.SelectObject(wxNullBitmap);
+    // step 2. sample down
+    w += int(w * (key.stretch - 1) * ca); // GCC makes annoying conversion warnings if *= is used here.
+    h += int(h * (key.stretch - 1) * sa);
+    img_out = Image(w, h, false);
+    downsample_to_alpha(buffer, img_out);
+  }
+  // blur
+  // this used to be blur_radius passes of a [1 2 1]/6 cross kernel, each adding a variance of 1/3 in both directions
+  if (key.blur_radius > 0) {
+    blur_alpha(img_out, sqrt(key.blur_radius / 3.0));
+  }
+}
+
+// Determine the cache key of a run of text, and the position where it should be drawn
+void make_text_run_key(const wxFont& font, const RealPoint& pos, const RealRect& rect, double stretch, Radians angle, const String& text, int blur_radius, TextRunKey& key, int& xi, int& yi) {
+  // enlarge slightly; some fonts are larger then the GetTextExtent tells us (especially italic fonts)
+  int w = static_cast<int>(rect.width) + 3 + 2 * blur_radius, h = static_cast<int>(rect.height) + 1 + 2 * blur_radius;
+  // determine sub-pixel position
+  xi = static_cast<int>(rect.x) - blur_radius / text_scaling;
+  yi = static_cast<int>(rect.y) - blur_radius / text_scaling;
+  key.text        = text;
+  key.font        = font.GetNativeFontInfoDesc();
+  key.underline   = font.GetUnderlined();
+  key.xsub        = static_cast<int>(text_scaling * (pos.x - xi));
+  key.ysub        = static_cast<int>(text_scaling * (pos.y - yi));
+  key.width       = w;
+  key.height      = h;
+  key.stretch     = stretch;
+  key.angle       = angle;
+  key.blur_radius = blur_radius;
+}
+
 // Draw text by first drawing it using a larger font and then downsampling it
 // optionally rotated by an angle
 void draw_resampled_text(DC& dc, const RealPoint& pos, const RealRect& rect, double stretch, Radians angle, AColor color, const String& text, int blur_radius, int repeat) {
   // transparent text can be ignored
   if (color.alpha == 0) return;
-  // enlarge slightly; some fonts are larger then the GetTextExtent tells us (especially italic fonts)
-  int w = static_cast<int>(rect.width) + 3 + 2 * blur_radius, h = static_cast<int>(rect.height) + 1 + 2 * blur_radius;
-  // determine sub-pixel position
-  int xi = static_cast<int>(rect.x) - blur_radius / text_scaling,
-      yi = static_cast<int>(rect.y) - blur_radius / text_scaling;
-  int xsub = static_cast<int>(text_scaling * (pos.x - xi)),
-      ysub = static_cast<int>(text_scaling * (pos.y - yi));
-  // draw text
-  Bitmap buffer(w * text_scaling, h * text_scaling, 24); // should be initialized to black
-  wxMemoryDC mdc;
-  mdc.SelectObject(buffer);
-  clearDC_black(mdc);
-  // now draw the text
-  mdc.SetFont(dc.GetFont());
-  mdc.SetTextForeground(*wxWHITE);
-  mdc.DrawRotatedText(text, xsub, ysub, rad_to_deg(angle));
-  // get image
-  mdc.SelectObject(wxNullBitmap);
-  // step 2. sample down
-  double ca = fabs(cos(angle)), sa = fabs(sin(angle));
-  w += int(w * (stretch - 1) * ca); // GCC makes annoying conversion warnings if *= is used here.
-  h += int(h * (stretch - 1) * sa);
-  Image img_small(w, h, false);
-  fill_image(img_small, color);
-  downsample_to_alpha(buffer, img_small);
-  // multiply alpha
-  if (color.alpha != 255) {
-    set_alpha(img_small, color.alpha / 255.);
-  }
-  // blur
-  for (int i = 0 ; i < blur_radius ; ++i) {
-    blur_image_alpha(img_small);
+  // find in cache
+  const wxFont& font = dc.GetFont();
+  TextRunKey key;
+  int xi, yi;
+  make_text_run_key(font, pos, rect, stretch, angle, text, blur_radius, key, xi, yi);
+  Bitmap bmp;
+  if (!text_run_cache.find(key, color, bmp)) {
+    // render and store
+    Image coverage;
+    render_text_coverage(font, key, coverage);
+    text_run_cache.store(key, coverage, color, bmp);
   }
   // step 3. draw to dc
   for (int i = 0 ; i < repeat ; ++i) {
-    dc.DrawBitmap(img_small, xi, yi);
+    dc.DrawBitmap(bmp, xi, yi);
   }
 }
 
+// Draw text to a canvas, the coverage is composited directly, so no bitmap is needed
+void draw_resampled_text(ImageCanvas& canvas, const wxFont& font, const RealPoint& pos, const RealRect& rect, double stretch, Radians angle, AColor color, const String& text, int blur_radius, int repeat) {
+  if (color.alpha == 0) return;
+  TextRunKey key;
+  int xi, yi;
+  make_text_run_key(font, pos, rect, stretch, angle, text, blur_radius, key, xi, yi);
+  vector<Byte> coverage;
+  int w, h;
+  if (!text_run_cache.findCoverage(key, coverage, w, h)) {
+    Image img;
+    render_text_coverage(font, key, img);
+    text_run_cache.storeCoverage(key, img);
+    w = img.GetWidth();
+    h = img.GetHeight();
+    coverage.assign(img.GetAlpha(), img.GetAlpha() + w * h);
+  }
+  if (!coverage.empty()) {
+    canvas.drawCoverage(&coverage[0], xi, yi, w, h, color, repeat);
+  }
+}
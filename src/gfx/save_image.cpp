@@ -0,0 +1,66 @@
+//+----------------------------------------------------------------------------+
+//| Description:  Magic Set Editor - Program to make Magic (tm) cards          |
+//| Copyright:    (C) 2001 - 2017 Twan van Laarhoven and Sean Hunt             |
+//| License:      GNU General Public License 2 or later (see file COPYING)     |
+//+----------------------------------------------------------------------------+
+
+// ----------------------------------------------------------------------------- : Includes
+
+#include <util/prec.hpp>
+#include <gfx/gfx.hpp>
+#include <wx/filename.h>
+
+// ----------------------------------------------------------------------------- : Encoder options
+
+// zlib strategies, see zlib.h
+const int ZLIB_DEFAULT_STRATEGY = 0;
+const int ZLIB_RLE              = 3;
+
+/// Set the options of the PNG encoder
+void set_png_options(Image& img, ImageCompression compression) {
+  // write the image data in larger chunks
+  img.SetOption(wxIMAGE_OPTION_PNG_COMPRESSION_BUFFER_SIZE, 1024 * 1024);
+  if (compression == COMPRESSION_FAST) {
+    // run length encoding of the filtered rows is several times faster than full deflate,
+    // and still does well on the large flat areas of cards
+    img.SetOption(wxIMAGE_OPTION_PNG_COMPRESSION_LEVEL,    1);
+    img.SetOption(wxIMAGE_OPTION_PNG_COMPRESSION_STRATEGY, ZLIB_RLE);
+    #ifdef wxIMAGE_OPTION_PNG_FILTER
+      // only try a single filter instead of choosing one per row
+      img.SetOption(wxIMAGE_OPTION_PNG_FILTER, wxPNG_FILTER_SUB);
+    #endif
+  } else if (compression == COMPRESSION_BEST) {
+    img.SetOption(wxIMAGE_OPTION_PNG_COMPRESSION_LEVEL,     9);
+    img.SetOption(wxIMAGE_OPTION_PNG_COMPRESSION_MEM_LEVEL, 9);
+    img.SetOption(wxIMAGE_OPTION_PNG_COMPRESSION_STRATEGY,  ZLIB_DEFAULT_STRATEGY);
+  }
+}
+
+/// Set the options of the JPEG encoder
+void set_jpeg_options(Image& img, ImageCompression compression) {
+  if (compression == COMPRESSION_FAST) {
+    img.SetOption(wxIMAGE_OPTION_QUALITY, 80);
+  } else if (compression == COMPRESSION_BEST) {
+    img.SetOption(wxIMAGE_OPTION_QUALITY, 95);
+  }
+}
+
+// ----------------------------------------------------------------------------- : Saving
+
+bool save_image(Image& img, const String& filename, ImageCompression compression) {
+  wxImageHandler* handler = wxImage::FindHandler(wxFileName(filename).GetExt().Lower(), wxBITMAP_TYPE_ANY);
+  if (!handler) {
+    // unknown extension, let wx report the error
+    return img.SaveFile(filename);
+  }
+  return save_image(img, filename, handler->GetType(), compression);
+}
+
+bool save_image(Image& img, const String& filename, wxBitmapType type, ImageCompression compression) {
+  if (type == wxBITMAP_TYPE_PNG) {
+    set_png_options(img, compression);
+  } else if (type == wxBITMAP_TYPE_JPEG) {
+    set_jpeg_options(img, compression);
+  }
+  return img.SaveFile(filename, type);
+}
@@ -22,6 +22,7 @@ DEFINE_EVENT_TYPE(EVENT_SIZE_CHANGE);
 CardViewer::CardViewer(Window* parent, int id, long style)
   : wxControl(parent, id, wxDefaultPosition, wxDefaultSize, style)
   , up_to_date(false)
+  , drawing(false)
 {}
 
 wxSize CardViewer::DoGetBestSize() const {
@@ -37,12 +38,31 @@ wxSize CardViewer::DoGetBestSize() const {
 }
 
 void CardViewer::redraw(const ValueViewer& v) {
-  // Don't refresh if we OR ANOTHER CardViewer is drawing
+  if (drawing) {
+    // The style of a viewer changed while we are drawing (for instance because of content properties).
+    // If it is outside the area being drawn it must be redrawn afterwards.
+    wxRect rect = viewerRect(v);
+    if (GetUpdateRegion().Contains(rect) != wxInRegion) {
+      pending_redraw.Union(rect);
+    }
+    return;
+  }
+  // Don't refresh if ANOTHER CardViewer is drawing
   // drawing another viewer causes styles to be updated for its active card, which may be different,
   // causing the two viewers to continously refresh.
   if (drawing_card()) return;
   up_to_date = false;
-  RefreshRect(getRotation().trRectToBB(v.boundingBox()), false);
+  RefreshRect(viewerRect(v), false);
+}
+
+wxRect CardViewer::viewerRect(const ValueViewer& v) const {
+  Rotation rot = getRotation();
+  wxRect rect = rot.trRectToBB(v.boundingBox()).toRect();
+  if (v.drawn_box.width > 0 && v.drawn_box.height > 0) {
+    // the viewer may have moved, also redraw the old area
+    rect.Union(rot.trRectToBB(v.drawn_box).toRect());
+  }
+  return rect;
 }
 
 void CardViewer::onChange() {
@@ -92,9 +112,17 @@ void CardViewer::onPaint(wxPaintEvent&) {
   // draw
   if (!up_to_date) {
     up_to_date = true;
+    drawing = true;
     try {
       draw(dc);
     } CATCH_ALL_ERRORS(false); // don't show message boxes in onPaint!
+    drawing = false;
+  }
+  // viewers that changed while drawing
+  if (!pending_redraw.IsEmpty()) {
+    up_to_date = false;
+    RefreshRect(pending_redraw, false);
+    pending_redraw = wxRect();
   }
 }
 
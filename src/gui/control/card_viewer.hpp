@@ -48,7 +48,8 @@ class CardViewer : public wxControl, public DataViewer {
   virtual void onChangeSize();
   
   /// Should the given viewer be drawn?
-  bool shouldDraw(const ValueViewer&) const;
+  /** Only viewers that intersect the invalidated region are drawn, the rest of the buffer is kept */
+  virtual bool shouldDraw(const ValueViewer&) const;
   
   virtual void drawViewer(RotatedDC& dc, ValueViewer& v);
   
@@ -60,6 +61,11 @@ class CardViewer : public wxControl, public DataViewer {
   
   Bitmap buffer;     ///< Off-screen buffer we draw to
   bool   up_to_date; ///< Is the buffer up to date?
+  bool   drawing;    ///< Are we currently drawing to the buffer?
+  wxRect pending_redraw; ///< Area of viewers that changed while drawing, and that must be redrawn afterwards
+  
+  /// The area of the control covered by a viewer, now and when it was last drawn
+  wxRect viewerRect(const ValueViewer& v) const;
   
   class OverdrawDC;
   class OverdrawDC_aux;
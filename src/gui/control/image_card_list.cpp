@@ -13,6 +13,7 @@
 #include <data/game.hpp>
 #include <data/card.hpp>
 #include <gfx/gfx.hpp>
+#include <gfx/image_pool.hpp>
 #include <wx/imaglist.h>
 #include <gui/util.hpp>
 
@@ -63,7 +64,7 @@ class CardThumbnailRequest : public ThumbnailRequest {
     try {
       ImageCardList* parent = (ImageCardList*)owner;
       Image image;
-      if (image_load_file(image, *parent->set->openIn(filename))) {
+      if (image_pool.load(image, *parent->set, filename, 36, 28)) {
         // two step anti aliased resampling
         image.Rescale(36, 28); // step 1: no anti aliassing
         return resample(image, 18, 14); // step 2: with anti aliassing
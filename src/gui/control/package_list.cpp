@@ -13,7 +13,7 @@
 #include <script/profiler.hpp>
 #include <gui/util.hpp>
 
-DECLARE_TYPEOF_COLLECTION(PackagedP);
+DECLARE_TYPEOF_COLLECTION(PackageHeaderP);
 
 // ----------------------------------------------------------------------------- : PackageList
 
@@ -65,7 +65,7 @@ void PackageList::showData(const String& pattern) {
   // clear
   packages.clear();
   // find matching packages
-  vector<PackagedP> matching;
+  vector<PackageHeaderP> matching;
   {
     PROFILER(_("find matching packages"));
     package_manager.findMatching(pattern, matching);
@@ -88,6 +88,10 @@ void PackageList::showData(const String& pattern) {
   update();
 }
 
+PackagedP PackageList::openSelection(bool load_fully) const {
+  return package_manager.openAny(packages.at(getSelectionId()).package->absoluteFilename(), !load_fully);
+}
+
 void PackageList::clear() {
   packages.clear();
   update();
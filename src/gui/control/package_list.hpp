@@ -14,6 +14,7 @@
 #include <gui/control/gallery_list.hpp>
 
 DECLARE_POINTER_TYPE(Packaged);
+DECLARE_POINTER_TYPE(PackageHeader);
 
 // ----------------------------------------------------------------------------- : PackageList
 
@@ -35,13 +36,13 @@ class PackageList : public GalleryList {
   void clear();
     
   /// Get the selected package, T should be the same type used for showData
-  /** @pre hasSelection()
+  /** The package is opened when it is first selected.
+   *  @pre hasSelection()
    *  Throws if the selection is not of type T */
   template <typename T>
   intrusive_ptr<T> getSelection(bool load_fully = true) const {
-    intrusive_ptr<T> ret = dynamic_pointer_cast<T>(packages.at(getSelectionId()).package);
+    intrusive_ptr<T> ret = dynamic_pointer_cast<T>(openSelection(load_fully));
     if (!ret) throw InternalError(_("PackageList: Selected package has the wrong type"));
-    if (load_fully) ret->loadFully();
     return ret;
   }
   
@@ -59,15 +60,18 @@ class PackageList : public GalleryList {
   virtual size_t itemCount() const;
   
   private:
+  /// Open the selected package
+  PackagedP openSelection(bool load_fully) const;
+  
   // The default icon to use
 //  wxIcon default_icon;
   
   // Information about a package
   struct PackageData {
     PackageData() {}
-    PackageData(const PackagedP& package, const Bitmap& image) : package(package), image(image) {}
-    PackagedP package;
-    Bitmap    image;
+    PackageData(const PackageHeaderP& package, const Bitmap& image) : package(package), image(image) {}
+    PackageHeaderP package;
+    Bitmap         image;
   };
   struct ComparePackagePosHint;
   /// The displayed packages
@@ -16,6 +16,7 @@
 #include <script/context.hpp>
 #include <util/tagged_string.hpp>
 #include <wx/filename.h>
+#include <wx/progdlg.h>
 
 DECLARE_TYPEOF_COLLECTION(CardP);
 
@@ -52,6 +53,23 @@ ImagesExportWindow::ImagesExportWindow(Window* parent, const SetP& set, const Ex
 
 // ----------------------------------------------------------------------------- : Exporting the images
 
+/// Shows the progress of exporting images in a dialog
+class ExportImagesProgressDialog : public ExportImagesProgress {
+  public:
+  ExportImagesProgressDialog(Window* parent, size_t count)
+    : dialog(_TITLE_("export images"), _LABEL_2_("exporting images", _("0"), String::Format(_("%d"), (int)count)), max(1, (int)count), parent,
+             wxPD_AUTO_HIDE | wxPD_APP_MODAL | wxPD_CAN_ABORT | wxPD_SMOOTH)
+  {}
+  
+  virtual bool onProgress(size_t written, size_t total) {
+    dialog.SetRange(max(1, (int)total));
+    return dialog.Update((int)written, _LABEL_2_("exporting images", String::Format(_("%d"), (int)written), String::Format(_("%d"), (int)total)));
+  }
+  
+  private:
+  wxProgressDialog dialog;
+};
+
 void ImagesExportWindow::onOk(wxCommandEvent&) {
   // Update settings
   GameSettings& gs = settings.gameSettingsFor(*set->game);
@@ -67,7 +85,9 @@ void ImagesExportWindow::onOk(wxCommandEvent&) {
   if (name.empty()) return;
   settings.default_export_dir = wxPathOnly(name);
   // Export
-  export_images(set, getSelection(), name, gs.images_export_filename, gs.images_export_conflicts);
+  const vector<CardP>& cards = getSelection();
+  ExportImagesProgressDialog progress(this, cards.size());
+  export_images(set, cards, name, gs.images_export_filename, gs.images_export_conflicts, &progress);
   // Done
   EndModal(wxID_OK);
 }
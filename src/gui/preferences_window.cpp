@@ -16,7 +16,7 @@
 #include <wx/filename.h>
 #include <wx/notebook.h>
 
-DECLARE_TYPEOF_COLLECTION(PackagedP);
+DECLARE_TYPEOF_COLLECTION(PackageHeaderP);
 
 // use a combo box for the zoom choices instead of a spin control
 #define USE_ZOOM_COMBOBOX 1
@@ -141,7 +141,7 @@ END_EVENT_TABLE  ()
 
 // ----------------------------------------------------------------------------- : Preferences page : global
 
-bool compare_package_name(const PackagedP& a, const PackagedP& b) {
+bool compare_package_name(const PackageHeaderP& a, const PackageHeaderP& b) {
   return a->name() < b->name();
 }
 
@@ -152,12 +152,12 @@ GlobalPreferencesPage::GlobalPreferencesPage(Window* parent)
   language = new wxComboBox(this, wxID_ANY, _(""), wxDefaultPosition, wxDefaultSize, 0, nullptr, wxCB_READONLY);
   open_sets_in_new_window = new wxCheckBox(this, wxID_ANY, _BUTTON_("open sets in new window"));
   // set values
-  vector<PackagedP> locales;
+  vector<PackageHeaderP> locales;
   package_manager.findMatching(_("*.mse-locale"), locales);
   sort(locales.begin(), locales.end(), compare_package_name);
   int n = 0;
   FOR_EACH(package, locales) {
-    language->Append(package->name() + _(": ") + package->full_name, package.get());
+    language->Append(package->name() + _(": ") + package->full_name, new wxStringClientData(package->name()));
     if (settings.locale == package->name()) {
       language->SetSelection(n);
     }
@@ -182,8 +182,8 @@ void GlobalPreferencesPage::store() {
   // locale
   int n = language->GetSelection();
   if (n == wxNOT_FOUND) return;
-  Packaged* p = (Packaged*)language->GetClientData(n);
-  settings.locale = p->name();
+  wxStringClientData* name = (wxStringClientData*)language->GetClientObject(n);
+  settings.locale = name->GetData();
   // set the_locale?
   // open_sets_in_new_window
   settings.open_sets_in_new_window = open_sets_in_new_window->GetValue();
@@ -152,8 +152,9 @@ void KeywordsPanel::destroyUI(wxToolBar* tb, wxMenuBar* mb) {
   // Menus
   mb->Remove(2);
   
-  // This is also a good moment to propagate changes
-  if (set) set->updateDelayed();
+  // This is also a good moment to propagate changes,
+  // delayed cards are left to the background update
+  if (set) set->updateDelayedKeywords();
 }
 
 void KeywordsPanel::onUpdateUI(wxUpdateUIEvent& ev) {
@@ -377,6 +377,8 @@ void SetWindow::onCardActivate(CardSelectEvent& ev) {
 }
 
 void SetWindow::selectionChoices(ExportCardSelectionChoices& out) {
+  // we are going to export or print cards, they should be up to date
+  set->updateDelayed();
   out.push_back(intrusive(new ExportCardSelectionChoice(*set))); // entire set
   FOR_EACH(p, panels) {
     p->selectionChoices(out);
@@ -654,10 +656,12 @@ void SetWindow::onFileExportHTML(wxCommandEvent&) {
 }
 
 void SetWindow::onFileExportApprentice(wxCommandEvent&) {
+  set->updateDelayed();
   export_apprentice(this, set);
 }
 
 void SetWindow::onFileExportMWS(wxCommandEvent&) {
+  set->updateDelayed();
   export_mws(this, set);
 }
 
@@ -818,9 +822,16 @@ void SetWindow::onMenuOpen(wxMenuEvent& ev) {
   wxFrame::OnMenuOpen(ev);
 }
 
+/// Time to spend on updating cards in each idle event, in milliseconds
+const long background_update_time = 50;
+
 void SetWindow::onIdle(wxIdleEvent& ev) {
   // Stuff that must be done in the main thread
   show_update_dialog(this);
+  // update the cards of large sets in the background
+  if (set && set->updateSomeDelayed(background_update_time)) {
+    ev.RequestMore();
+  }
 }
 
 // ----------------------------------------------------------------------------- : Event table
@@ -249,8 +249,11 @@ void SymbolWindow::onFileStore(wxCommandEvent& ev) {
     SymbolValueP value = static_pointer_cast<SymbolValue>(performer->value);
     Package& package = performer->getLocalPackage();
     FileName new_filename = package.newFileName(value->field().name,_(".mse-symbol")); // a new unique name in the package
-    Writer writer(package.openOut(new_filename), file_version_symbol);
-    writer.handle(control->getSymbol());
+    {
+      // the writer must be done with the file before the new value is used
+      Writer writer(package.openOut(new_filename), file_version_symbol);
+      writer.handle(control->getSymbol());
+    }
     performer->addAction(value_action(value, new_filename));
   }
 }
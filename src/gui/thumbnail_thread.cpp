@@ -10,6 +10,7 @@
 #include <gui/thumbnail_thread.hpp>
 #include <util/platform.hpp>
 #include <util/error.hpp>
+#include <gfx/gfx.hpp>
 #include <wx/thread.h>
 
 typedef pair<ThumbnailRequestP,Image> pair_ThumbnailRequestP_Image;
@@ -83,7 +84,7 @@ wxThread::ExitCode ThumbnailThreadWorker::Entry() {
     // store in cache
     if (img.Ok()) {
       String filename = image_cache_dir() + safe_filename(current->cache_name) + _(".png");
-      img.SaveFile(filename, wxBITMAP_TYPE_PNG);
+      save_image(img, filename, wxBITMAP_TYPE_PNG, COMPRESSION_FAST);
       // set modification time
       wxFileName fn(filename);
       fn.SetTimes(0, &current->modified, 0);
@@ -156,7 +157,7 @@ void ThumbnailThread::request(const ThumbnailRequestP& request) {
     // store in cache
     if (img.Ok()) {
       String filename = image_cache_dir() + safe_filename(request->cache_name) + _(".png");
-      img.SaveFile(filename, wxBITMAP_TYPE_PNG);
+      save_image(img, filename, wxBITMAP_TYPE_PNG, COMPRESSION_FAST);
       // set modification time
       wxFileName fn(filename);
       fn.SetTimes(0, &request->modified, 0);
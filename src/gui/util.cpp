@@ -10,6 +10,7 @@
 #include <gui/util.hpp>
 #include <util/error.hpp>
 #include <util/rotation.hpp>
+#include <util/io/package.hpp>
 #include <wx/renderer.h>
 #include <wx/stdpaths.h>
 
@@ -139,6 +140,40 @@ bool image_load_file(Image& image, const wxString &name) {
   return image.LoadFile(name);
 }
 
+bool image_load_file(Image& image, Package& package, const String& filename, int min_width, int min_height, bool* reduced_out) {
+  if (reduced_out) *reduced_out = false;
+  #ifdef wxIMAGE_OPTION_MAX_WIDTH
+    wxImageHandler* jpeg = wxImage::FindHandler(wxBITMAP_TYPE_JPEG);
+    if ((min_width > 0 || min_height > 0) && jpeg) {
+      // The size is halved while it is larger than the maximum, the JPEG decoder does that as part of the DCT.
+      // With a maximum of 2*min-1 the result is never smaller than min, but only for a side that was halved;
+      // if the aspect ratio differs, the other side can end up too small, then decode the full image after all.
+      // Other handlers treat the maximum as a plain limit, or ignore it, so only use it for JPEG files.
+      InputStreamP stream = package.openIn(filename);
+      wxLogNull noLog;
+      if (jpeg->CanRead(*stream)) {
+        Image reduced;
+        if (min_width  > 0) reduced.SetOption(wxIMAGE_OPTION_MAX_WIDTH,  2 * min_width  - 1);
+        if (min_height > 0) reduced.SetOption(wxIMAGE_OPTION_MAX_HEIGHT, 2 * min_height - 1);
+        if (!reduced.LoadFile(*stream, wxBITMAP_TYPE_JPEG)) return false;
+        if (reduced.GetWidth() >= min_width && reduced.GetHeight() >= min_height) {
+          image = reduced;
+          if (reduced_out) {
+            #ifdef wxIMAGE_OPTION_ORIGINAL_WIDTH
+              *reduced_out = reduced.GetOptionInt(wxIMAGE_OPTION_ORIGINAL_WIDTH)  != reduced.GetWidth()
+                          || reduced.GetOptionInt(wxIMAGE_OPTION_ORIGINAL_HEIGHT) != reduced.GetHeight();
+            #else
+              *reduced_out = true; // older decoders don't tell the original size
+            #endif
+          }
+          return true;
+        }
+      }
+    }
+  #endif
+  return image_load_file(image, *package.openIn(filename));
+}
+
 // ----------------------------------------------------------------------------- : Resource related
 
 Image load_resource_image(const String& name) {
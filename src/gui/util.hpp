@@ -17,6 +17,7 @@
 
 class RotatedDC;
 class RealRect;
+class Package;
 
 // ----------------------------------------------------------------------------- : Window related
 
@@ -48,6 +49,13 @@ bool image_load_file(Image& image, wxInputStream &stream);
 /// Proxy around Image.LoadFile that suppresses errors. 
 bool image_load_file(Image& image, const wxString &name);
 
+/// Load an image from a package, that will be resized to (at most) min_width*min_height afterwards.
+/** The image is at least min_width*min_height (0 means no minimum), but can be smaller than the file,
+ *  if the decoder can decode it at a reduced size (JPEG only), then *reduced is set to true.
+ *  Throws if the file doesn't exist, returns false if it is not a valid image.
+ */
+bool image_load_file(Image& image, Package& package, const String& filename, int min_width, int min_height, bool* reduced = nullptr);
+
 // ----------------------------------------------------------------------------- : Resource related
 
 /// Load an image from a resource
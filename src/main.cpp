@@ -11,6 +11,9 @@
 #include <util/spell_checker.hpp>
 #include <data/game.hpp>
 #include <data/set.hpp>
+#include <data/card.hpp>
+#include <data/stylesheet.hpp>
+#include <data/field/text.hpp>
 #include <data/settings.hpp>
 #include <data/locale.hpp>
 #include <data/installer.hpp>
@@ -23,11 +26,15 @@
 #include <gui/set/window.hpp>
 #include <gui/symbol/window.hpp>
 #include <gui/thumbnail_thread.hpp>
+#include <gfx/gfx.hpp>
+#include <gfx/image_pool.hpp>
 #include <wx/fs_inet.h>
 #include <wx/wfstream.h>
 #include <wx/txtstrm.h>
 #include <wx/socket.h>
 
+DECLARE_TYPEOF_NO_REV(IndexMap<FieldP COMMA ValueP>);
+
 // ----------------------------------------------------------------------------- : Main function/class
 
 /// The application class for MSE.
@@ -74,6 +81,85 @@ void nag_about_ascii_version() {
   #endif
 }
 
+// ----------------------------------------------------------------------------- : Command line export
+
+/// Reports the progress of exporting images on the command line, every 10%
+class CLIExportProgress : public ExportImagesProgress {
+  public:
+  CLIExportProgress() : reported(-1) {}
+  
+  virtual bool onProgress(size_t written, size_t total) {
+    int step = total == 0 ? 10 : (int)(10 * written / total);
+    if (step != reported) {
+      reported = step;
+      cli << String::Format(_("Exported %d of %d cards"), (int)written, (int)total) << ENDL;
+      cli.flush();
+    }
+    return true;
+  }
+  
+  virtual void onFinished(const ExportImagesStats& stats) {
+    cli << String::Format(_("Drawing took %.2f s, encoding took %.2f s (summed over all threads)"),
+                          stats.render_time / 1000.0, stats.encode_time / 1000.0) << ENDL;
+    cli.flush();
+  }
+  
+  private:
+  int reported; ///< Last reported step
+};
+
+/// Set export_compression from the argument of --compression
+bool set_export_compression(const String& level) {
+  if      (level == _("fast"))    export_compression = COMPRESSION_FAST;
+  else if (level == _("default")) export_compression = COMPRESSION_DEFAULT;
+  else if (level == _("best"))    export_compression = COMPRESSION_BEST;
+  else {
+    handle_error(Error(_("--compression expects fast, default or best")));
+    return false;
+  }
+  return true;
+}
+
+// ----------------------------------------------------------------------------- : Command line benchmark
+
+/// Write a set with generated cards, and time how long it takes to read it back
+/** Used with --benchmark-read. The text fields of the cards are filled in,
+ *  the other fields keep their default values, as many values in a real set do.
+ */
+void benchmark_read(const String& game_name, const String& stylesheet_name, int card_count) {
+  GameP       game       = Game::byName(game_name);
+  StyleSheetP stylesheet = StyleSheet::byGameAndName(*game, stylesheet_name);
+  SetP set = intrusive(new Set(stylesheet));
+  for (int i = 0 ; i < card_count ; ++i) {
+    CardP card = intrusive(new Card(*game));
+    FOR_EACH(v, card->data) {
+      TextValue* text = dynamic_cast<TextValue*>(v.get());
+      if (!text) continue;
+      const TextField& field = static_cast<const TextField&>(*text->fieldP);
+      if (field.multi_line) {
+        text->value.assign(String::Format(_("The %s of card %d.\nA second line, shared by card %d."), field.name.c_str(), i, i % 10));
+      } else {
+        text->value.assign(String::Format(_("%s %d"), field.name.c_str(), i));
+      }
+    }
+    set->cards.push_back(card);
+  }
+  String filename = wxFileName::GetTempDir() + _("/mse-benchmark-read.mse-set");
+  wxStopWatch timer;
+  set->saveAs(filename);
+  cli << String::Format(_("Wrote %d cards in %.2f s"), card_count, timer.Time() / 1000.0) << ENDL;
+  cli.flush();
+  // the first read can also include reading the game and stylesheet
+  for (int run = 0 ; run < 3 ; ++run) {
+    timer.Start();
+    SetP read = intrusive(new Set);
+    read->open(filename);
+    cli << String::Format(_("Read %d cards in %.2f s"), (int)read->cards.size(), timer.Time() / 1000.0) << ENDL;
+    cli.flush();
+  }
+  wxRemoveFile(filename);
+}
+
 // ----------------------------------------------------------------------------- : Initialization
 
 int MSE::OnRun() {
@@ -92,6 +178,8 @@ int MSE::OnRun() {
     cli.init();
     package_manager.init();
     settings.read();
+    image_pool.setMaxBytes((size_t)settings.image_pool_size << 20);
+    Package::append_on_save = settings.append_on_save;
     the_locale = Locale::byName(settings.locale);
     nag_about_ascii_version();
     
@@ -171,16 +259,30 @@ int MSE::OnRun() {
                              << PARAM << _("PACKAGE") << NORMAL << _(" [") << PARAM << _("PACKAGE") << NORMAL << _(" ...]]");
           cli << _("\n         \tCreate an instaler, containing the listed packages.");
           cli << _("\n         \tIf no output filename is specified, the name of the first package is used.");
-          cli << _("\n\n  ") << BRIGHT << _("--export") << NORMAL << PARAM << _(" FILE") << NORMAL << _(" [") << PARAM << _("IMAGE") << NORMAL << _("]");
+          cli << _("\n\n  ") << BRIGHT << _("--export") << NORMAL << PARAM << _(" FILE") << NORMAL << _(" [") << PARAM << _("IMAGE") << NORMAL << _("] [")
+                             << BRIGHT << _("--software-render") << NORMAL << _("] [")
+                             << BRIGHT << _("--jobs") << NORMAL << PARAM << _(" N") << NORMAL << _("] [")
+                             << BRIGHT << _("--compression") << NORMAL << PARAM << _(" LEVEL") << NORMAL << _("]");
           cli << _("\n         \tExport the cards in a set to image files,");
           cli << _("\n         \tIMAGE is the same format as for 'export all card images'.");
+          cli << _("\n         \tWith ") << BRIGHT << _("--software-render") << NORMAL << _(" the cards are drawn into an image buffer instead of a device context,");
+          cli << _("\n         \tglyphs are still rasterized by the windowing system, so a display is needed either way.");
+          cli << _("\n         \tImage files are written by N threads, by default one for each processor.");
+          cli << _("\n         \tLEVEL is one of fast, default or best, how much to compress the image files.");
+          cli << _("\n\n  ") << BRIGHT << _("--benchmark-read") << NORMAL << PARAM << _(" GAME STYLESHEET") << NORMAL << _(" [") << PARAM << _("CARDS") << NORMAL << _("]");
+          cli << _("\n         \tWrite a set with CARDS generated cards, 10000 by default, to a temporary file,");
+          cli << _("\n         \tand report how long it takes to write and read it.");
           cli << _("\n\n  ") << BRIGHT << _("--cli") << NORMAL << _(" [")
                              << PARAM << _("FILE") << NORMAL << _("] [")
                              << BRIGHT << _("--quiet") << NORMAL << _("] [")
-                             << BRIGHT << _("--raw") << NORMAL << _("]");
+                             << BRIGHT << _("--raw") << NORMAL << _("] [")
+                             << BRIGHT << _("--software-render") << NORMAL << _("] [")
+                             << BRIGHT << _("--compression") << NORMAL << PARAM << _(" LEVEL") << NORMAL << _("]");
           cli << _("\n         \tStart the command line interface for performing commands on the set file.");
           cli << _("\n         \tUse ") << BRIGHT << _("-q") << NORMAL << _(" or ") << BRIGHT << _("--quiet") << NORMAL << _(" to supress the startup banner and prompts.");
           cli << _("\n         \tUse ") << BRIGHT << _("-raw") << NORMAL << _(" for raw output mode.");
+          cli << _("\n         \tUse ") << BRIGHT << _("--software-render") << NORMAL << _(" to draw card images for export into an image buffer (this still needs a display),");
+          cli << _("\n         \tand ") << BRIGHT << _("--compression") << NORMAL << _(" to choose how much to compress exported images.");
           cli << _("\n\nRaw output mode is intended for use by other programs:");
           cli << _("\n    - The only output is only in response to commands.");
           cli << _("\n    - For each command a single 'record' is written to the standard output.");
@@ -211,16 +313,49 @@ int MSE::OnRun() {
             } else if (arg == _("-r") || arg == _("--raw")) {
               quiet = true;
               cli.enableRaw();
+            } else if (arg == _("--software-render")) {
+              software_rendering = true;
+            } else if (arg == _("--compression") && i + 1 < argc) {
+              if (!set_export_compression(argv[++i])) return EXIT_FAILURE;
             }
           }
           CLISetInterface cli_interface(set,quiet);
           return EXIT_SUCCESS;
+        } else if (arg == _("--benchmark-read")) {
+          if (argc <= 3) {
+            handle_error(Error(_("--benchmark-read expects a game and a stylesheet")));
+            return EXIT_FAILURE;
+          }
+          long cards = 10000;
+          if (argc > 4 && (!String(argv[4]).ToLong(&cards) || cards <= 0)) {
+            handle_error(Error(_("--benchmark-read expects a positive number of cards")));
+            return EXIT_FAILURE;
+          }
+          benchmark_read(argv[2], argv[3], (int)cards);
+          return EXIT_SUCCESS;
         } else if (arg == _("--export")) {
           if (argc <= 2 || (argc <= 3 && starts_with(argv[2],_("--")))) {
             handle_error(Error(_("No input file specified for --export")));
             return EXIT_FAILURE;
           }
+          int jobs = 0;
+          for (int i = 3 ; i < argc ; ++i) {
+            String arg = argv[i];
+            if (arg == _("--software-render")) {
+              software_rendering = true;
+            } else if (arg == _("--jobs") && i + 1 < argc) {
+              long n;
+              if (!String(argv[++i]).ToLong(&n) || n <= 0) {
+                handle_error(Error(_("--jobs expects a positive number")));
+                return EXIT_FAILURE;
+              }
+              jobs = (int)n;
+            } else if (arg == _("--compression") && i + 1 < argc) {
+              if (!set_export_compression(argv[++i])) return EXIT_FAILURE;
+            }
+          }
           SetP set = import_set(argv[2]);
+          set->updateDelayed();
           // path
           String out = argc >= 3 && !starts_with(argv[3],_("--"))
                      ? argv[3]
@@ -234,7 +369,8 @@ int MSE::OnRun() {
             out  = out.substr(pos + 1);
           }
           // export
-          export_images(set, set->cards, path, out, CONFLICT_NUMBER_OVERWRITE);
+          CLIExportProgress progress;
+          export_images(set, set->cards, path, out, CONFLICT_NUMBER_OVERWRITE, &progress, jobs);
           return EXIT_SUCCESS;
         } else {
           handle_error(_("Invalid command line argument:\n") + String(argv[1]));
@@ -265,6 +401,7 @@ int MSE::OnExit() {
   settings.write();
   package_manager.destroy();
   SpellChecker::destroyAll();
+  clear_text_run_cache();
   return 0;
 }
 
@@ -9,6 +9,7 @@
 #include <util/prec.hpp>
 #include <render/card/viewer.hpp>
 #include <render/value/viewer.hpp>
+#include <gfx/canvas.hpp>
 #include <data/set.hpp>
 #include <data/stylesheet.hpp>
 #include <data/card.hpp>
@@ -16,7 +17,6 @@
 #include <data/settings.hpp>
 #include <data/action/value.hpp>
 #include <data/action/set.hpp>
-#include <gui/util.hpp> // clearDC
 
 DECLARE_TYPEOF_COLLECTION(ValueViewerP);
 DECLARE_TYPEOF_NO_REV(IndexMap<FieldP COMMA StyleP>);
@@ -36,17 +36,22 @@ void DataViewer::draw(DC& dc) {
                 nativeLook() ? QUALITY_LOW : (ss.card_anti_alias() ? QUALITY_AA : QUALITY_SUB_PIXEL));
   draw(rdc, stylesheet->card_background);
 }
+void DataViewer::draw(ImageCanvas& canvas) {
+  RotatedDC rdc(canvas, getRotation(), QUALITY_AA);
+  draw(rdc, stylesheet->card_background);
+}
 void DataViewer::draw(RotatedDC& dc, const Color& background) {
   if (!set) return; // no set specified, don't draw anything
   WITH_DYNAMIC_ARG(drawing_card, true);
   // fill with background color
-  clearDC(dc.getDC(), background);
+  dc.SetBrush(background);
+  dc.Fill();
   // update style scripts
   updateStyles(false);
   // prepare viewers
   bool changed_content_properties = false;
   FOR_EACH(v, viewers) { // draw low z index fields first
-    if (v->getStyle()->isVisible()) {
+    if (v->getStyle()->isVisible() && shouldDraw(*v)) {
       Rotater r(dc, v->getRotation());
       try {
         if (v->prepare(dc)) {
@@ -62,19 +67,23 @@ void DataViewer::draw(RotatedDC& dc, const Color& background) {
   }
   // draw viewers
   FOR_EACH(v, viewers) { // draw low z index fields first
-    if (v->getStyle()->isVisible()) {// visible
+    if (v->getStyle()->isVisible() && shouldDraw(*v)) {// visible
       Rotater r(dc, v->getRotation());
       try {
         drawViewer(dc, *v);
       } catch (const Error& e) {
         handle_error(e);
       }
+      v->drawn_box = v->boundingBox();
     }
   }
 }
 void DataViewer::drawViewer(RotatedDC& dc, ValueViewer& v) {
   v.draw(dc);
 }
+bool DataViewer::shouldDraw(const ValueViewer&) const {
+  return true;
+}
 
 void DataViewer::updateStyles(bool only_content_dependent) {
   try {
@@ -214,9 +223,9 @@ void DataViewer::onAction(const Action& action, bool undone) {
     if (action.card == card.get()) {
       FOR_EACH(v, viewers) {
         if (v->getValue()->equals( action.valueP.get() )) {
-          // refresh the viewer
+          // refresh the viewer, styles that depend on the value are updated when it is drawn
           v->onAction(action, undone);
-          onChange();
+          redraw(*v);
           return;
         }
       }
@@ -228,7 +237,7 @@ void DataViewer::onAction(const Action& action, bool undone) {
         if (v->getValue().get() == action.value) {
           // refresh the viewer
           v->onAction(action, undone);
-          onChange();
+          redraw(*v);
           return;
         }
       }
@@ -17,6 +17,7 @@
 DECLARE_POINTER_TYPE(Style);
 DECLARE_POINTER_TYPE(ValueViewer);
 class Context;
+class ImageCanvas;
 
 // ----------------------------------------------------------------------------- : DataViewer
 
@@ -34,8 +35,14 @@ class DataViewer : public SetView {
   virtual void draw(DC& dc);
   /// Draw the current (card/data) to the given dc
   virtual void draw(RotatedDC& dc, const Color& background);
+  /// Draw the current (card/data) to an image canvas, without drawing to a DC
+  void draw(ImageCanvas& canvas);
   /// Draw a single viewer
   virtual void drawViewer(RotatedDC& dc, ValueViewer& v);
+  /// Does the given viewer need to be prepared and drawn?
+  /** Viewers outside the area being redrawn can be skipped, they are still up to date.
+   *  true by default, can be overloaded */
+  virtual bool shouldDraw(const ValueViewer&) const;
   
   // --------------------------------------------------- : Utility for ValueViewers
   
@@ -48,7 +55,7 @@ class DataViewer : public SetView {
   /// Is the given viewer currently selected?
   virtual bool viewerIsCurrent(const ValueViewer*) const;
   /// Get a script context to use for scripts in the viewers
-  Context& getContext() const;
+  virtual Context& getContext() const;
   /// The rotation to use
   virtual Rotation getRotation() const;
   /// The card we are viewing, can be null
@@ -76,9 +83,10 @@ class DataViewer : public SetView {
   private:
   /// Create some viewers for the given styles
   void addStyles(IndexMap<FieldP,StyleP>& styles);
-  /// Update style scripts
-  void updateStyles(bool only_content_dependent);
   protected:
+  /// Update style scripts
+  /** Can be overloaded to use other styles or another script context */
+  virtual void updateStyles(bool only_content_dependent);
   /// Set the styles for the data to be shown, recreating the viewers
   void setStyles(const StyleSheetP& stylesheet, IndexMap<FieldP,StyleP>& styles, IndexMap<FieldP,StyleP>* extra_styles = nullptr);
   /// Set the data to be shown in the viewers, refresh them
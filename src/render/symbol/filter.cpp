@@ -10,6 +10,7 @@
 #include <render/symbol/filter.hpp>
 #include <render/symbol/viewer.hpp>
 #include <gfx/gfx.hpp>
+#include <gfx/rasterize.hpp>
 #include <util/error.hpp>
 
 // ----------------------------------------------------------------------------- : Symbol filtering
@@ -48,10 +49,58 @@ void filter_symbol(Image& symbol, const SymbolFilter& filter) {
   }
 }
 
+Image filter_symbol(const CoverageBuffer& inside, const CoverageBuffer& border, const SymbolFilter& filter) {
+  UInt width = inside.width, height = inside.height;
+  Image symbol(width, height, false);
+  Byte* data  = symbol.GetData();
+  Byte* alpha = (Byte*) malloc(width * height); // see HACK above
+  symbol.SetAlpha(alpha);
+  size_t i = 0;
+  for (UInt y = 0 ; y < height ; ++y) {
+    for (UInt x = 0 ; x < width ; ++x) {
+      double xx = (double)x / width, yy = (double)y / height;
+      // weights of the three sets
+      double in = inside.data[i], bo = border.data[i];
+      double w[3] = { in, bo, max(0., 1. - in - bo) };
+      // blend the colors of the sets, with premultiplied alpha
+      double r = 0, g = 0, b = 0, a = 0;
+      for (int set = 0 ; set < 3 ; ++set) {
+        if (w[set] <= 0) continue;
+        AColor c = filter.color(xx, yy, (SymbolSet)set);
+        double wa = w[set] * c.alpha;
+        r += wa * c.Red();
+        g += wa * c.Green();
+        b += wa * c.Blue();
+        a += wa;
+      }
+      if (a > 0) {
+        data[0] = (Byte)min(255., r / a + 0.5);
+        data[1] = (Byte)min(255., g / a + 0.5);
+        data[2] = (Byte)min(255., b / a + 0.5);
+      } else {
+        data[0] = data[1] = data[2] = 0;
+      }
+      alpha[0] = (Byte)min(255., a + 0.5);
+      // next
+      data  += 3;
+      alpha += 1;
+      i     += 1;
+    }
+  }
+  return symbol;
+}
+
 Image render_symbol(const SymbolP& symbol, const SymbolFilter& filter, double border_radius, int width, int height, bool edit_hints, bool allow_smaller) {
-  Image i = render_symbol(symbol, border_radius, width, height, edit_hints, allow_smaller);
-  filter_symbol(i, filter);
-  return i;
+  if (edit_hints) {
+    // editing hints are only drawn by the DC based renderer
+    Image i = render_symbol(symbol, border_radius, width, height, edit_hints, allow_smaller);
+    filter_symbol(i, filter);
+    return i;
+  } else {
+    CoverageBuffer inside, border;
+    render_symbol(symbol, inside, border, border_radius, width, height, allow_smaller);
+    return filter_symbol(inside, border, filter);
+  }
 }
 
 // ----------------------------------------------------------------------------- : SymbolFilter
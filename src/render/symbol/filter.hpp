@@ -15,6 +15,7 @@
 
 DECLARE_POINTER_TYPE(Symbol);
 class SymbolFilter;
+class CoverageBuffer;
 
 // ----------------------------------------------------------------------------- : Symbol filtering
 
@@ -24,6 +25,10 @@ class SymbolFilter;
  */
 void filter_symbol(Image& symbol, const SymbolFilter& filter);
 
+/// Filter a symbol given as anti aliased coverage buffers (see render_symbol in render/symbol/viewer.hpp)
+/** Pixels that are partially inside/border/outside get a blend of the filter colors */
+Image filter_symbol(const CoverageBuffer& inside, const CoverageBuffer& border, const SymbolFilter& filter);
+
 /// Render a Symbol to an Image and filter it
 Image render_symbol(const SymbolP& symbol, const SymbolFilter& filter, double border_radius = 0.05, int width = 100, int height = 100, bool edit_hints = false, bool allow_smaller = false);
 
@@ -8,6 +8,7 @@
 
 #include <util/prec.hpp>
 #include <render/symbol/viewer.hpp>
+#include <gfx/rasterize.hpp>
 #include <util/error.hpp> // clearDC_black
 #include <gui/util.hpp> // clearDC_black
 
@@ -15,8 +16,9 @@ DECLARE_TYPEOF_COLLECTION(SymbolPartP);
 
 // ----------------------------------------------------------------------------- : Simple rendering
 
-Image render_symbol(const SymbolP& symbol, double border_radius, int width, int height, bool editing_hints, bool allow_smaller) {
-  SymbolViewer viewer(symbol, editing_hints, width, border_radius);
+// Set the zoom and origin of a viewer to render a symbol at the given size
+// updates width and height to match the aspect ratio of the symbol
+void fit_symbol_viewer(SymbolViewer& viewer, const SymbolP& symbol, int& width, int& height, bool allow_smaller) {
   // limit width/height ratio to aspect ratio of symbol
   double ar  = symbol->aspectRatio();
   double par = (double)width/height;
@@ -34,6 +36,11 @@ Image render_symbol(const SymbolP& symbol, double border_radius, int width, int
     viewer.setOrigin(Vector2D(-(height-width) * 0.5,0));
     viewer.border_radius *= (double)width / height;
   }
+}
+
+Image render_symbol(const SymbolP& symbol, double border_radius, int width, int height, bool editing_hints, bool allow_smaller) {
+  SymbolViewer viewer(symbol, editing_hints, width, border_radius);
+  fit_symbol_viewer(viewer, symbol, width, height, allow_smaller);
   Bitmap bmp(width, height);
   wxMemoryDC dc;
   dc.SelectObject(bmp);
@@ -43,6 +50,13 @@ Image render_symbol(const SymbolP& symbol, double border_radius, int width, int
   return bmp.ConvertToImage();
 }
 
+void render_symbol(const SymbolP& symbol, CoverageBuffer& inside, CoverageBuffer& border, double border_radius, int width, int height, bool allow_smaller) {
+  SymbolViewer viewer(symbol, false, width, border_radius);
+  fit_symbol_viewer(viewer, symbol, width, height, allow_smaller);
+  inside.resize(width, height);
+  viewer.rasterize(inside, border);
+}
+
 // ----------------------------------------------------------------------------- : Constructor
 
 SymbolViewer::SymbolViewer(const SymbolP& symbol, bool editing_hints, double size, double border_radius)
@@ -151,7 +165,6 @@ void SymbolViewer::combineSymbolPart(DC& dc, const SymbolPart& part, bool& paint
     }
   } else if (const SymbolSymmetry* s = part.isSymbolSymmetry()) {
     // Draw all parts, in reverse order (bottom to top), also draw rotated copies
-    Radians b = 2 * s->handle.angle();
     Matrix2D old_m = multiply;
     Vector2D old_o = origin;
     int copies = s->kind == SYMMETRY_REFLECTION ? s->copies / 2 * 2 : s->copies;
@@ -162,38 +175,7 @@ void SymbolViewer::combineSymbolPart(DC& dc, const SymbolPart& part, bool& paint
         if (s->clip) {
           // todo: clip
         }
-        double a = i * 2 * M_PI / copies;
-        if (s->kind == SYMMETRY_ROTATION || i % 2 == 0) {
-          // set matrix
-          // Calling:
-          //  - p  the input point
-          //  - p' the output point
-          //  - rot our rotation matrix
-          //  - d   out origin
-          //  - o   the current origin (old_o)
-          //  - m   the current matrix (old_m)
-          // We want:
-          //   p' = ((p - d) * rot + d) * m + o
-          //      =  (p * rot - d * rot + d) * m + o
-          //      =  p * rot * m + (d - d * rot) * m + o
-          Matrix2D rot(cos(a),-sin(a), sin(a),cos(a));
-          multiply = rot * old_m;
-          origin = old_o + (s->center - s->center * rot) * old_m;
-        } else {
-          // reflection
-          //  Calling angle = b
-          // Matrix2D ref(cos(b),sin(b), sin(b),-cos(b));
-          // Matrix2D rot(cos(a),-sin(a), sin(a),cos(a));
-          // 
-          //  ref * rot
-          //    [ cos b   sin b !  [ cos a  -sin a !
-          //  = ! sin b  -cos b ]  ! sin a   cos a ]
-          //  = [ cos(a+b)  sin(a+b) !
-          //    ! sin(a+b) -cos(a+b) ]
-          Matrix2D rot(cos(a+b),sin(a+b), sin(a+b),-cos(a+b));
-          multiply = rot * old_m;
-          origin = old_o + (s->center - s->center * rot) * old_m;
-        }
+        setSymmetryCopy(*s, i, copies, old_m, old_o);
         // draw rotated copy
         combineSymbolPart(dc, *p, paintedSomething, buffersFilled, allow_overlap && i == copies - 1, borderDC, interiorDC);
       }
@@ -212,6 +194,42 @@ void SymbolViewer::combineSymbolPart(DC& dc, const SymbolPart& part, bool& paint
 }
 
 
+void SymbolViewer::setSymmetryCopy(const SymbolSymmetry& sym, int i, int copies, const Matrix2D& old_m, const Vector2D& old_o) {
+  Radians b = 2 * sym.handle.angle();
+  double a = i * 2 * M_PI / copies;
+  if (sym.kind == SYMMETRY_ROTATION || i % 2 == 0) {
+    // set matrix
+    // Calling:
+    //  - p  the input point
+    //  - p' the output point
+    //  - rot our rotation matrix
+    //  - d   out origin
+    //  - o   the current origin (old_o)
+    //  - m   the current matrix (old_m)
+    // We want:
+    //   p' = ((p - d) * rot + d) * m + o
+    //      =  (p * rot - d * rot + d) * m + o
+    //      =  p * rot * m + (d - d * rot) * m + o
+    Matrix2D rot(cos(a),-sin(a), sin(a),cos(a));
+    multiply = rot * old_m;
+    origin = old_o + (sym.center - sym.center * rot) * old_m;
+  } else {
+    // reflection
+    //  Calling angle = b
+    // Matrix2D ref(cos(b),sin(b), sin(b),-cos(b));
+    // Matrix2D rot(cos(a),-sin(a), sin(a),cos(a));
+    // 
+    //  ref * rot
+    //    [ cos b   sin b !  [ cos a  -sin a !
+    //  = ! sin b  -cos b ]  ! sin a   cos a ]
+    //  = [ cos(a+b)  sin(a+b) !
+    //    ! sin(a+b) -cos(a+b) ]
+    Matrix2D rot(cos(a+b),sin(a+b), sin(a+b),-cos(a+b));
+    multiply = rot * old_m;
+    origin = old_o + (sym.center - sym.center * rot) * old_m;
+  }
+}
+
 void SymbolViewer::combineSymbolShape(const SymbolShape& shape, DC& border, DC& interior, bool directB, bool directI) {
   // what color should the interior be?
   // use black when drawing to the screen
@@ -288,6 +306,140 @@ void SymbolViewer::drawSymbolShape(const SymbolShape& shape, DC* border, DC* int
   }
 }
 
+// ----------------------------------------------------------------------------- : Drawing : Rasterizing
+
+// The software rasterizer mirrors the DC based drawing above, but keeps anti aliased coverage
+// instead of 1 bit buffers. The logical operations become min/max on the coverage.
+
+struct SymbolViewer::RasterState {
+  RasterState(CoverageBuffer& inside, CoverageBuffer& border)
+    : rasterizer(inside.width, inside.height)
+    , inside(inside), border(border)
+    , filled(false)
+  {
+    border.resize(inside.width, inside.height);
+    buffer_border  .resize(inside.width, inside.height);
+    buffer_interior.resize(inside.width, inside.height);
+  }
+  
+  ScanlineRasterizer rasterizer;
+  CoverageBuffer& inside;          ///< Final result, equivalent to the screen dc
+  CoverageBuffer& border;
+  CoverageBuffer  buffer_border;   ///< Parts not yet combined with the result, equivalent to the temporary dcs
+  CoverageBuffer  buffer_interior;
+  CoverageBuffer  fill, outline;   ///< The current shape, and the shape including its border
+  bool filled;                     ///< Is there something in the buffers?
+  
+  /// Combine the buffers with the result, equivalent to combineBuffers
+  void flush() {
+    size_t n = inside.data.size();
+    for (size_t i = 0 ; i < n ; ++i) {
+      float in = buffer_interior.data[i];
+      float bo = min(buffer_border.data[i], 1 - in);
+      float rest = 1 - in - bo; // what remains of what was there before
+      inside.data[i] = in + inside.data[i] * rest;
+      border.data[i] = bo + border.data[i] * rest;
+    }
+    fill_n(buffer_border  .data.begin(), n, 0.f);
+    fill_n(buffer_interior.data.begin(), n, 0.f);
+    filled = false;
+  }
+};
+
+void SymbolViewer::rasterize(CoverageBuffer& inside, CoverageBuffer& border) {
+  inside.resize(inside.width, inside.height);
+  RasterState state(inside, border);
+  rasterizeSymbolPart(*symbol, state, true);
+  state.flush();
+}
+
+void SymbolViewer::rasterizeSymbolPart(const SymbolPart& part, RasterState& state, bool allow_overlap) {
+  if (const SymbolShape* s = part.isSymbolShape()) {
+    if (s->combine == SYMBOL_COMBINE_OVERLAP && state.filled && allow_overlap) {
+      // We will be overlapping some previous parts, combine them with the result
+      state.flush();
+    }
+    rasterizeSymbolShape(*s, state);
+    state.filled = true;
+  } else if (const SymbolSymmetry* s = part.isSymbolSymmetry()) {
+    // Draw all parts, in reverse order (bottom to top), also draw rotated copies
+    Matrix2D old_m = multiply;
+    Vector2D old_o = origin;
+    int copies = s->kind == SYMMETRY_REFLECTION ? s->copies / 2 * 2 : s->copies;
+    FOR_EACH_CONST_REVERSE(p, s->parts) {
+      for (int i = copies - 1 ; i >= 0 ; --i) {
+        setSymmetryCopy(*s, i, copies, old_m, old_o);
+        rasterizeSymbolPart(*p, state, allow_overlap && i == copies - 1);
+      }
+    }
+    multiply = old_m;
+    origin   = old_o;
+  } else if (const SymbolGroup* g = part.isSymbolGroup()) {
+    // Draw all parts, in reverse order (bottom to top)
+    FOR_EACH_CONST_REVERSE(p, g->parts) {
+      rasterizeSymbolPart(*p, state, allow_overlap);
+    }
+  }
+}
+
+void SymbolViewer::rasterizeSymbolShape(const SymbolShape& shape, RasterState& state) {
+  // create point list
+  vector<Vector2D> points;
+  size_t size = shape.points.size();
+  for(size_t i = 0 ; i < size ; ++i) {
+    segment_subdivide(*shape.getPoint((int)i), *shape.getPoint((int)i+1), origin, multiply, points);
+  }
+  // rasterize interior, and interior+border
+  bool has_border = border_radius > 0;
+  state.rasterizer.addPolygon(points);
+  state.rasterizer.render(state.fill, FILL_EVEN_ODD);
+  if (has_border) {
+    state.rasterizer.addStroke(points, rotation.trS(border_radius));
+    state.rasterizer.render(state.outline, FILL_NONZERO);
+  }
+  // combine
+  size_t n = state.fill.data.size();
+  if (n == 0) return; // empty image
+  const float* f = &state.fill.data[0];
+  const float* o = has_border ? &state.outline.data[0] : nullptr;
+  float* b = &state.buffer_border.data[0];
+  float* in = &state.buffer_interior.data[0];
+  switch(shape.combine) {
+    case SYMBOL_COMBINE_OVERLAP:
+    case SYMBOL_COMBINE_MERGE: {
+      for (size_t i = 0 ; i < n ; ++i) {
+        if (o) b[i] = max(b[i], max(o[i], f[i]));
+        in[i] = max(in[i], f[i]);
+      }
+      break;
+    } case SYMBOL_COMBINE_SUBTRACT: {
+      for (size_t i = 0 ; i < n ; ++i) {
+        if (o) b[i] = min(b[i], max(1 - f[i], o[i]));
+        in[i] = min(in[i], 1 - f[i]);
+      }
+      break;
+    } case SYMBOL_COMBINE_INTERSECTION: {
+      for (size_t i = 0 ; i < n ; ++i) {
+        b[i] = o ? min(b[i], max(o[i], f[i])) : 0;
+        in[i] = min(in[i], f[i]);
+      }
+      break;
+    } case SYMBOL_COMBINE_DIFFERENCE: {
+      for (size_t i = 0 ; i < n ; ++i) {
+        if (o) b[i] = min(max(b[i], o[i]), 1 - f[i]);
+        in[i] = fabs(in[i] - f[i]);
+      }
+      break;
+    } case SYMBOL_COMBINE_BORDER: {
+      // draw border as interior
+      for (size_t i = 0 ; i < n ; ++i) {
+        b[i] = max(b[i], f[i]);
+      }
+      break;
+    }
+  }
+}
+
 // ----------------------------------------------------------------------------- : Drawing : Highlighting
 
 void SymbolViewer::highlightPart(DC& dc, const SymbolPart& part, HighlightStyle style) {
@@ -14,11 +14,19 @@
 #include <data/symbol.hpp>
 #include <gfx/bezier.hpp>
 
+class CoverageBuffer;
+
 // ----------------------------------------------------------------------------- : Simple rendering
 
 /// Render a Symbol to an Image
 Image render_symbol(const SymbolP& symbol, double border_radius = 0.05, int width = 100, int height = 100, bool editing_hints = false, bool allow_smaller = false);
 
+/// Render a Symbol to anti aliased coverage buffers, without going through a DC
+/** Uses the same size and aspect ratio rules as render_symbol.
+ *  The buffers are resized to the final image size.
+ */
+void render_symbol(const SymbolP& symbol, CoverageBuffer& inside, CoverageBuffer& border, double border_radius = 0.05, int width = 100, int height = 100, bool allow_smaller = false);
+
 // ----------------------------------------------------------------------------- : Symbol Viewer
 
 enum HighlightStyle
@@ -59,6 +67,12 @@ class SymbolViewer : public SymbolView {
   
   void drawEditingHints(DC& dc);
   
+  /// Rasterize the symbol in software, storing how much of each pixel is inside and how much is border
+  /** The buffers must have the size of the image, they are overwritten.
+   *  Editing hints are never drawn.
+   */
+  void rasterize(CoverageBuffer& inside, CoverageBuffer& border);
+  
   void onAction(const Action&, bool) {}
   
   
@@ -82,6 +96,15 @@ class SymbolViewer : public SymbolView {
    *  default should be white (255) border and black (0) interior.
    */
   void drawSymbolShape(const SymbolShape& shape, DC* border, DC* interior, unsigned char borderCol, unsigned char interiorCol, bool directB, bool oppB);
+  
+  /// Set multiply and origin for drawing the i-th copy of a symmetry, relative to old_m and old_o
+  void setSymmetryCopy(const SymbolSymmetry& sym, int i, int copies, const Matrix2D& old_m, const Vector2D& old_o);
+  
+  struct RasterState;
+  /// Rasterize a symbol part, the software equivalent of combineSymbolPart
+  void rasterizeSymbolPart(const SymbolPart& part, RasterState& state, bool allow_overlap);
+  /// Combine a shape with the buffers in the state, the software equivalent of combineSymbolShape
+  void rasterizeSymbolShape(const SymbolShape& shape, RasterState& state);
 /*  
   // ------------------- Bezier curve calculation
   
@@ -122,6 +122,14 @@ class FontTextElement : public SimpleTextElement {
   FontP     font;
   DrawWhat  draw_as;
   LineBreak break_style;
+  /// Character info for each actual font and text that were used to measure this element
+  /** When a TextViewer tries different scales, many of them round to the same font size.
+   *  In debug builds every use of the cache is checked by measuring again.
+   */
+  mutable map<String,vector<CharInfo> > measured;
+  
+  /// Measure the characters with the font that is set on the dc
+  void measure(RotatedDC& dc, vector<CharInfo>& out) const;
 };
 
 /// A text element that uses a symbol font
@@ -24,9 +24,41 @@ void FontTextElement::draw(RotatedDC& dc, double scale, const RealRect& rect, co
   dc.DrawTextWithShadow(text, *font, rect.position());
 }
 
+#ifdef _DEBUG
+/// Are two measurements the same?
+bool same_char_info(const vector<CharInfo>& a, const vector<CharInfo>& b) {
+  if (a.size() != b.size()) return false;
+  for (size_t i = 0 ; i < a.size() ; ++i) {
+    if (a[i].size.width != b[i].size.width || a[i].size.height != b[i].size.height || a[i].break_after != b[i].break_after || a[i].soft != b[i].soft) return false;
+  }
+  return true;
+}
+#endif
+
 void FontTextElement::getCharInfo(RotatedDC& dc, double scale, vector<CharInfo>& out) const {
   // font
   dc.SetFont(*font, scale);
+  // measured this text with this font before? the font description includes the size
+  String key = String::Format(_("%s|%.6f|%.6f|%d|"), dc.GetFont().GetNativeFontInfoDesc().c_str(), dc.trX(1), dc.trY(1), dc.getQuality()) + content;
+  map<String,vector<CharInfo> >::const_iterator it = measured.find(key);
+  if (it != measured.end()) {
+    #ifdef _DEBUG
+      // everything that changes the measurements must change the key
+      vector<CharInfo> check;
+      measure(dc, check);
+      assert(same_char_info(check, it->second));
+    #endif
+    out.insert(out.end(), it->second.begin(), it->second.end());
+    return;
+  }
+  size_t first = out.size();
+  measure(dc, out);
+  // remember
+  if (measured.size() >= 8) measured.clear();
+  measured[key].assign(out.begin() + first, out.end());
+}
+
+void FontTextElement::measure(RotatedDC& dc, vector<CharInfo>& out) const {
   // find sizes & breaks
   double prev_width = 0;
   size_t line_start = start; // start of the current line
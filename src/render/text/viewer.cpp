@@ -8,6 +8,8 @@
 
 #include <util/prec.hpp>
 #include <render/text/viewer.hpp>
+#include <script/profiler.hpp>
+#include <wx/thread.h>
 #include <algorithm>
 
 DECLARE_TYPEOF_COLLECTION(TextViewer::Line);
@@ -65,6 +67,143 @@ size_t TextViewer::Line::posToIndex(double x) const {
   else                      return it2 - positions.begin() + start; // it2 is closer
 }
 
+// ----------------------------------------------------------------------------- : Layout cache
+
+// Finding the layout of text is expensive, every character has to be measured, often at several scales.
+// The layout only depends on the text, the style and the size of the box, so when the same text is
+// prepared again (switching back to a card, exporting it again) the lines from last time can be reused.
+
+/// Everything that influences the layout of text before it is aligned
+struct TextLayoutKey {
+  String         text;
+  vector<String> names;       ///< Font names
+  vector<double> params;      ///< Numeric properties of the style, fonts and dc
+  const void*    symbol_font; ///< The loaded symbol font
+  
+  bool operator < (const TextLayoutKey& k) const {
+    if (params      != k.params)      return params < k.params;
+    if (symbol_font != k.symbol_font) return less<const void*>()(symbol_font, k.symbol_font);
+    if (names       != k.names)       return names  < k.names;
+    return text < k.text;
+  }
+};
+
+/// A layout of text before it is aligned
+struct TextLayout {
+  vector<TextViewer::Line> lines;
+  vector<CharInfo>         chars;
+  double                   scale;
+  UInt                     last_use; ///< Time of last use, for eviction
+};
+
+/// Cache of text layouts, shared by all TextViewers
+class TextLayoutCache {
+  public:
+  TextLayoutCache() : time(0) {}
+  
+  /// Find a layout in the cache, returns false if it is not there
+  bool find(const TextLayoutKey& key, vector<TextViewer::Line>& lines, vector<CharInfo>& chars, double& scale);
+  /// Add a layout to the cache
+  void store(const TextLayoutKey& key, const vector<TextViewer::Line>& lines, const vector<CharInfo>& chars, double scale);
+  
+  private:
+  typedef map<TextLayoutKey,TextLayout> Layouts;
+  wxMutex lock;
+  Layouts layouts;
+  UInt    time;
+  
+  /// Remove the least recently used half of the layouts, must hold the lock
+  void evict();
+};
+
+/// Maximum number of layouts to keep
+const size_t text_layout_cache_max_size = 2000;
+
+TextLayoutCache text_layout_cache;
+
+bool TextLayoutCache::find(const TextLayoutKey& key, vector<TextViewer::Line>& lines, vector<CharInfo>& chars, double& scale) {
+  wxMutexLocker locker(lock);
+  Layouts::iterator it = layouts.find(key);
+  if (it == layouts.end()) return false;
+  TextLayout& layout = it->second;
+  layout.last_use = ++time;
+  lines = layout.lines;
+  chars = layout.chars;
+  scale = layout.scale;
+  return true;
+}
+
+void TextLayoutCache::store(const TextLayoutKey& key, const vector<TextViewer::Line>& lines, const vector<CharInfo>& chars, double scale) {
+  wxMutexLocker locker(lock);
+  if (layouts.size() >= text_layout_cache_max_size) evict();
+  TextLayout& layout = layouts[key];
+  layout.lines    = lines;
+  layout.chars    = chars;
+  layout.scale    = scale;
+  layout.last_use = ++time;
+}
+
+void TextLayoutCache::evict() {
+  // find the median age
+  vector<UInt> uses;
+  uses.reserve(layouts.size());
+  FOR_EACH(l, layouts) uses.push_back(l.second.last_use);
+  if (uses.empty()) return;
+  nth_element(uses.begin(), uses.begin() + uses.size() / 2, uses.end());
+  UInt cutoff = uses[uses.size() / 2];
+  // remove older layouts
+  for (Layouts::iterator it = layouts.begin() ; it != layouts.end() ; ) {
+    if (it->second.last_use <= cutoff) layouts.erase(it++);
+    else                               ++it;
+  }
+}
+
+void add_font_key(const Font& font, TextLayoutKey& key) {
+  key.names.push_back(font.name());
+  key.names.push_back(font.italic_name());
+  key.params.push_back(font.size());
+  key.params.push_back(font.scale_down_to);
+  key.params.push_back(font.flags);
+  key.params.push_back(font.underline());
+}
+
+/// Determine the key for the layout of text, returns false if the layout can not be cached
+/** scale is the scale the layout search starts at */
+bool make_layout_key(RotatedDC& dc, const String& text, const TextStyle& style, double scale, TextLayoutKey& key) {
+  // contour masks are not part of the key
+  if (style.mask.getFromCache().isLoaded()) return false;
+  key.text = text;
+  // box
+  key.params.push_back(dc.getInternalSize().width);
+  key.params.push_back(dc.getInternalSize().height);
+  key.params.push_back(dc.getZoom());
+  key.params.push_back(dc.getStretch());
+  key.params.push_back(dc.getQuality());
+  key.params.push_back(scale);
+  // style
+  key.params.push_back(style.width);
+  key.params.push_back(style.height);
+  key.params.push_back(style.padding_left);
+  key.params.push_back(style.padding_right);
+  key.params.push_back(style.padding_top);
+  key.params.push_back(style.padding_bottom);
+  key.params.push_back(style.line_height_soft);
+  key.params.push_back(style.line_height_hard);
+  key.params.push_back(style.line_height_line);
+  key.params.push_back(style.paragraph_height);
+  key.params.push_back(style.direction);
+  key.params.push_back(style.field().multi_line);
+  key.params.push_back(style.always_symbol);
+  key.params.push_back(style.allow_formating);
+  // fonts
+  add_font_key(style.font, key);
+  key.names.push_back(style.symbol_font.name());
+  key.params.push_back(style.symbol_font.size());
+  key.params.push_back(style.symbol_font.scale_down_to);
+  key.symbol_font = style.symbol_font.font.get();
+  return true;
+}
+
 // ----------------------------------------------------------------------------- : TextViewer
 
 // can't be declared in header because we need to know sizeof(Line)
@@ -349,7 +488,16 @@ void TextViewer::prepareElements(const String& text, const TextStyle& style, Con
 
 void TextViewer::prepareLines(RotatedDC& dc, const String& text, TextStyle& style, Context& ctx) {
   vector<CharInfo> chars;
-  prepareLinesTryScales(dc, text, style, chars);
+  TextLayoutKey key;
+  bool cacheable = make_layout_key(dc, text, style, scale, key);
+  if (cacheable && text_layout_cache.find(key, lines, chars, scale)) {
+    // the number of calls shows the cache hits
+    PROFILER(_("text layout (cached)"));
+  } else {
+    PROFILER(_("text layout"));
+    prepareLinesTryScales(dc, text, style, chars);
+    if (cacheable) text_layout_cache.store(key, lines, chars, scale);
+  }
   assert(!lines.empty());
   
   // store information about the content/layout, allow this to change alignment
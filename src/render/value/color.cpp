@@ -51,18 +51,16 @@ void ColorValueViewer::draw(RotatedDC& dc) {
       bool clip = style().left_width < style().width  && style().right_width  < style().width &&
             style().top_width  < style().height && style().bottom_width < style().height;
       if (clip) {
-        // clip away the inside of the rectangle
-        wxRegion r = dc.trRectToRegion(style().getInternalRect());
-        r.Subtract(dc.trRectToRegion(RealRect(
+        // leave out the inside of the rectangle
+        dc.DrawRoundedRectangleFrame(style().getInternalRect(), RealRect(
           style().left_width,
           style().top_width,
           style().width  - style().left_width - style().right_width,
           style().height - style().top_width  - style().bottom_width
-        )));
-        dc.getDC().SetClippingRegion(r);
+        ), style().radius);
+      } else {
+        dc.DrawRoundedRectangle(style().getInternalRect(), style().radius);
       }
-      dc.DrawRoundedRectangle(style().getInternalRect(), style().radius);
-      if (clip) dc.getDC().DestroyClippingRegion();
     }
     drawFieldBorder(dc);
   }
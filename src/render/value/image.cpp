@@ -10,6 +10,7 @@
 #include <render/value/image.hpp>
 #include <render/card/viewer.hpp>
 #include <gui/util.hpp>
+#include <gfx/image_pool.hpp>
 
 // ----------------------------------------------------------------------------- : ImageValueViewer
 
@@ -32,8 +33,7 @@ void ImageValueViewer::draw(RotatedDC& dc) {
     // load from file
     if (!value().filename.empty()) {
       try {
-        InputStreamP image_file = getLocalPackage().openIn(value().filename);
-        if (image_load_file(image, *image_file)) {
+        if (image_pool.load(image, getLocalPackage(), value().filename, w, h)) {
           image.Rescale(w, h);
         }
       } CATCH_ALL_ERRORS(false);
@@ -53,8 +53,7 @@ void MultipleChoiceValueViewer::draw(RotatedDC& dc) {
 void MultipleChoiceValueViewer::drawChoice(RotatedDC& dc, RealPoint& pos, const String& choice, bool active) {
   RealSize size; size.height = item_height;
   if (style().render_style & RENDER_CHECKLIST) {
-    wxRect rect = dc.trRectToBB(RealRect(pos + RealSize(1,1), RealSize(12,12)));
-    draw_checkbox(nullptr, dc.getDC(), rect, active); // TODO
+    dc.DrawCheckbox(RealRect(pos + RealSize(1,1), RealSize(12,12)), active);
     size = add_horizontal(size, RealSize(14,16));
   }
   if (style().render_style & RENDER_IMAGE) {
@@ -11,7 +11,7 @@
 #include <util/io/package_manager.hpp>
 #include <gui/util.hpp>
 
-DECLARE_TYPEOF_COLLECTION(PackagedP);
+DECLARE_TYPEOF_COLLECTION(PackageHeaderP);
 DECLARE_TYPEOF_COLLECTION(PackageChoiceValueViewer::Item);
 
 // ----------------------------------------------------------------------------- : PackageChoiceValueViewer
@@ -19,7 +19,7 @@ DECLARE_TYPEOF_COLLECTION(PackageChoiceValueViewer::Item);
 IMPLEMENT_VALUE_VIEWER(PackageChoice);
 
 struct PackageChoiceValueViewer::ComparePackagePosHint {
-  bool operator () (const PackagedP& a, const PackagedP& b) {
+  bool operator () (const PackageHeaderP& a, const PackageHeaderP& b) {
     // use position_hints to determine order
     if (a->position_hint < b->position_hint) return true;
     if (a->position_hint > b->position_hint) return false;
@@ -29,7 +29,7 @@ struct PackageChoiceValueViewer::ComparePackagePosHint {
 };
 
 void PackageChoiceValueViewer::initItems() {
-  vector<PackagedP> choices;
+  vector<PackageHeaderP> choices;
   package_manager.findMatching(field().match, choices);
   sort(choices.begin(), choices.end(), ComparePackagePosHint());
   FOR_EACH(p, choices) {
@@ -16,6 +16,7 @@ DECLARE_TYPEOF_COLLECTION(wxPoint);
 
 ValueViewer::ValueViewer(DataViewer& parent, const StyleP& style)
   : StyleListener(style), viewer(parent)
+  , drawn_box(0,0,0,0)
 {}
 
 Package& ValueViewer::getStylePackage() const { return viewer.getStylePackage(); }
@@ -60,7 +61,7 @@ void ValueViewer::drawFieldBorder(RotatedDC& dc) {
       alpha_mask.convexHull(points);
       if (points.size() < 3) return;
       FOR_EACH(p, points) p = dc.trPixelNoZoom(RealPoint(p.x,p.y));
-      dc.getDC().DrawPolygon((int)points.size(), &points[0]);
+      dc.DrawPreRotatedPolygon(points);
     } else {
       // simple rectangle
       dc.DrawRectangle(dc.getInternalRect().grow(dc.trInvS(1)));
@@ -51,6 +51,9 @@ class ValueViewer : public StyleListener {
   virtual bool containsPoint(const RealPoint& p) const;
   /// Get a bounding rectangle for this field (including any border it may have)
   virtual RealRect boundingBox() const;
+  /// The bounding box at the time this viewer was last drawn
+  /** When the viewer moves or changes size, both this area and the new bounding box must be redrawn */
+  RealRect drawn_box;
   
   /// Rotation to use for drawing this field
   virtual Rotation getRotation() const;
@@ -200,7 +200,7 @@ String symbols_to_html(const String& str, SymbolFont& symbol_font, double size)
       wxFileName fn;
       fn.SetPath(ei.directory_absolute);
       fn.SetFullName(filename);
-      img.SaveFile(fn.GetFullPath());
+      save_image(img, fn.GetFullPath(), export_compression);
       it = ei.exported_images.insert(make_pair(filename, wxSize(img.GetWidth(), img.GetHeight()))).first;
     }
     html += _("<img src='") + filename + _("' alt='") + html_escape(sym.text)
@@ -420,13 +420,13 @@ SCRIPT_FUNCTION(write_image_file) {
   Image image;
   GeneratedImage::Options options(width, height, ei.export_template.get(), ei.set.get());
   if (card) {
-    image = conform_image(export_bitmap(ei.set, card->getValue()).ConvertToImage(), options);
+    image = conform_image(export_card_image(ei.set, card->getValue()), options);
   } else {
     image = image_from_script(input)->generateConform(options);
   }
   if (!image.Ok()) throw Error(_("Unable to generate image for file ") + file);
   // write
-  image.SaveFile(out_path);
+  save_image(image, out_path, export_compression);
   ei.exported_images.insert(make_pair(file, wxSize(image.GetWidth(), image.GetHeight())));
   SCRIPT_RETURN(file);
 }
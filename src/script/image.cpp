@@ -32,7 +32,7 @@ Image ScriptableImage::generate(const GeneratedImage::Options& options) const {
     //       We could return a blank one, but the thumbnail code does want an invalid
     //       image in case of errors.
     //       This allows the caller to catch errors.
-    image = value->generate(options);
+    image = value->generateReduced(options); // it is conformed below
   } else {
     // error, return blank image
     Image i(1,1);
@@ -67,6 +67,36 @@ ScriptP ScriptableImage::getValidScriptP() {
   return s;
 }
 
+void ScriptableImage::getReferencedFiles(vector<String>& out) const {
+  const String& code = script.getUnparsed();
+  if (!isScripted()) {
+    if (!code.empty()) out.push_back(code); // a filename
+    return;
+  }
+  // string constants in the script, skipping the parts in {}
+  for (size_t i = 0 ; i < code.size() ; ++i) {
+    if (code.GetChar(i) != _('"')) continue;
+    String str;
+    bool constant = true;
+    for (++i ; i < code.size() && code.GetChar(i) != _('"') ; ++i) {
+      Char c = code.GetChar(i);
+      if (c == _('\\') && i + 1 < code.size()) {
+        str += code.GetChar(++i);
+      } else if (c == _('{')) {
+        constant = false;
+        for (int depth = 1 ; depth > 0 && i + 1 < code.size() ; ) {
+          c = code.GetChar(++i);
+          if      (c == _('{')) ++depth;
+          else if (c == _('}')) --depth;
+        }
+      } else {
+        str += c;
+      }
+    }
+    if (constant && !str.empty()) out.push_back(str);
+  }
+}
+
 // ----------------------------------------------------------------------------- : Reflection
 
 // we need some custom io, because the behaviour is different for each of Reader/Writer/GetMember
@@ -194,9 +224,12 @@ template <> void GetDefaultMember::handle(const CachedScriptableImage& s) {
 // ----------------------------------------------------------------------------- : CachedScriptableMask
 
 
+/// Number of mask sizes to keep per style
+const size_t max_cached_masks = 4;
+
 bool CachedScriptableMask::update(Context& ctx) {
   if (script.update(ctx)) {
-    mask.clear();
+    masks.clear();
     return true;
   } else {
     return false;
@@ -204,14 +237,29 @@ bool CachedScriptableMask::update(Context& ctx) {
 }
 
 const AlphaMask& CachedScriptableMask::get(const GeneratedImage::Options& img_options) {
-  if (mask.isLoaded()) {
-    // already loaded?
-    if (img_options.width == 0 && img_options.height == 0) return mask;
-    if (mask.hasSize(wxSize(img_options.width,img_options.height))) return mask;
+  // already loaded?
+  if (!masks.empty() && img_options.width == 0 && img_options.height == 0) return *masks.front();
+  wxSize size(img_options.width, img_options.height);
+  for (size_t i = 0 ; i < masks.size() ; ++i) {
+    if (masks[i]->isLoaded() && masks[i]->hasSize(size)) {
+      // move to front
+      AlphaMaskP mask = masks[i];
+      masks.erase(masks.begin() + i);
+      masks.insert(masks.begin(), mask);
+      return *mask;
+    }
   }
-  // load?
-  getNoCache(img_options,mask);
-  return mask;
+  // load
+  AlphaMaskP mask = intrusive(new AlphaMask);
+  getNoCache(img_options, *mask);
+  masks.insert(masks.begin(), mask);
+  if (masks.size() > max_cached_masks) masks.resize(max_cached_masks);
+  return *mask;
+}
+
+const AlphaMask& CachedScriptableMask::getFromCache() const {
+  static AlphaMask empty;
+  return masks.empty() ? empty : *masks.front();
 }
 void CachedScriptableMask::getNoCache(const GeneratedImage::Options& img_options, AlphaMask& other_mask) const {
   if (script.isBlank()) {
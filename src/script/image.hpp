@@ -61,6 +61,10 @@ class ScriptableImage {
   /// Get access to the script, always returns a valid script
   ScriptP getValidScriptP();
   
+  /// Add the filenames of the images this could use, as far as that is known without running the script
+  /** For a script these are the string constants in it, some of which might not be filenames. */
+  void getReferencedFiles(vector<String>& out) const;
+  
   protected:
   OptionalScript  script;    ///< The script, not really optional
   GeneratedImageP value;    ///< The image generator
@@ -122,8 +126,9 @@ class CachedScriptableMask {
   }
   
   /// Get the alpha mask; with the given options
-  /** if img_options.width == 0 and the mask is already loaded, just returns it.
-   *  Returns a reference, so calling again might change earlier results.
+  /** if img_options.width == 0 and the mask is already loaded, just returns the most recently used one.
+   *  Masks for the last few sizes are kept, so viewers of different sizes don't reload each other's mask.
+   *  Returns a reference, so calling again might invalidate earlier results.
    */
   const AlphaMask& get(const GeneratedImage::Options& img_options);
   
@@ -132,11 +137,16 @@ class CachedScriptableMask {
   
   /// Get the mask directly from the cache, without updating
   /** Should only be used after get() was called before, otherwise an old mask might be returned */
-  inline const AlphaMask& getFromCache() const { return mask; }
+  const AlphaMask& getFromCache() const;
+  
+  /// Add the filenames of the images this could use, see ScriptableImage::getReferencedFiles
+  inline void getReferencedFiles(vector<String>& out) const {
+    script.getReferencedFiles(out);
+  }
   
   private:
-  ScriptableImage script;
-  AlphaMask       mask;
+  ScriptableImage   script;
+  vector<AlphaMaskP> masks; ///< Loaded masks of different sizes, most recently used first
   friend class Reader;
   friend class Writer;
   friend class GetDefaultMember;
@@ -8,6 +8,7 @@
 
 #include <util/prec.hpp>
 #include <script/profiler.hpp>
+#include <wx/thread.h>
 
 #if USE_SCRIPT_PROFILING
 
@@ -92,8 +93,9 @@ FunctionProfile* Profiler::function = &profile_root;
 // Enter a function
 Profiler::Profiler(Timer& timer, Variable function_name)
   : timer(timer)
-  , parent(function) // push
+  , parent(wxThread::IsMain() ? function : nullptr) // push
 {
+  if (!parent) return; // the profile is only kept for the main thread
   if ((int)function_name >= 0) {
     FunctionProfileP& fpp = parent->children[(size_t)function_name << 1 | 1];
     if (!fpp) {
@@ -107,8 +109,9 @@ Profiler::Profiler(Timer& timer, Variable function_name)
 // Enter a function
 Profiler::Profiler(Timer& timer, const Char* function_name)
   : timer(timer)
-  , parent(function) // push
+  , parent(wxThread::IsMain() ? function : nullptr) // push
 {
+  if (!parent) return; // the profile is only kept for the main thread
   FunctionProfileP& fpp = parent->children[(size_t)function_name];
   if (!fpp) {
     fpp = intrusive(new FunctionProfile(function_name));
@@ -120,8 +123,9 @@ Profiler::Profiler(Timer& timer, const Char* function_name)
 // Enter a function
 Profiler::Profiler(Timer& timer, void* function_object, const String& function_name)
   : timer(timer)
-  , parent(function) // push
+  , parent(wxThread::IsMain() ? function : nullptr) // push
 {
+  if (!parent) return; // the profile is only kept for the main thread
   FunctionProfileP& fpp = parent->children[(size_t)function_object];
   if (!fpp) {
     fpp = intrusive(new FunctionProfile(function_name));
@@ -133,7 +137,7 @@ Profiler::Profiler(Timer& timer, void* function_object, const String& function_n
 // Leave a function
 Profiler::~Profiler() {
   ProfileTime time = timer.time();
-  if (function == parent) return; // don't count
+  if (!parent || function == parent) return; // don't count
   function->time_ticks += time;
   function->time_ticks_max = max(function->time_ticks_max,time);
   function->calls      += 1;
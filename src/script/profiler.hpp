@@ -121,8 +121,8 @@ class Profiler {
   ~Profiler();
   private:
   Timer&                  timer;
-  static FunctionProfile* function; ///< function we are in
-  FunctionProfile*        parent;
+  static FunctionProfile* function; ///< function we are in, on the main thread
+  FunctionProfile*        parent;   ///< nullptr when not on the main thread, then nothing is counted
 };
 
 // Profile the current function (all following code in the current block) under the given name
@@ -11,18 +11,21 @@
 #include <script/context.hpp>
 #include <script/to_value.hpp>
 #include <util/error.hpp>
+#include <wx/thread.h>
 
 // ----------------------------------------------------------------------------- : Variables
 
 typedef map<String, Variable> Variables;
 Variables variables;
 DECLARE_TYPEOF(Variables);
+wxMutex variables_mutex; ///< Scripts can be parsed on multiple threads, for example when packages are prefetched
 #ifdef _DEBUG
   vector<String> variable_names;
 #endif
 
 /// Return a unique name for a variable to allow for faster loopups
 Variable string_to_variable(const String& s) {
+  wxMutexLocker lock(variables_mutex);
   Variables::iterator it = variables.find(s);
   if (it == variables.end()) {
     #ifdef _DEBUG
@@ -41,6 +44,7 @@ Variable string_to_variable(const String& s) {
 /** Warning: this function is slow, it should only be used for error messages and such.
  */
 String variable_to_string(Variable v) {
+  wxMutexLocker lock(variables_mutex);
   FOR_EACH(vi, variables) {
     if (vi.second == v) return replace_all(vi.first, _(" "), _("_"));
   }
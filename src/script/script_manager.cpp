@@ -88,6 +88,9 @@ Context& SetScriptContext::getContext(const CardP& card) {
 
 // ----------------------------------------------------------------------------- : SetScriptManager : initialization
 
+/// Sets with at least this many cards update their cards when they are needed, instead of when the set is opened
+const size_t min_cards_for_delayed_update = 2000;
+
 SetScriptManager::SetScriptManager(Set& set)
   : SetScriptContext(set)
   , delay(0)
@@ -231,6 +234,7 @@ void SetScriptManager::onAction(const Action& action, bool undone) {
 
 void SetScriptManager::updateStyles(const CardP& card, bool only_content_dependent) {
   assert(card);
+  updateIfDelayed(card);
   const StyleSheet& stylesheet = set.stylesheetFor(card);
   Context& ctx = getContext(card);
   if (!only_content_dependent) {
@@ -264,10 +268,17 @@ void SetScriptManager::updateStyles(Context& ctx, const IndexMap<FieldP,StyleP>&
 }
 
 void SetScriptManager::updateDelayed() {
+  if (delay & DELAY_CARDS) {
+    updateSomeDelayed(-1);
+  }
+  updateDelayedKeywords();
+}
+
+void SetScriptManager::updateDelayedKeywords() {
   if (delay & DELAY_KEYWORDS) {
     updateAllDependend(set.game->dependent_scripts_keywords);
   }
-  delay = 0;
+  delay &= ~DELAY_KEYWORDS;
 }
 
 void SetScriptManager::updateValue(Value& value, const CardP& card) {
@@ -302,19 +313,21 @@ void SetScriptManager::updateAll() {
     }
   }
   // update card data of all cards
-  FOR_EACH(card, set.cards) {
-    Context& ctx = getContext(card);
-    FOR_EACH(v, card->data) {
-      try {
-        #if USE_SCRIPT_PROFILING
-          Timer t;
-          Profiler prof(t, v->fieldP.get(), _("update card.") + v->fieldP->name);
-        #endif
-        v->update(ctx);
-      } catch (const ScriptError& e) {
-        handle_error(ScriptError(e.what() + _("\n  while updating card value '") + v->fieldP->name + _("'")));
-      }
+  delay &= ~DELAY_CARDS;
+  delayed_cards.clear();
+  delayed_card_set.clear();
+  if (set.cards.size() >= min_cards_for_delayed_update) {
+    // the values from the file are used until the cards are updated,
+    // by updateStyles when they are shown, or in the background by updateSomeDelayed
+    delay |= DELAY_CARDS;
+    delayed_cards.assign(set.cards.begin(), set.cards.end());
+    FOR_EACH(card, set.cards) {
+      delayed_card_set.insert(card.get());
     }
+    return;
+  }
+  FOR_EACH(card, set.cards) {
+    updateCard(card, false);
   }
   // update things that depend on the card list
   updateAllDependend(set.game->dependent_scripts_cards);
@@ -323,6 +336,50 @@ void SetScriptManager::updateAll() {
   #endif
 }
 
+void SetScriptManager::updateCard(const CardP& card, bool send_events) {
+  Context& ctx = getContext(card);
+  FOR_EACH(v, card->data) {
+    try {
+      #if USE_SCRIPT_PROFILING
+        Timer t;
+        Profiler prof(t, v->fieldP.get(), _("update card.") + v->fieldP->name);
+      #endif
+      if (v->update(ctx) && send_events) {
+        // changed, send event
+        ScriptValueEvent change(card.get(), v.get());
+        set.actions.tellListeners(change, false);
+      }
+    } catch (const ScriptError& e) {
+      handle_error(ScriptError(e.what() + _("\n  while updating card value '") + v->fieldP->name + _("'")));
+    }
+  }
+}
+
+void SetScriptManager::updateIfDelayed(const CardP& card) {
+  if (!delayed_card_set.empty() && delayed_card_set.erase(card.get())) {
+    // NOTE: don't send events, we are likely in an onPaint handler
+    updateCard(card, false);
+  }
+}
+
+bool SetScriptManager::updateSomeDelayed(long max_time) {
+  if (!(delay & DELAY_CARDS)) return false;
+  wxStopWatch timer;
+  while (!delayed_cards.empty() && (max_time < 0 || timer.Time() < max_time)) {
+    CardP card = delayed_cards.front();
+    delayed_cards.pop_front();
+    if (delayed_card_set.erase(card.get())) {
+      updateCard(card, true);
+    }
+  }
+  if (!delayed_cards.empty()) return true;
+  // all cards are done, update things that depend on the card list
+  delay &= ~DELAY_CARDS;
+  delayed_card_set.clear();
+  updateAllDependend(set.game->dependent_scripts_cards);
+  return false;
+}
+
 void SetScriptManager::updateAllDependend(const vector<Dependency>& dependent_scripts, const CardP& card) {
   deque<ToUpdate> to_update;
   Age starting_age;
@@ -65,10 +65,16 @@ class SetScriptManager : public SetScriptContext, public ActionListener {
   
   /// Update expensive things that were previously delayed
   void updateDelayed();
+  /// Update only the scripts that depend on keywords, leave delayed cards for later
+  void updateDelayedKeywords();
+  /// Update some of the cards whose update was delayed by updateAll, for at most max_time milliseconds
+  /** Returns true if there are more cards to update */
+  bool updateSomeDelayed(long max_time);
   
   /// Update all fields of all cards
   /** Update all set info fields
    *  Doesn't update styles
+   *  For large sets the cards are updated when they are first shown, or by updateSomeDelayed.
    */
   void updateAll();
   
@@ -80,6 +86,11 @@ class SetScriptManager : public SetScriptContext, public ActionListener {
   
   /// Update a map of styles
   void updateStyles(Context& ctx, const IndexMap<FieldP,StyleP>& styles, bool only_content_dependent);
+  /// Update all values of a card, optionally telling listeners about changes
+  void updateCard(const CardP& card, bool send_events);
+  /// Update a card now if its update was delayed
+  void updateIfDelayed(const CardP& card);
+  
   /// Updates scripts, starting at some value
   /** if the value changes any dependend values are updated as well */
   void updateValue(Value& value, const CardP& card);
@@ -106,6 +117,10 @@ class SetScriptManager : public SetScriptContext, public ActionListener {
   ,  DELAY_CARDS    = 0x02
   };
   int delay;
+  /// Cards that have not been updated since updateAll, for DELAY_CARDS
+  deque<CardP> delayed_cards;
+  /// The cards in delayed_cards that still need an update
+  std::set<const Card*> delayed_card_set;
   
   protected:
   /// Respond to actions by updating scripts
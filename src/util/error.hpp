@@ -18,6 +18,13 @@
 
 // ----------------------------------------------------------------------------- : Error types
 
+DECLARE_SHARED_POINTER_TYPE(Error);
+
+/// Implement Error::clone and Error::rethrow in an error class
+#define DECLARE_ERROR_TYPE(Type)                                 \
+  virtual Error* clone() const { return new Type(*this); }       \
+  virtual void rethrow() const { throw *this; }
+
 /// Our own exception class
 class Error {
   public:
@@ -29,6 +36,10 @@ class Error {
   /// Is the message (potentially) fatal?
   virtual bool is_fatal() const { return false; }
   
+  /// Make a copy of this error, for passing it to another thread
+  /** Every subclass should use DECLARE_ERROR_TYPE, so the copy has the same type */
+  DECLARE_ERROR_TYPE(Error);
+  
   protected:
   String message; ///< The error message
 };
@@ -40,6 +51,7 @@ class InternalError : public Error {
   InternalError(const String& str);
   // not all internal errors are fatal, but we had still better warn the user about them.
   virtual bool is_fatal() const { return true; }
+  DECLARE_ERROR_TYPE(InternalError);
 };
 
 // ----------------------------------------------------------------------------- : File errors
@@ -48,12 +60,14 @@ class InternalError : public Error {
 class PackageError : public Error {
   public:
   inline PackageError(const String& str) : Error(str) {}
+  DECLARE_ERROR_TYPE(PackageError);
 };
 
 /// A package is not found
 class PackageNotFoundError : public PackageError {
   public:
   inline PackageNotFoundError(const String& str) : PackageError(str) {}
+  DECLARE_ERROR_TYPE(PackageNotFoundError);
 };
 
 /// A file is not found
@@ -62,6 +76,7 @@ class FileNotFoundError : public PackageError {
   inline FileNotFoundError(const String& file, const String& package)
     : PackageError(_ERROR_2_("file not found", file, package))
   {}
+  DECLARE_ERROR_TYPE(FileNotFoundError);
 };
 
 // ----------------------------------------------------------------------------- : Parse errors
@@ -70,6 +85,7 @@ class FileNotFoundError : public PackageError {
 class ParseError : public Error {
   public:
   inline ParseError(const String& str) : Error(str) {}
+  DECLARE_ERROR_TYPE(ParseError);
 };
 
 /// Parse error in a particular file
@@ -78,6 +94,7 @@ class FileParseError : public ParseError {
   inline FileParseError(const String& err, const String& file) :
     ParseError(_ERROR_2_("file parse error", file, err))
   {}
+  DECLARE_ERROR_TYPE(FileParseError);
 };
 
 /// Parse error in a script
@@ -94,12 +111,14 @@ class ScriptParseError : public ParseError {
   String filename;
   /// Return the error message
   virtual String what() const; 
+  DECLARE_ERROR_TYPE(ScriptParseError);
 };
 
 /// Multiple parse errors in a script
 class ScriptParseErrors : public ParseError {
   public:
   ScriptParseErrors(const vector<ScriptParseError>& errors);
+  DECLARE_ERROR_TYPE(ScriptParseErrors);
 };
 
 // ----------------------------------------------------------------------------- : Script errors
@@ -108,12 +127,14 @@ class ScriptParseErrors : public ParseError {
 class ScriptError : public Error {
   public:
   inline ScriptError(const String& str) : Error(str) {}
+  DECLARE_ERROR_TYPE(ScriptError);
 };
 
 /// "Variable not set"
 class ScriptErrorNoVariable : public ScriptError {
   public:
   inline ScriptErrorNoVariable(const String& var) : ScriptError(_("Variable not set: ") + var) {}
+  DECLARE_ERROR_TYPE(ScriptErrorNoVariable);
 };
 
 /// "Can't convert from A to B"
@@ -123,6 +144,7 @@ class ScriptErrorConversion : public ScriptError {
     : ScriptError(_ERROR_2_("can't convert", a, b)) {}
   inline ScriptErrorConversion(const String& value, const String& a, const String& b)
     : ScriptError(_ERROR_3_("can't convert value", value, a, b)) {}
+  DECLARE_ERROR_TYPE(ScriptErrorConversion);
 };
 
 /// "A has no member B"
@@ -130,6 +152,7 @@ class ScriptErrorNoMember : public ScriptError {
   public:
   inline ScriptErrorNoMember(const String& type, const String& member)
     : ScriptError(_ERROR_2_("has no member", type, member)) {}
+  DECLARE_ERROR_TYPE(ScriptErrorNoMember);
 };
 
 // ----------------------------------------------------------------------------- : Error/message handling
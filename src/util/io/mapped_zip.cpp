@@ -0,0 +1,227 @@
+//+----------------------------------------------------------------------------+
+//| Description:  Magic Set Editor - Program to make Magic (tm) cards          |
+//| Copyright:    (C) 2001 - 2017 Twan van Laarhoven and Sean Hunt             |
+//| License:      GNU General Public License 2 or later (see file COPYING)     |
+//+----------------------------------------------------------------------------+
+
+// ----------------------------------------------------------------------------- : Includes
+
+#include <util/prec.hpp>
+#include <util/io/mapped_zip.hpp>
+#include <util/io/package.hpp> // for update_crc32
+#include <wx/mstream.h>
+#include <wx/zstream.h>
+#include <wx/file.h>
+#if defined(__WXMSW__)
+  #include <wx/msw/wrapwin.h>
+#else
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <fcntl.h>
+  #include <unistd.h>
+#endif
+
+// ----------------------------------------------------------------------------- : MappedZipInputStream
+
+class MappedZipInputStream_aux {
+  protected:
+  MappedZipP  zip;      ///< The zip file, keeps the mapping alive as long as the stream
+  std::string inflated; ///< Contents of an entry that is not read from the mapping
+  inline MappedZipInputStream_aux(const MappedZipP& zip) : zip(zip) {}
+  inline MappedZipInputStream_aux(const MappedZipP& zip, std::string& data) : zip(zip) {
+    inflated.swap(data);
+  }
+};
+/// A stream for reading an entry of a MappedZip
+/** Stored entries are read directly from the mapping, deflated entries (and all entries of a zip file
+ *  that is not mapped) from a buffer owned by the stream.
+ *  Unlike wxZipInputStream, these streams can seek, and they don't share any state.
+ */
+class MappedZipInputStream : private MappedZipInputStream_aux, public wxMemoryInputStream {
+  public:
+  inline MappedZipInputStream(const MappedZipP& zip, const char* data, size_t size)
+    : MappedZipInputStream_aux(zip)
+    , wxMemoryInputStream(data, size)
+  {}
+  inline MappedZipInputStream(const MappedZipP& zip, std::string& data)
+    : MappedZipInputStream_aux(zip, data)
+    , wxMemoryInputStream(inflated.data(), inflated.size())
+  {}
+};
+
+// ----------------------------------------------------------------------------- : MappedZip
+
+DateTime MappedZip::Entry::getDateTime() const {
+  DateTime time;
+  time.SetFromDOS(dos_time);
+  return time;
+}
+
+MappedZip::MappedZip()
+  : data(nullptr), size(0)
+{}
+
+MappedZip::~MappedZip() {
+  unmapFile();
+}
+
+bool MappedZip::open(const String& filename) {
+  unmapFile();
+  entries.clear();
+  this->filename = filename;
+  if (!mapFile(filename)) {
+    // mapping is not possible, read the entries from the file when they are opened
+    wxFile file(filename);
+    if (!file.IsOpened()) return false;
+    wxFileOffset length = file.Length();
+    if (length <= 0 || length >= 0xFFFFFFFF) return false;
+    size = (size_t)length;
+  }
+  return readDirectory();
+}
+
+InputStreamP MappedZip::openIn(const Entry& entry) {
+  wxFile file;
+  if (!data && !file.Open(filename)) return InputStreamP();
+  // the data comes after the local header
+  std::string header_buffer, buffer;
+  const char* header = readRange(file, entry.offset, 30, header_buffer);
+  if (!header || get_u32(header) != zip_local_header_signature) return InputStreamP();
+  size_t start = entry.offset + 30 + get_u16(header + 26) + get_u16(header + 28);
+  const char* entry_data = readRange(file, start, entry.compressed_size, buffer);
+  if (!entry_data) return InputStreamP();
+  if (entry.method == 0 && entry.compressed_size == entry.size) {
+    // stored, read it in place, or give the buffer to the stream
+    if (data) return shared(new MappedZipInputStream(MappedZipP(this), entry_data, entry.size));
+    else      return shared(new MappedZipInputStream(MappedZipP(this), buffer));
+  } else if (entry.method == 8) {
+    // deflated, inflate all of it at once
+    std::string inflated(entry.size, '\0');
+    if (entry.size > 0) {
+      wxMemoryInputStream compressed(entry_data, entry.compressed_size);
+      wxZlibInputStream zlib(compressed, wxZLIB_NO_HEADER);
+      zlib.Read(&inflated[0], inflated.size());
+      if (zlib.LastRead() != inflated.size()) return InputStreamP();
+      if (update_crc32(0, inflated.data(), inflated.size()) != entry.crc) return InputStreamP();
+    }
+    return shared(new MappedZipInputStream(MappedZipP(this), inflated));
+  } else {
+    return InputStreamP();
+  }
+}
+
+bool MappedZip::mapFile(const String& filename) {
+  #if defined(__WXMSW__)
+    // share everything, so the file can still be saved (appended to or renamed) while it is mapped
+    HANDLE file = CreateFileW(filename.wc_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                              nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER file_size;
+    if (GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0 && file_size.QuadPart < 0xFFFFFFFF) {
+      HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+      if (mapping) {
+        data = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        CloseHandle(mapping); // the view keeps the mapping open
+      }
+      if (data) size = (size_t)file_size.QuadPart;
+    }
+    CloseHandle(file);
+  #else
+    int file = ::open(filename.fn_str(), O_RDONLY);
+    if (file < 0) return false;
+    struct stat info;
+    if (fstat(file, &info) == 0 && info.st_size > 0 && info.st_size < 0xFFFFFFFF) {
+      void* view = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_SHARED, file, 0);
+      if (view != MAP_FAILED) {
+        data = (const char*)view;
+        size = (size_t)info.st_size;
+      }
+    }
+    ::close(file);
+  #endif
+  return data != nullptr;
+}
+
+void MappedZip::unmapFile() {
+  if (data) {
+    #if defined(__WXMSW__)
+      UnmapViewOfFile(data);
+    #else
+      munmap(const_cast<char*>(data), size);
+    #endif
+  }
+  data = nullptr;
+  size = 0;
+}
+
+const char* MappedZip::readRange(wxFile& file, size_t offset, size_t length, std::string& buffer) const {
+  if (offset > size || size - offset < length) return nullptr;
+  if (data) return data + offset;
+  buffer.resize(length);
+  if (length == 0) return buffer.data();
+  if (file.Seek(offset) == wxInvalidOffset || file.Read(&buffer[0], length) != (ssize_t)length) return nullptr;
+  return buffer.data();
+}
+
+bool MappedZip::readDirectory() {
+  wxFile file;
+  if (!data && !file.Open(filename)) return false;
+  // the end record is in the last 22 + 0xFFFF bytes
+  size_t tail_size = min(size, (size_t)(22 + 0xFFFF));
+  std::string tail_buffer, directory_buffer;
+  const char* tail = readRange(file, size - tail_size, tail_size, tail_buffer);
+  if (!tail) return false;
+  size_t tail_end_pos = find_zip_end(tail, tail_size);
+  if (tail_end_pos == String::npos) return false;
+  const char* end_record = tail + tail_end_pos;
+  size_t end_pos = size - tail_size + tail_end_pos;
+  if (get_u16(end_record + 4) != 0 || get_u16(end_record + 6) != 0) return false; // multiple disks
+  UInt count            = get_u16(end_record + 10);
+  UInt directory_size   = get_u32(end_record + 12);
+  UInt directory_offset = get_u32(end_record + 16);
+  if (count == 0xFFFF || directory_offset == 0xFFFFFFFF) return false; // zip64
+  if (directory_offset > end_pos || directory_size > end_pos - directory_offset) return false;
+  // read all records
+  const char* directory = readRange(file, directory_offset, directory_size, directory_buffer);
+  if (!directory) return false;
+  entries.reserve(count);
+  for (size_t pos = 0 ; pos < directory_size ; ) {
+    const char* record = directory + pos;
+    if (pos + 46 > directory_size || get_u32(record) != zip_directory_signature) return false;
+    size_t name_size   = get_u16(record + 28);
+    size_t record_size = 46 + name_size + get_u16(record + 30) + get_u16(record + 32);
+    if (pos + record_size > directory_size) return false;
+    Entry entry;
+    entry.method          = get_u16(record + 10);
+    entry.dos_time        = get_u16(record + 14) << 16 | get_u16(record + 12);
+    entry.crc             = get_u32(record + 16);
+    entry.compressed_size = get_u32(record + 20);
+    entry.size            = get_u32(record + 24);
+    entry.offset          = get_u32(record + 42);
+    if (entry.compressed_size == 0xFFFFFFFF || entry.size == 0xFFFFFFFF || entry.offset == 0xFFFFFFFF) return false; // zip64
+    // the name is in UTF-8 if that flag is set, otherwise in the local encoding, as wxZipInputStream assumes
+    if (get_u16(record + 8) & 0x0800) {
+      entry.name = String(record + 46, wxConvUTF8,  name_size);
+    } else {
+      entry.name = String(record + 46, wxConvLocal, name_size);
+    }
+    entries.push_back(entry);
+    pos += record_size;
+  }
+  return true;
+}
+
+// ----------------------------------------------------------------------------- : Zip format
+
+size_t find_zip_end(const char* data, size_t size) {
+  if (size < 22) return String::npos;
+  // the record is at most 22 bytes + a comment of at most 0xFFFF bytes from the end
+  size_t last  = size - 22;
+  size_t first = last > 0xFFFF ? last - 0xFFFF : 0;
+  for (size_t pos = last ; ; --pos) {
+    if (get_u32(data + pos) == zip_end_signature && pos + 22 + get_u16(data + pos + 20) == size) {
+      return pos;
+    }
+    if (pos == first) return String::npos;
+  }
+}
@@ -0,0 +1,97 @@
+//+----------------------------------------------------------------------------+
+//| Description:  Magic Set Editor - Program to make Magic (tm) cards          |
+//| Copyright:    (C) 2001 - 2017 Twan van Laarhoven and Sean Hunt             |
+//| License:      GNU General Public License 2 or later (see file COPYING)     |
+//+----------------------------------------------------------------------------+
+
+#ifndef HEADER_UTIL_IO_MAPPED_ZIP
+#define HEADER_UTIL_IO_MAPPED_ZIP
+
+// ----------------------------------------------------------------------------- : Includes
+
+#include <util/prec.hpp>
+
+DECLARE_POINTER_TYPE(MappedZip);
+class wxFile;
+
+// ----------------------------------------------------------------------------- : MappedZip
+
+/// A zip file that is read through a memory mapping
+/** The central directory is read once into a list of entries.
+ *  Stored entries, usually images that are already compressed, are read directly from the mapping without copying them,
+ *  deflated entries are inflated from the mapping in one go.
+ *  The streams keep the mapping alive, so they stay valid after the zip file is closed or reopened.
+ *
+ *  If the file can't be mapped (for instance when there is not enough address space),
+ *  each entry is read from the file when it is opened, as wxZipInputStream would.
+ *
+ *  Zip64 archives and archives spanning multiple disks are not supported.
+ */
+class MappedZip : public IntrusivePtrBase<MappedZip> {
+  public:
+  /// A file in the zip file
+  struct Entry {
+    String name;            ///< Name of the file, with '/' as separator
+    UInt   method;          ///< Compression method, 0 = stored, 8 = deflated
+    UInt   dos_time;        ///< Modification time, in MS-DOS format (date << 16 | time)
+    UInt   crc;             ///< CRC-32 checksum of the uncompressed data
+    UInt   compressed_size;
+    UInt   size;            ///< Uncompressed size
+    UInt   offset;          ///< Position of the local header in the zip file
+
+    /// The modification time of the file
+    DateTime getDateTime() const;
+  };
+
+  MappedZip();
+  ~MappedZip();
+
+  /// Map a zip file and read its central directory
+  /** Returns false if the file can't be read or is not a zip file that we support */
+  bool open(const String& filename);
+
+  /// The files in the zip file, in the order of the central directory
+  inline const vector<Entry>& getEntries() const { return entries; }
+
+  /// Open a stream to read one of the entries of this zip file
+  /** Returns nullptr if the entry is damaged or uses an unsupported compression method */
+  InputStreamP openIn(const Entry& entry);
+
+  private:
+  String        filename; ///< Name of the file, for reading from it if it is not mapped
+  const char*   data;     ///< Contents of the file, if it is mapped
+  size_t        size;     ///< Size of the file
+  vector<Entry> entries;
+
+  /// Map a file into memory, returns false if that is not possible
+  bool mapFile(const String& filename);
+  void unmapFile();
+  /// Read the central directory into entries
+  bool readDirectory();
+  /// Get length bytes at the given offset of the file
+  /** Points into the mapping, or reads the bytes from file into buffer if there is no mapping.
+   *  Returns nullptr if the range is not in the file, or it can't be read.
+   */
+  const char* readRange(wxFile& file, size_t offset, size_t length, std::string& buffer) const;
+};
+
+// ----------------------------------------------------------------------------- : Zip format
+
+// Zip files are little endian
+inline UInt get_u16(const char* p) {
+  return (UInt)(Byte)p[0] | (UInt)(Byte)p[1] << 8;
+}
+inline UInt get_u32(const char* p) {
+  return get_u16(p) | get_u16(p + 2) << 16;
+}
+
+const UInt zip_local_header_signature = 0x04034b50;
+const UInt zip_directory_signature    = 0x02014b50;
+const UInt zip_end_signature          = 0x06054b50;
+
+/// Find the 'end of central directory' record at the end of some data
+/** Returns its position, or String::npos if the data doesn't end with one */
+size_t find_zip_end(const char* data, size_t size);
+
+// ----------------------------------------------------------------------------- : EOF
+#endif
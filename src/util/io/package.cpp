@@ -14,25 +14,24 @@
 #include <script/profiler.hpp> // for PROFILER
 #include <wx/wfstream.h>
 #include <wx/zipstrm.h>
+#include <wx/zstream.h>
 #include <wx/dir.h>
 #include <boost/scoped_ptr.hpp>
 
 DECLARE_TYPEOF(Package::FileInfos);
 DECLARE_TYPEOF_COLLECTION(PackageDependencyP);
+DECLARE_SHARED_POINTER_TYPE(wxZipEntry);
 
 // ----------------------------------------------------------------------------- : Package : outside
 
 IMPLEMENT_DYNAMIC_ARG(Package*, writing_package,   nullptr);
 IMPLEMENT_DYNAMIC_ARG(Package*, clipboard_package, nullptr);
 
-Package::Package()
-  : fileStream(nullptr)
-  , zipStream (nullptr)
-{}
+bool Package::append_on_save = false;
+
+Package::Package() {}
 
 Package::~Package() {
-  delete zipStream;
-  delete fileStream;
   // remove any remaining temporary files
   FOR_EACH(f, files) {
     if (f.second.wasWritten()) {
@@ -91,8 +90,7 @@ void Package::open(const String& n, bool fast) {
 void Package::reopen() {
   if (wxDirExists(filename)) {
     // make sure we have no zip open
-    delete zipStream;  zipStream  = nullptr;
-    delete fileStream; fileStream = nullptr;
+    zip = MappedZipP();
   } else {
     // reopen only needed for zipfile
     openZipfile();
@@ -106,12 +104,14 @@ void Package::save(bool remove_unused) {
 }
 
 void Package::saveAs(const String& name, bool remove_unused) {
+  wxStopWatch timer;
   // type of package
   if (wxDirExists(name)) {
     saveToDirectory(name, remove_unused, false);
   } else {
     saveToZipfile  (name, remove_unused, false);
   }
+  wxLogDebug(_("Package %s: files compressed and stored in %ld ms"), name, timer.Time());
   filename = name;
   removeTempFiles(remove_unused);
   reopen();
@@ -136,11 +136,10 @@ void Package::removeTempFiles(bool remove_unused) {
       ++it;
       files.erase(to_remove);
     } else {
-      // free zip entry, we will reopen the file
+      // forget the zip entry, we will reopen the file
       it->second.keep = false;
       it->second.tempName.clear();
-      delete it->second.zipEntry; 
-      it->second.zipEntry = 0;
+      it->second.zipEntry = nullptr;
       ++it;
     }
   }
@@ -154,29 +153,6 @@ void Package::clearKeepFlag() {
 
 // ----------------------------------------------------------------------------- : Package : inside
 
-#if 0
-/// Class that is a wxZipInputStream over a wxFileInput stream
-/** Note that wxFileInputStream is also a base class, because it must be constructed first
- *  This class requires a patch in wxWidgets (2.5.4)
- *   change zipstrm.cpp line 1745:;
- *        if ((!m_ffile || AtHeader()));
- *   to:
- *        if ((AtHeader()));
- *  It seems that in 2.6.3 this is no longer necessary (TODO: test)
- *
- *  NOTE: Not used with wx 2.6.3, since it doesn't support seeking
- */
-class ZipFileInputStream : private wxFileInputStream, public wxZipInputStream {
-  public:
-  ZipFileInputStream(const String& filename, wxZipEntry* entry)
-    : wxFileInputStream(filename)
-    , wxZipInputStream(static_cast<wxFileInputStream&>(*this))
-  {
-    OpenEntry(*entry);
-  }
-};
-#endif
-
 class BufferedFileInputStream_aux {
   protected:
   wxFileInputStream file_stream;
@@ -214,15 +190,12 @@ InputStreamP Package::openIn(const String& file) {
   if (it != files.end() && it->second.wasWritten()) {
     // written to this file, open the temp file
     stream = shared(new BufferedFileInputStream(it->second.tempName));
+  } else if (zip && it != files.end() && it->second.zipEntry) {
+    // a file in a zip archive
+    stream = zip->openIn(*it->second.zipEntry);
   } else if (wxFileExists(filename+_("/")+file)) {
     // a file in directory package
     stream = shared(new BufferedFileInputStream(filename+_("/")+file));
-  } else if (wxFileExists(filename) && it != files.end() && it->second.zipEntry) {
-    // a file in a zip archive
-    // somebody in wx thought seeking was no longer needed, it now only works with the 'compatability constructor'
-    stream = shared(new wxZipInputStream(filename, it->second.zipEntry->GetInternalName()));
-    //stream = static_pointer_cast<wxZipInputStream>(
-    //      shared(new ZipFileInputStream(filename, it->second.zipEntry)));
   } else {
     // shouldn't happen, packaged changed by someone else since opening it
     throw FileNotFoundError(file, filename);
@@ -288,7 +261,7 @@ void Package::referenceFile(const String& file) {
 }
 
 String Package::absoluteName(const String& file) {
-  assert(wxThread::IsMain());
+  // only looks at the files, so this can be used from other threads while the main thread waits for them
   FileInfos::iterator it = files.find(normalize_internal_filename(file));
   if (it == files.end()) {
     throw FileNotFoundError(file, filename);
@@ -326,18 +299,12 @@ Package::FileInfo::FileInfo()
   : keep(false), created(false), zipEntry(nullptr)
 {}
 
-Package::FileInfo::~FileInfo() {
-  delete zipEntry;
-}
-
-void Package::loadZipStream() {
-  while (true) {
-    wxZipEntry* entry = zipStream->GetNextEntry();
-    if (!entry) break;
-    String name = normalize_internal_filename(entry->GetName(wxPATH_UNIX));
-    files[name].zipEntry = entry;
+void Package::loadZipEntries() {
+  const vector<MappedZip::Entry>& entries = zip->getEntries();
+  for (size_t i = 0 ; i < entries.size() ; ++i) {
+    String name = normalize_internal_filename(entries[i].name);
+    files[name].zipEntry = &entries[i];
   }
-  zipStream->CloseEntry();
 }
 
 void Package::openDirectory(bool fast) {
@@ -367,16 +334,14 @@ void Package::openSubdir(const String& name) {
 }
 
 void Package::openZipfile() {
-  // close old streams
-  delete fileStream; fileStream = nullptr;
-  delete zipStream;  zipStream  = nullptr;
-  // open streams
-  fileStream = new wxFileInputStream(filename);
-  if (!fileStream->IsOk()) throw PackageError(_ERROR_1_("package not found", filename));
-  zipStream  = new wxZipInputStream(*fileStream);
-  if (!zipStream->IsOk())  throw PackageError(_ERROR_1_("package not found", filename));
-  // read zip entries
-  loadZipStream();
+  // close the old mapping, streams that are still open keep it alive
+  zip = MappedZipP();
+  recoverZipfile();
+  // map the file, and read the zip entries
+  MappedZipP new_zip(new MappedZip);
+  if (!new_zip->open(filename)) throw PackageError(_ERROR_1_("package not found", filename));
+  zip = new_zip;
+  loadZipEntries();
 }
 
 void Package::saveToDirectory(const String& saveAs, bool remove_unused, bool is_copy) {
@@ -411,6 +376,8 @@ void Package::saveToDirectory(const String& saveAs, bool remove_unused, bool is_
 }
 
 void Package::saveToZipfile(const String& saveAs, bool remove_unused, bool is_copy) {
+  // saving over the same zip file, only write what changed
+  if (append_on_save && !is_copy && saveAs == filename && zip && appendToZipfile(remove_unused)) return;
   // create a temporary zip file name
   String tempFile = saveAs + _(".tmp");
   wxRemoveFile(tempFile);
@@ -420,17 +387,29 @@ void Package::saveToZipfile(const String& saveAs, bool remove_unused, bool is_co
     if (!newFile->IsOk()) throw PackageError(_ERROR_("unable to open output file"));
     scoped_ptr<wxZipOutputStream>  newZip(new wxZipOutputStream(*newFile));
     if (!newZip->IsOk())  throw PackageError(_ERROR_("unable to open output file"));
+    // read the entries of the old zip file, to copy them without recompressing
+    scoped_ptr<wxFileInputStream> oldFile;
+    scoped_ptr<wxZipInputStream>  oldZip;
+    map<String, wxZipEntryP> oldEntries;
+    if (zip) {
+      oldFile.reset(new wxFileInputStream(filename));
+      if (!oldFile->IsOk()) throw PackageError(_ERROR_1_("package not found", filename));
+      oldZip.reset(new wxZipInputStream(*oldFile));
+      if (!oldZip->IsOk())  throw PackageError(_ERROR_1_("package not found", filename));
+      while (wxZipEntry* entry = oldZip->GetNextEntry()) {
+        oldEntries[normalize_internal_filename(entry->GetName(wxPATH_UNIX))] = wxZipEntryP(entry);
+      }
+      newZip->CopyArchiveMetaData(*oldZip);
+    }
     // copy everything to a new zip file, unless it's updated or removed
-    if (zipStream) newZip->CopyArchiveMetaData(*zipStream);
     FOR_EACH(f, files) {
+      map<String, wxZipEntryP>::const_iterator old = oldEntries.find(f.first);
       if (!f.second.keep && remove_unused) {
         // to remove a file simply don't copy it
-      } else if (!is_copy && f.second.zipEntry && !f.second.wasWritten()) {
+      } else if (f.second.zipEntry && !f.second.wasWritten() && old != oldEntries.end()) {
         // old file, was also in zip, not changed
-        // can't do this when saving a copy, since it destroys the zip entry
-        zipStream->CloseEntry();
-        newZip->CopyEntry(f.second.zipEntry, *zipStream);
-        f.second.zipEntry = 0;
+        oldZip->CloseEntry();
+        newZip->CopyEntry(old->second->Clone(), *oldZip);
       } else {
         // changed file, or the old package was not a zipfile
         newZip->PutNextEntry(f.first);
@@ -438,11 +417,6 @@ void Package::saveToZipfile(const String& saveAs, bool remove_unused, bool is_co
         newZip->Write(*temp);
       }
     }
-    // close the old file
-    if (!is_copy) {
-      delete zipStream;  zipStream  = nullptr;
-      delete fileStream; fileStream = nullptr;
-    }
   } catch (Error e) {
     // when things go wrong delete the temp file
     wxRemoveFile(tempFile);
@@ -457,6 +431,290 @@ void Package::saveToZipfile(const String& saveAs, bool remove_unused, bool is_co
   wxRenameFile(tempFile, saveAs);
 }
 
+// ----------------------------------------------------------------------------- : Package : appending to zip files
+
+/// Rewrite a zip file instead of appending to it when more than this fraction of it would be wasted
+const double max_zip_waste = 0.25;
+/// Size of the buffer for compressing files
+const size_t zip_buffer_size = 64 * 1024;
+
+/// Table for update_crc32
+struct Crc32Table {
+  UInt table[256];
+  Crc32Table() {
+    for (UInt i = 0 ; i < 256 ; ++i) {
+      UInt c = i;
+      for (int k = 0 ; k < 8 ; ++k) {
+        c = c & 1 ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+      }
+      table[i] = c;
+    }
+  }
+};
+const Crc32Table crc32_table;
+
+UInt update_crc32(UInt crc, const void* data, size_t size) {
+  const Byte* bytes = static_cast<const Byte*>(data);
+  crc = crc ^ 0xFFFFFFFF;
+  for (size_t i = 0 ; i < size ; ++i) {
+    crc = crc32_table.table[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+  }
+  return crc ^ 0xFFFFFFFF;
+}
+
+inline void set_u32(char* p, UInt x) {
+  for (int i = 0 ; i < 4 ; ++i) p[i] = (char)((x >> (8 * i)) & 0xFF);
+}
+inline void put_u16(std::string& out, UInt x) {
+  out += (char)(x & 0xFF);
+  out += (char)((x >> 8) & 0xFF);
+}
+inline void put_u32(std::string& out, UInt x) {
+  put_u16(out, x & 0xFFFF);
+  put_u16(out, x >> 16);
+}
+
+void write_all(wxFile& file, const std::string& data) {
+  if (file.Write(data.data(), data.size()) != data.size()) {
+    throw PackageError(_ERROR_("unable to store file"));
+  }
+}
+bool read_all(wxFile& file, wxFileOffset pos, std::string& out) {
+  return !out.empty() && file.Seek(pos) != wxInvalidOffset && file.Read(&out[0], out.size()) == (ssize_t)out.size();
+}
+
+/// Append a file to a zip file as a deflated entry, and add its record to the central directory
+void append_zip_entry(wxFile& file, const String& name, const String& source, UInt dos_time, UInt dos_date, std::string& directory) {
+  wxCharBuffer name_utf8 = name.ToUTF8();
+  std::string name_bytes(name_utf8.data(), name_utf8.length());
+  UInt flags = 0;
+  for (size_t i = 0 ; i < name_bytes.size() ; ++i) {
+    if ((Byte)name_bytes[i] >= 0x80) flags = 0x0800; // name is in UTF-8
+  }
+  // local header, the checksum and sizes are filled in afterwards
+  wxFileOffset header_offset = file.Tell();
+  if (header_offset == wxInvalidOffset || header_offset >= 0xFFFFFFFF) {
+    throw PackageError(_ERROR_("unable to store file"));
+  }
+  std::string header;
+  put_u32(header, zip_local_header_signature);
+  put_u16(header, 20);     // version needed to extract
+  put_u16(header, flags);
+  put_u16(header, 8);      // deflated
+  put_u16(header, dos_time);
+  put_u16(header, dos_date);
+  put_u32(header, 0);      // crc
+  put_u32(header, 0);      // compressed size
+  put_u32(header, 0);      // uncompressed size
+  put_u16(header, (UInt)name_bytes.size());
+  put_u16(header, 0);      // extra field length
+  header += name_bytes;
+  write_all(file, header);
+  // compressed data
+  wxFileInputStream in(source);
+  if (!in.IsOk()) throw PackageError(_ERROR_("unable to store file"));
+  UInt         crc  = 0;
+  wxFileOffset size = 0;
+  {
+    wxFileOutputStream out(file);
+    wxZlibOutputStream zlib(out, -1, wxZLIB_NO_HEADER);
+    vector<char> buffer(zip_buffer_size);
+    while (true) {
+      in.Read(&buffer[0], buffer.size());
+      size_t read = in.LastRead();
+      if (read == 0) break;
+      crc   = update_crc32(crc, &buffer[0], read);
+      size += read;
+      zlib.Write(&buffer[0], read);
+      if (!zlib.IsOk()) throw PackageError(_ERROR_("unable to store file"));
+    }
+    if (!zlib.Close() || !out.IsOk()) throw PackageError(_ERROR_("unable to store file"));
+  }
+  wxFileOffset end = file.Tell();
+  wxFileOffset compressed_size = end - header_offset - (wxFileOffset)header.size();
+  if (end == wxInvalidOffset || end >= 0xFFFFFFFF || size >= 0xFFFFFFFF) {
+    throw PackageError(_ERROR_("unable to store file"));
+  }
+  std::string sizes;
+  put_u32(sizes, crc);
+  put_u32(sizes, (UInt)compressed_size);
+  put_u32(sizes, (UInt)size);
+  if (file.Seek(header_offset + 14) == wxInvalidOffset) throw PackageError(_ERROR_("unable to store file"));
+  write_all(file, sizes);
+  if (file.SeekEnd() == wxInvalidOffset) throw PackageError(_ERROR_("unable to store file"));
+  // central directory record
+  put_u32(directory, zip_directory_signature);
+  put_u16(directory, 20);  // version made by
+  put_u16(directory, 20);  // version needed to extract
+  put_u16(directory, flags);
+  put_u16(directory, 8);
+  put_u16(directory, dos_time);
+  put_u16(directory, dos_date);
+  directory += sizes;
+  put_u16(directory, (UInt)name_bytes.size());
+  put_u16(directory, 0);   // extra field length
+  put_u16(directory, 0);   // comment length
+  put_u16(directory, 0);   // disk number
+  put_u16(directory, 0);   // internal attributes
+  put_u32(directory, 0);   // external attributes
+  put_u32(directory, (UInt)header_offset);
+  directory += name_bytes;
+}
+
+/// Does a zip file end with an end record that belongs to a central directory just before it?
+/** That is the case after a completed save, but not after an interrupted one, which ends in a partial file */
+bool zip_end_is_consistent(wxFile& file) {
+  wxFileOffset file_size = file.Length();
+  if (file_size <= 0 || file_size >= 0xFFFFFFFF) return false;
+  std::string tail((size_t)min(file_size, (wxFileOffset)(22 + 0xFFFF)), '\0');
+  if (!read_all(file, file_size - tail.size(), tail)) return false;
+  size_t end_pos = find_zip_end(tail.data(), tail.size());
+  if (end_pos == String::npos) return false;
+  const char* end_record = tail.data() + end_pos;
+  UInt directory_size   = get_u32(end_record + 12);
+  UInt directory_offset = get_u32(end_record + 16);
+  if ((wxFileOffset)directory_offset + directory_size != file_size - (wxFileOffset)(tail.size() - end_pos)) return false;
+  if (directory_size == 0) return get_u16(end_record + 10) == 0;
+  // the directory must start with a directory record
+  std::string signature(4, '\0');
+  return read_all(file, directory_offset, signature) && get_u32(signature.data()) == zip_directory_signature;
+}
+
+bool Package::appendToZipfile(bool remove_unused) {
+  wxFile file(filename, wxFile::read_write);
+  if (!file.IsOpened()) return false;
+  wxFileOffset file_size = file.Length();
+  if (file_size <= 0 || file_size >= 0xFFFFFFFF) return false;
+  // find the central directory
+  std::string tail((size_t)min(file_size, (wxFileOffset)(22 + 0xFFFF)), '\0');
+  if (!read_all(file, file_size - tail.size(), tail)) return false;
+  size_t end_pos = find_zip_end(tail.data(), tail.size());
+  if (end_pos == String::npos) return false;
+  const char* end_record = tail.data() + end_pos;
+  UInt directory_size   = get_u32(end_record + 12);
+  UInt directory_offset = get_u32(end_record + 16);
+  if (get_u16(end_record + 4) != 0 || get_u16(end_record + 6) != 0) return false; // multiple disks
+  if (get_u16(end_record + 10) == 0xFFFF || directory_offset == 0xFFFFFFFF) return false; // zip64
+  if ((wxFileOffset)directory_offset + directory_size != file_size - (wxFileOffset)(tail.size() - end_pos)) {
+    return false; // something between the directory and its end, we can't keep that
+  }
+  // the old central directory and end record, these are what we restore when something goes wrong
+  std::string old_end((size_t)(file_size - directory_offset), '\0');
+  if (!read_all(file, directory_offset, old_end)) return false;
+  // keep the records of files that are not changed
+  set<wxFileOffset> kept;
+  size_t new_count = 0;
+  wxFileOffset new_size = 0;
+  FOR_EACH(f, files) {
+    if (!f.second.keep && remove_unused) continue;
+    if (f.second.wasWritten()) {
+      new_count += 1;
+      new_size  += wxFileName::GetSize(f.second.tempName).GetValue();
+    } else if (f.second.zipEntry) {
+      kept.insert(f.second.zipEntry->offset);
+    }
+  }
+  std::string directory;
+  size_t count = 0;
+  wxFileOffset live_size = 0; // size of the entries that are still used
+  for (size_t pos = 0 ; pos < directory_size ; ) {
+    const char* record = old_end.data() + pos;
+    if (pos + 46 > directory_size || get_u32(record) != zip_directory_signature) return false;
+    size_t record_size = 46 + get_u16(record + 28) + get_u16(record + 30) + get_u16(record + 32);
+    UInt compressed_size = get_u32(record + 20);
+    UInt offset          = get_u32(record + 42);
+    if (pos + record_size > directory_size) return false;
+    if (compressed_size == 0xFFFFFFFF || offset == 0xFFFFFFFF) return false; // zip64
+    if (kept.find(offset) != kept.end()) {
+      directory.append(record, record_size);
+      count += 1;
+      live_size += 30 + get_u16(record + 28) + get_u16(record + 30) + compressed_size
+                 + (get_u16(record + 8) & 8 ? 16 : 0); // data descriptor
+    }
+    pos += record_size;
+  }
+  if (count != kept.size()) return false;
+  // is it time to compact the file?
+  if (file_size - live_size > (file_size + new_size) * max_zip_waste) return false;
+  if (count + new_count >= 0xFFFF || file_size + new_size * 1.01 + 0x10000 + directory.size() * 2 >= 0xFFFFFFFF) return false;
+  // keep the old end in a journal, so an interrupted save can be undone
+  String journal = filename + _(".journal");
+  {
+    wxFile journal_file;
+    if (!journal_file.Create(filename + _(".tmp"), true)
+       || journal_file.Write(old_end.data(), old_end.size()) != old_end.size()
+       || !journal_file.Flush()) {
+      journal_file.Close();
+      wxRemoveFile(filename + _(".tmp"));
+      return false;
+    }
+  }
+  if (!wxRenameFile(filename + _(".tmp"), journal)) return false;
+  // append the changed files, and the new central directory after them
+  try {
+    if (file.SeekEnd() == wxInvalidOffset) throw PackageError(_ERROR_("unable to store file"));
+    wxDateTime now = wxDateTime::Now();
+    UInt dos_time = now.GetHour() << 11 | now.GetMinute() << 5 | now.GetSecond() / 2;
+    UInt dos_date = (now.GetYear() - 1980) << 9 | (now.GetMonth() + 1) << 5 | now.GetDay();
+    FOR_EACH(f, files) {
+      if (!f.second.wasWritten() || (!f.second.keep && remove_unused)) continue;
+      append_zip_entry(file, f.first, f.second.tempName, dos_time, dos_date, directory);
+      count += 1;
+    }
+    wxFileOffset new_directory_offset = file.Tell();
+    UInt         new_directory_size   = (UInt)directory.size();
+    std::string end;
+    end.swap(directory);
+    put_u32(end, zip_end_signature);
+    put_u16(end, 0);       // disk number
+    put_u16(end, 0);       // disk with the central directory
+    put_u16(end, (UInt)count);
+    put_u16(end, (UInt)count);
+    put_u32(end, new_directory_size);
+    put_u32(end, (UInt)new_directory_offset);
+    end.append(old_end, directory_size + 20, std::string::npos); // length of the archive comment, and the comment
+    write_all(file, end);
+    if (!file.Flush()) throw PackageError(_ERROR_("unable to store file"));
+    file.Close();
+  } catch (const Error&) {
+    file.Close();
+    recoverZipfile();
+    throw;
+  }
+  wxRemoveFile(journal);
+  return true;
+}
+
+void Package::recoverZipfile() {
+  String journal = filename + _(".journal");
+  if (!wxFileExists(journal)) return;
+  // was the save completed, but the journal not yet removed?
+  // or was nothing written yet? then the file is fine as it is
+  {
+    wxFile file(filename);
+    if (file.IsOpened() && zip_end_is_consistent(file)) {
+      file.Close();
+      wxRemoveFile(journal);
+      return;
+    }
+  }
+  // the journal contains the central directory and end record from before the save
+  wxFile journal_file(journal);
+  std::string old_end(journal_file.IsOpened() ? (size_t)journal_file.Length() : 0, '\0');
+  bool valid = journal_file.IsOpened() && read_all(journal_file, 0, old_end);
+  journal_file.Close();
+  size_t end_pos = find_zip_end(old_end.data(), old_end.size());
+  if (valid && end_pos != String::npos && get_u32(old_end.data() + end_pos + 12) == end_pos) {
+    // append them again, after whatever was written
+    wxFile file(filename, wxFile::read_write);
+    wxFileOffset offset = file.IsOpened() ? file.SeekEnd() : wxInvalidOffset;
+    if (offset == wxInvalidOffset || offset >= 0xFFFFFFFF) return;
+    set_u32(&old_end[end_pos + 16], (UInt)offset);
+    if (file.Write(old_end.data(), old_end.size()) != old_end.size() || !file.Flush()) return;
+  }
+  wxRemoveFile(journal);
+}
+
 
 Package::FileInfos::iterator Package::addFile(const String& name) {
   return files.insert(make_pair(normalize_internal_filename(name), FileInfo())).first;
@@ -466,7 +724,7 @@ DateTime Package::modificationTime(const pair<String, FileInfo>& fi) const {
   if (fi.second.wasWritten()) {
     return wxFileName(fi.first).GetModificationTime();
   } else if (fi.second.zipEntry) {
-    return fi.second.zipEntry->GetDateTime();
+    return fi.second.zipEntry->getDateTime();
   } else if (wxFileExists(filename+_("/")+fi.first)) {
     return wxFileName(filename+_("/")+fi.first).GetModificationTime();
   } else {
@@ -475,6 +733,43 @@ DateTime Package::modificationTime(const pair<String, FileInfo>& fi) const {
 }
 
 
+String Package::fileIdentity(const String& file) {
+  if (!file.empty() && file.GetChar(0) == _('/')) {
+    // absolute path, a file from another package
+    size_t start = file.find_first_not_of(_("/\\"), 1);
+    size_t pos   = file.find_first_of(_("/\\"), start);
+    if (start >= pos || pos == String::npos) return String();
+    PackagedP p = package_manager.openAny(file.substr(start, pos-start));
+    return p->fileIdentity(file.substr(pos + 1));
+  }
+  String name = normalize_internal_filename(file);
+  FileInfos::iterator it = files.find(name);
+  String location;
+  DateTime time;
+  if (it != files.end() && it->second.wasWritten()) {
+    location = it->second.tempName;
+    time = wxFileName(location).GetModificationTime();
+  } else if (wxFileExists(filename+_("/")+file)) {
+    location = filename+_("/")+file;
+    time = wxFileName(location).GetModificationTime();
+  } else if (it != files.end() && it->second.zipEntry) {
+    location = filename+_("/")+name;
+    time = it->second.zipEntry->getDateTime();
+  } else {
+    return String();
+  }
+  return location + _("@") + time.GetValue().ToString();
+}
+
+bool Package::zipChecksum(const String& file, size_t& size, UInt& crc) const {
+  FileInfos::const_iterator it = files.find(normalize_internal_filename(file));
+  if (it == files.end() || it->second.wasWritten() || !it->second.zipEntry) return false;
+  size = it->second.zipEntry->size;
+  crc  = it->second.zipEntry->crc;
+  return true;
+}
+
+
 // ----------------------------------------------------------------------------- : Packaged
 
 template <> void Reader::handle(PackageDependency& dep) {
@@ -565,20 +860,29 @@ void Packaged::loadFully() {
 
 void Packaged::save() {
   WITH_DYNAMIC_ARG(writing_package, this);
-  writeFile(typeName(), *this, fileVersion());
+  size_t size;
+  UInt   crc;
+  writeFile(typeName(), *this, fileVersion(), &size, &crc);
   referenceFile(typeName());
+  writeCaches(size, crc);
   Package::save();
 }
 void Packaged::saveAs(const String& package, bool remove_unused) {
   WITH_DYNAMIC_ARG(writing_package, this);
-  writeFile(typeName(), *this, fileVersion());
+  size_t size;
+  UInt   crc;
+  writeFile(typeName(), *this, fileVersion(), &size, &crc);
   referenceFile(typeName());
+  writeCaches(size, crc);
   Package::saveAs(package, remove_unused);
 }
 void Packaged::saveCopy(const String& package) {
   WITH_DYNAMIC_ARG(writing_package, this);
-  writeFile(typeName(), *this, fileVersion());
+  size_t size;
+  UInt   crc;
+  writeFile(typeName(), *this, fileVersion(), &size, &crc);
   referenceFile(typeName());
+  writeCaches(size, crc);
   Package::saveCopy(package);
 }
 
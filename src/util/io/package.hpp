@@ -14,11 +14,9 @@
 #include <util/error.hpp>
 #include <util/file_utils.hpp>
 #include <util/vcs.hpp>
+#include <util/io/mapped_zip.hpp>
 
 class Package;
-class wxFileInputStream;
-class wxZipInputStream;
-class wxZipEntry;
 DECLARE_POINTER_TYPE(PackageDependency);
 
 /// The package that is currently being written to
@@ -37,13 +35,13 @@ DECLARE_DYNAMIC_ARG(Package*, clipboard_package);
  *  To accomplish this modified files are first written to temporary files, when save() is called
  *  the temporary files are moved/copied.
  *
- *  Zip files are accessed using wxZip(Input|Output)Stream.
- *  The zip input stream appears to only allow one file at a time, since the stream itself maintains
- *  state about what file we are reading.
- *  There are multiple solutions:
- *    1. (currently used) Open a new ZipInputStream for each file
- *    2. (may be faster) First read the file into a memory buffer,
- *      return a stream based on that buffer (StringInputStream).
+ *  When saving a zip file over itself, the changed files and a new central directory are appended
+ *  to the end of the zip file, so saving takes time proportional to the changes.
+ *  The old entries stay in the file as wasted space, when there is too much of it the zip file is rewritten.
+ *
+ *  Zip files are read using a MappedZip, which memory maps the zip file and reads its directory once.
+ *  Files in it are opened without any seeking, stored files (such as images) are read from the mapping directly.
+ *  Zip files are rewritten using wxZip(Input|Output)Stream.
  *
  *  TODO: maybe support sub packages (a package inside another package)?
  */
@@ -95,6 +93,10 @@ class Package : public IntrusivePtrVirtualBase {
 
   /// Saves the package under a different filename, but keep the old one open
   void saveCopy(const String& package);
+  
+  /// Should save() append the changed files to a zip package, instead of rewriting it?
+  /** Appending is faster for large packages, but it doesn't leave a .bak copy of the old package */
+  static bool append_on_save;
 
 
   // --------------------------------------------------- : Managing the inside of the package
@@ -127,6 +129,14 @@ class Package : public IntrusivePtrVirtualBase {
   /// Open a file given an absolute filename
   static InputStreamP openAbsoluteFile(const String& name);
 
+  /// A key that identifies the current contents of a file, for caching things loaded from it
+  /** The key changes when the file is modified. Returns an empty string if the file can't be found. */
+  String fileIdentity(const String& file);
+  
+  /// The size and CRC-32 checksum of a file, as stored in the zip file
+  /** Returns false if the file is not in a zip file, or if it was changed after the package was opened */
+  bool zipChecksum(const String& file, size_t& size, UInt& crc) const;
+
   // --------------------------------------------------- : Managing the inside of the package : Reader/writer
 
   template <typename T>
@@ -139,10 +149,17 @@ class Package : public IntrusivePtrVirtualBase {
     return obj;
   }
 
+  /// Write an object to a file, optionally also gives the size and CRC-32 checksum of the file
   template <typename T>
-  void writeFile(const String& file, const T& obj, Version file_version) {
+  void writeFile(const String& file, const T& obj, Version file_version, size_t* size = nullptr, UInt* crc = nullptr) {
+    wxStopWatch timer;
     Writer writer(openOut(file), file_version);
     writer.handle(obj);
+    long serialize_time = timer.Time();
+    writer.flush();
+    if (size) *size = writer.writtenSize();
+    if (crc)  *crc  = writer.writtenCrc();
+    wxLogDebug(_("%s: serialized in %ld ms, written to disk in %ld ms"), file, serialize_time, timer.Time() - serialize_time);
   }
 
   protected:
@@ -158,11 +175,10 @@ class Package : public IntrusivePtrVirtualBase {
   /// Information about a file in the package
   struct FileInfo {
     FileInfo();
-    ~FileInfo();
     bool keep;               ///< Should this file be kept in the package? (as opposed to deleting it)
     bool created;            ///< Was this file just created (e.g. should the VCS add it?)
     String tempName;         ///< Name of the temporary file where new contents of this file are placed
-    wxZipEntry* zipEntry;    ///< Entry in the zip file for this file
+    const MappedZip::Entry* zipEntry; ///< Entry in the zip file for this file, owned by the MappedZip
     /// Is this file changed, and therefore written to a temporary file?
     inline bool wasWritten() const { return !tempName.empty(); }
   };
@@ -182,12 +198,10 @@ class Package : public IntrusivePtrVirtualBase {
   private:
   /// All files in the package
   FileInfos files;
-  /// Filestream for reading zip files
-  wxFileInputStream* fileStream;
-  /// Filestream for reading zip files
-  wxZipInputStream*  zipStream;
+  /// The zip file, if this package is one
+  MappedZipP zip;
 
-  void loadZipStream();
+  void loadZipEntries();
   void openDirectory(bool fast = false);
   void openSubdir(const String&);
   void openZipfile();
@@ -196,6 +210,10 @@ class Package : public IntrusivePtrVirtualBase {
   void clearKeepFlag();
   void saveToZipfile(const String&,   bool remove_unused, bool is_copy);
   void saveToDirectory(const String&, bool remove_unused, bool is_copy);
+  /// Append the changed files to the zip file, returns false if the zip file should be rewritten instead
+  bool appendToZipfile(bool remove_unused);
+  /// Restore the zip file if appending to it was interrupted
+  void recoverZipfile();
   FileInfos::iterator addFile(const String& file);
 };
 
@@ -256,6 +274,9 @@ class Packaged : public Package {
   virtual void validate(Version file_app_version);
   /// What file version should be used for writing files?
   virtual Version fileVersion() const = 0;
+  /// Can be overloaded to write files that cache what is in the data file, called when it has just been written
+  /** Gets the size and CRC-32 checksum of the data file that was written */
+  virtual void writeCaches(size_t file_size, UInt file_crc) {}
 
   DECLARE_REFLECTION_VIRTUAL();
 
@@ -277,6 +298,9 @@ class IncludePackage : public Packaged {
 
 // ----------------------------------------------------------------------------- : Utility
 
+/// Update a CRC-32 checksum, as used in zip files, with more data. Start with crc = 0
+UInt update_crc32(UInt crc, const void* data, size_t size);
+
 /// Open a package with the given filename
 template <typename T>
 intrusive_ptr<T> open_package(const String& filename) {
@@ -16,17 +16,26 @@
 #include <data/locale.hpp>
 #include <data/export_template.hpp>
 #include <data/installer.hpp>
+#include <gfx/image_pool.hpp>
+#include <gfx/generated_image.hpp>
 #include <wx/stdpaths.h>
 #include <wx/wfstream.h>
 
 DECLARE_TYPEOF_COLLECTION(InstallablePackageP);
 DECLARE_TYPEOF_COLLECTION(PackageVersionP);
 DECLARE_TYPEOF_COLLECTION(PackageVersion::FileInfo);
+DECLARE_TYPEOF_COLLECTION(PackageHeaderP);
+DECLARE_TYPEOF_COLLECTION(PackageDependencyP);
+DECLARE_TYPEOF(Package::FileInfos);
+DECLARE_TYPEOF_COLLECTION(String);
 
 // ----------------------------------------------------------------------------- : PackageManager : in memory
 
 PackageManager package_manager;
 
+PackageManager::PackageManager()
+  : loaded(mutex)
+{}
 
 void PackageManager::init() {
   local.init(true);
@@ -37,9 +46,14 @@ void PackageManager::init() {
                 wxStandardPaths::Get().GetUserDataDir());
 }
 void PackageManager::destroy() {
+  prefetcher.finish();
+  wxMutexLocker lock(mutex);
   loaded_packages.clear();
 }
 void PackageManager::reset() {
+  prefetcher.finish();
+  clear_symbol_image_cache();
+  wxMutexLocker lock(mutex);
   loaded_packages.clear();
 }
 
@@ -61,8 +75,25 @@ PackagedP PackageManager::openAny(const String& name_, bool just_header) {
   }
 
   // Is this package already loaded?
-  PackagedP& p = loaded_packages[filename];
-  if (!p) {
+  wxThreadIdType self = wxThread::GetCurrentId();
+  wxMutexLocker lock(mutex);
+  PackagedP p = loaded_packages[filename];
+  // wait until other threads are done loading it
+  while (p && loading.find(p.get()) != loading.end() && loading[p.get()] != self) {
+    if (waitWouldDeadlock(p.get(), self)) {
+      // break the cycle: a background thread gives up, and the package is loaded again by whoever needs it
+      if (!wxThread::IsMain()) throw PackageLoadAbandoned();
+      abandoning.insert(loading[p.get()]);
+      loaded.Broadcast();
+    }
+    waiting_for[self] = p.get();
+    loaded.Wait();
+    waiting_for.erase(self);
+    if (abandoning.erase(self)) throw PackageLoadAbandoned();
+    p = loaded_packages[filename]; // loading might have failed
+  }
+  bool is_new = !p;
+  if (is_new) {
     // load with the right type, based on extension
     wxFileName fn(filename);
     if      (fn.GetExt() == _("mse-game"))            p = intrusive(new Game);
@@ -74,28 +105,61 @@ PackagedP PackageManager::openAny(const String& name_, bool just_header) {
     else {
       throw PackageError(_("Unrecognized package type: '") + fn.GetExt() + _("'\nwhile trying to open: ") + name);
     }
-    p->open(filename, just_header);
-  } else if (!just_header) {
-    p->loadFully();
+    loaded_packages[filename] = p;
+  } else if (just_header || p->isFullyLoaded()) {
+    return p;
+  }
+  // load the package, without holding the lock, since that can open other packages
+  bool marked = loading.insert(make_pair(p.get(), self)).second; // not when loading recursively
+  wxStopWatch timer;
+  mutex.Unlock();
+  try {
+    if (is_new) {
+      p->open(filename, just_header);
+    } else {
+      p->loadFully();
+    }
+  } catch (...) {
+    mutex.Lock();
+    if (marked) loading.erase(p.get());
+    if (is_new && loaded_packages[filename] == p) loaded_packages.erase(filename); // try again next time
+    loaded.Broadcast();
+    throw;
   }
+  mutex.Lock();
+  if (marked) loading.erase(p.get());
+  loaded.Broadcast();
+  wxLogDebug(_("Package %s: %s in %ld ms%s"), filename, just_header ? _("header read") : _("loaded"), timer.Time(),
+             wxThread::IsMain() ? _("") : _(" in the background"));
   return p;
 }
 
-void PackageManager::findMatching(const String& pattern, vector<PackagedP>& out) {
-  // first find local packages
-  String file = local.findFirstMatching(pattern);
-  while (!file.empty()) {
-    out.push_back(openAny(file, true));
-    file = wxFindNextFile();
+bool PackageManager::waitWouldDeadlock(const Packaged* package, wxThreadIdType self) const {
+  // follow the chain of threads waiting for packages loaded by other threads, it should not lead back to us
+  while (true) {
+    map<const Packaged*, wxThreadIdType>::const_iterator l = loading.find(package);
+    if (l == loading.end()) return false;
+    if (l->second == self) return true;
+    map<wxThreadIdType, const Packaged*>::const_iterator w = waiting_for.find(l->second);
+    if (w == waiting_for.end()) return false;
+    package = w->second;
   }
+}
+
+void PackageManager::findMatching(const String& pattern, vector<PackageHeaderP>& out) {
+  // first find local packages
+  size_t local_start = out.size();
+  local.findMatchingHeaders(pattern, out);
+  size_t local_end = out.size();
   // then global packages not already in the list
-  file = global.findFirstMatching(pattern);
-  while (!file.empty()) {
-    PackagedP p = openAny(file, true);
-    if (find(out.begin(), out.end(), p) == out.end()) {
-      out.push_back(p);
+  vector<PackageHeaderP> global_packages;
+  global.findMatchingHeaders(pattern, global_packages);
+  FOR_EACH(p, global_packages) {
+    bool found = false;
+    for (size_t i = local_start ; i < local_end ; ++i) {
+      if (out[i]->filename == p->filename) found = true;
     }
-    file = wxFindNextFile();
+    if (!found) out.push_back(p);
   }
 }
 
@@ -355,6 +419,108 @@ String PackageDirectory::databaseFile() {
   return name(_("packages"));
 }
 
+// ----------------------------------------------------------------------------- : PackageDirectory : index
+
+String user_settings_dir();
+
+/// The time a package was last modified, to check whether its header has changed
+/** For a directory package this is the last time the directory or its main file was modified */
+double package_modified_time(const String& filename) {
+  double time = (double)file_modified_time(filename);
+  size_t pos = filename.find_last_of(_('.'));
+  if (pos != String::npos && is_substr(filename, pos, _(".mse-")) && wxDirExists(filename)) {
+    time = max(time, (double)file_modified_time(filename + _("/") + filename.substr(pos + 5)));
+  }
+  return time;
+}
+
+bool compare_filename(const PackageHeaderP& a, const PackageHeaderP& b) {
+  return a->filename < b->filename;
+}
+
+void PackageDirectory::findMatchingHeaders(const String& pattern, vector<PackageHeaderP>& out) {
+  if (!valid()) return;
+  loadIndex();
+  bool index_changed = false;
+  // list the packages again if the directory has changed
+  double dir_modified = (double)file_modified_time(directory);
+  if (dir_modified != index.modified) {
+    vector<PackageHeaderP> old_packages;
+    swap(old_packages, index.packages);
+    for (String s = findFirstMatching(_("*.mse-*")) ; !s.empty() ; s = wxFindNextFile()) {
+      size_t pos = s.find_last_of(_("/\\"));
+      if (pos != String::npos) s = s.substr(pos+1);
+      PackageHeaderP header(new PackageHeader);
+      header->filename = s;
+      index.packages.push_back(header);
+    }
+    sort(index.packages.begin(), index.packages.end(), compare_filename);
+    // keep the headers of packages that were already in the index
+    size_t j = 0;
+    for (size_t i = 0 ; i < index.packages.size() ; ++i) {
+      while (j < old_packages.size() && old_packages[j]->filename < index.packages[i]->filename) ++j;
+      if (j < old_packages.size() && old_packages[j]->filename == index.packages[i]->filename) {
+        index.packages[i] = old_packages[j];
+      }
+    }
+    index.modified = dir_modified;
+    index_changed = true;
+  }
+  // read the headers of the matching packages that changed
+  FOR_EACH(header, index.packages) {
+    if (!wxMatchWild(pattern, header->filename, false)) continue;
+    header->directory = directory;
+    double package_modified = package_modified_time(header->absoluteFilename());
+    if (header->modified == 0 || header->modified != package_modified) {
+      PackagedP package = package_manager.openAny(header->absoluteFilename(), true);
+      header->update(*package);
+      header->modified = package_modified;
+      index_changed = true;
+    }
+    out.push_back(header);
+  }
+  if (index_changed) saveIndex();
+}
+
+IMPLEMENT_REFLECTION_NO_SCRIPT(PackageIndex) {
+  REFLECT(modified);
+  REFLECT(packages);
+}
+
+void PackageDirectory::loadIndex() {
+  if (index.loaded) return;
+  index.loaded = true;
+  String filename = indexFile();
+  if (wxFileExists(filename)) {
+    // index file not existing is not an error, we just read all headers
+    shared_ptr<wxFileInputStream> file = shared(new wxFileInputStream(filename));
+    if (!file->Ok()) return; // failure is not an error
+    try {
+      Reader reader(file, nullptr, filename, true);
+      reader.handle_greedy(index);
+      // an index made by another version of the program might have read the headers differently
+      if (reader.file_app_version != app_version) index = PackageIndex();
+    } catch (const Error&) {
+      index = PackageIndex(); // a broken index is simply rebuilt
+    }
+    index.loaded = true;
+    sort(index.packages.begin(), index.packages.end(), compare_filename);
+  }
+}
+
+void PackageDirectory::saveIndex() {
+  // write to a temporary file first, so an interrupted write doesn't leave a truncated index
+  String filename = indexFile();
+  {
+    Writer writer(shared(new wxFileOutputStream(filename + _(".tmp"))), app_version);
+    writer.handle(index);
+  }
+  wxRenameFile(filename + _(".tmp"), filename);
+}
+String PackageDirectory::indexFile() {
+  return user_settings_dir() + (is_local ? _("package-index-local") : _("package-index-global"));
+}
+
 // ----------------------------------------------------------------------------- : PackageDirectory : installing
 
 bool PackageDirectory::install(const InstallablePackage& package) {
@@ -404,6 +570,215 @@ bool PackageDirectory::actual_install(const InstallablePackage& package, const S
   return true;
 }
 
+// ----------------------------------------------------------------------------- : PackagePrefetcher
+
+/// Maximum number of threads used for prefetching
+const int max_prefetch_threads = 4;
+
+/// Is a package of a type that is prefetched?
+bool is_prefetched_package(const String& name) {
+  String ext = wxFileName(trim(name)).GetExt();
+  return ext == _("mse-include") || ext == _("mse-symbol-font");
+}
+/// Is a file in a package an image that can be decoded in advance?
+bool is_prefetched_image(const String& filename) {
+  String ext = wxFileName(filename).GetExt().Lower();
+  return ext == _("png") || ext == _("jpg") || ext == _("jpeg") || ext == _("bmp") || ext == _("gif");
+}
+
+PackagePrefetcher::PackagePrefetcher()
+  : decoded_bytes(0), stopping(false)
+  , packages_loaded(0), images_decoded(0)
+{}
+
+PackagePrefetcher::~PackagePrefetcher() {
+  finish();
+}
+
+void PackagePrefetcher::prefetch(const PackagedP& package, const vector<String>& image_files) {
+  wxMutexLocker lock(mutex);
+  if (stopping) return;
+  // start a new batch?
+  bool idle = packages.empty() && images.empty();
+  for (size_t i = 0 ; i < workers.size() ; ++i) {
+    if (!workers[i]->done) idle = false;
+  }
+  if (idle) {
+    timer.Start();
+    packages_loaded = images_decoded = 0;
+    decoded_bytes = 0;
+  }
+  // queue jobs
+  queueDependencies(*package);
+  set<String> queued_images;
+  FOR_EACH_CONST(f, image_files) {
+    String name = normalize_internal_filename(f);
+    if (is_prefetched_image(name) && package->getFileInfos().count(name) && queued_images.insert(name).second) {
+      ImageJob job;
+      job.package  = package;
+      job.filename = name;
+      images.push_back(job);
+    }
+  }
+  startWorkers();
+}
+
+void PackagePrefetcher::finish() {
+  vector<Worker*> stopped;
+  {
+    wxMutexLocker lock(mutex);
+    stopping = true;
+    packages.clear();
+    images.clear();
+    stopped.swap(workers);
+  }
+  // wait for the jobs that are in progress
+  for (size_t i = 0 ; i < stopped.size() ; ++i) {
+    stopped[i]->Wait();
+    delete stopped[i];
+  }
+  wxMutexLocker lock(mutex);
+  queued.clear();
+  decoded_bytes = 0;
+  stopping = false;
+}
+
+void PackagePrefetcher::queueDependencies(const Packaged& package) {
+  FOR_EACH_CONST(dep, package.dependencies) {
+    if (is_prefetched_package(dep->package) && queued.insert(dep->package).second) {
+      packages.push_back(dep->package);
+    }
+  }
+}
+
+void PackagePrefetcher::startWorkers() {
+  // clean up workers that ran out of jobs
+  for (size_t i = 0 ; i < workers.size() ; ) {
+    if (workers[i]->done) {
+      workers[i]->Wait(); // the thread has returned or is about to
+      delete workers[i];
+      workers.erase(workers.begin() + i);
+    } else {
+      ++i;
+    }
+  }
+  // start new ones
+  size_t jobs    = packages.size() + images.size();
+  size_t threads = min(max_prefetch_threads, max(1, wxThread::GetCPUCount() - 1));
+  while (workers.size() < min(jobs, threads)) {
+    Worker* worker = new Worker(*this);
+    if (worker->Create() != wxTHREAD_NO_ERROR || worker->Run() != wxTHREAD_NO_ERROR) {
+      delete worker;
+      break;
+    }
+    workers.push_back(worker);
+  }
+}
+
+void PackagePrefetcher::loadPackage(const String& name) {
+  try {
+    PackagedP package = package_manager.openAny(name);
+    wxMutexLocker lock(mutex);
+    ++packages_loaded;
+    if (!stopping) {
+      queueDependencies(*package);
+      startWorkers();
+    }
+  } catch (...) {
+    // the error is reported when the package is opened for real
+  }
+}
+
+void PackagePrefetcher::decodeImage(const ImageJob& job) {
+  Image image;
+  try {
+    if (!image_pool.load(image, *job.package, job.filename)) return;
+  } catch (...) {
+    return; // the error is reported when the image is loaded for real
+  }
+  wxMutexLocker lock(mutex);
+  decoded_bytes += image_bytes(image);
+  ++images_decoded;
+}
+
+void PackagePrefetcher::run(Worker& worker) {
+  while (true) {
+    String   package;
+    ImageJob image;
+    {
+      wxMutexLocker lock(mutex);
+      if (!stopping && !packages.empty()) {
+        package = packages.front();
+        packages.pop_front();
+      } else if (!stopping && !images.empty() && decoded_bytes < image_pool.stats().max_bytes / 2) {
+        image = images.front();
+        images.pop_front();
+      } else {
+        // out of jobs, or out of memory for images
+        images.clear();
+        worker.done = true;
+        bool last = true;
+        for (size_t i = 0 ; i < workers.size() ; ++i) {
+          if (!workers[i]->done) last = false;
+        }
+        if (last && !stopping) {
+          wxLogDebug(_("Prefetched %d packages and %d images in %ld ms"), packages_loaded, images_decoded, timer.Time());
+        }
+        return;
+      }
+    }
+    if (!package.empty()) {
+      loadPackage(package);
+    } else {
+      decodeImage(image);
+    }
+  }
+}
+
+wxThread::ExitCode PackagePrefetcher::Worker::Entry() {
+  owner.run(*this);
+  return 0;
+}
+
+// ----------------------------------------------------------------------------- : PackageHeader
+
+PackageHeader::PackageHeader()
+  : modified(0), position_hint(100000)
+{}
+
+void PackageHeader::update(const Packaged& package) {
+  version       = package.version;
+  short_name    = package.short_name;
+  full_name     = package.full_name;
+  icon_filename = package.icon_filename;
+  position_hint = package.position_hint;
+  dependencies  = package.dependencies;
+}
+
+String PackageHeader::name() const {
+  size_t ext = filename.find_last_of(_('.'));
+  if (ext == String::npos) return filename;
+  else                     return filename.substr(0,ext);
+}
+
+InputStreamP PackageHeader::openIconFile() const {
+  if (icon_filename.empty()) return InputStreamP();
+  Package package;
+  package.open(absoluteFilename(), true);
+  return package.openIn(icon_filename);
+}
+
+IMPLEMENT_REFLECTION_NO_SCRIPT(PackageHeader) {
+  REFLECT(filename);
+  REFLECT(modified);
+  REFLECT(version);
+  REFLECT(short_name);
+  REFLECT(full_name);
+  REFLECT(icon_filename);
+  REFLECT(position_hint);
+  REFLECT_N("depends ons", dependencies);
+}
+
 // ----------------------------------------------------------------------------- : PackageVersion
 
 template <> void Writer::handle(const PackageVersion::FileInfo& f) {
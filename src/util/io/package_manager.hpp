@@ -12,10 +12,13 @@
 #include <util/prec.hpp>
 #include <util/io/package.hpp>
 #include <wx/filename.h>
+#include <wx/thread.h>
+#include <deque>
 
 DECLARE_POINTER_TYPE(Packaged);
 DECLARE_POINTER_TYPE(PackageVersion);
 DECLARE_POINTER_TYPE(InstallablePackage);
+DECLARE_POINTER_TYPE(PackageHeader);
 class PackageDependency;
 
 // ----------------------------------------------------------------------------- : PackageVersion
@@ -55,6 +58,56 @@ IMPLEMENT_REFLECTION_NO_SCRIPT(UpdateData) {
 }
 */
 
+// ----------------------------------------------------------------------------- : PackageHeader
+
+/// The header of an installed package, as far as it is needed to show the package in a list
+/** Package directories keep an index of these headers, so packages don't have to be opened to list them.
+ */
+class PackageHeader : public IntrusivePtrBase<PackageHeader> {
+  public:
+  PackageHeader();
+  
+  String  directory;       ///< Directory that contains the package (not stored in the index)
+  String  filename;        ///< Filename of the package, relative to the directory
+  double  modified;        ///< Modification time of the package when the header was read, 0 if it is not read yet
+  Version version;         ///< Version number of the package
+  String  short_name;      ///< Short name of the package
+  String  full_name;       ///< Name of the package, for menus etc.
+  String  icon_filename;   ///< Filename of icon to use in package lists
+  int     position_hint;   ///< A hint for the package list
+  vector<PackageDependencyP> dependencies; ///< Dependencies of the package
+  
+  /// Copy the header of an opened package
+  void update(const Packaged& package);
+  
+  inline String absoluteFilename() const { return directory + _("/") + filename; }
+  inline const String& relativeFilename() const { return filename; }
+  /// The filename without extension, as Package::name()
+  String name() const;
+  
+  /// Get an input stream for the package icon, if there is any
+  /** Only the package is opened, its header is not read */
+  InputStreamP openIconFile() const;
+  
+  DECLARE_REFLECTION();
+};
+
+/// The headers of the packages in a directory
+/** The index is stored in the user settings directory.
+ *  The list of packages stays valid as long as the modification time of the directory doesn't change,
+ *  a header stays valid as long as the modification time of its package doesn't change.
+ */
+class PackageIndex {
+  public:
+  PackageIndex() : loaded(false), modified(0) {}
+  
+  bool   loaded;
+  double modified;                 ///< Modification time of the directory when the packages were listed
+  vector<PackageHeaderP> packages; ///< All packages in the directory, sorted by filename
+  
+  DECLARE_REFLECTION();
+};
+
 // ----------------------------------------------------------------------------- : PackageDirectory
 
 /// A directory for packages
@@ -75,6 +128,9 @@ class PackageDirectory {
   
   /// Find all packages that match a filename pattern (using wxFindFirst)
   String findFirstMatching(const String& pattern) const;
+  /// Find the headers of all packages that match a filename pattern, using the package index
+  /** Only the headers of packages that changed since they were indexed are read */
+  void findMatchingHeaders(const String& pattern, vector<PackageHeaderP>& out);
   
   /// Get all installed packages
   void installedPackages(vector<InstallablePackageP>& packages);
@@ -93,22 +149,92 @@ class PackageDirectory {
   bool   is_local;
   String directory;
   vector<PackageVersionP> packages; // sorted by name
+  PackageIndex index;
   
   String databaseFile();
+  String indexFile();
+  void loadIndex();
+  void saveIndex();
   // Do the actual installation of a package
   bool actual_install(const InstallablePackage& package, const String& install_dir);
   
   DECLARE_REFLECTION();
 };
 
+// ----------------------------------------------------------------------------- : PackagePrefetcher
+
+/// Loads the packages that a package depends on with worker threads, before they are needed
+/** The dependencies are followed recursively, but only include packages and symbol fonts are prefetched,
+ *  the other types of packages are loaded when they are used.
+ *  After the packages, the images that the card styles of a stylesheet use can be decoded into the image_pool,
+ *  until the decoded images use half of the memory of the pool.
+ *  Errors are ignored, they are reported when the package or image is actually used.
+ */
+class PackagePrefetcher {
+  public:
+  PackagePrefetcher();
+  ~PackagePrefetcher();
+  
+  /// Start loading the dependencies of a package, including their dependencies
+  /** The given images in the package itself are also decoded, those that are not in the package are skipped */
+  void prefetch(const PackagedP& package, const vector<String>& image_files);
+  /// Stop prefetching, wait for the worker threads, and forget what was prefetched
+  void finish();
+  
+  private:
+  class Worker : public wxThread {
+    public:
+    Worker(PackagePrefetcher& owner) : wxThread(wxTHREAD_JOINABLE), owner(owner), done(false) {}
+    virtual ExitCode Entry();
+    PackagePrefetcher& owner;
+    bool               done; ///< Has the thread run out of work? guarded by owner.mutex
+  };
+  struct ImageJob {
+    PackagedP package;
+    String    filename;
+  };
+  
+  wxMutex         mutex;
+  deque<String>   packages;      ///< Names of the packages to load
+  deque<ImageJob> images;        ///< Images to decode, after the packages
+  set<String>     queued;        ///< All packages that were queued before
+  vector<Worker*> workers;
+  size_t          decoded_bytes; ///< Memory used by the images decoded so far
+  bool            stopping;
+  // statistics, reported when all jobs are done
+  wxStopWatch     timer;
+  int             packages_loaded, images_decoded;
+  
+  /// Queue the dependencies of a package, mutex must be locked
+  void queueDependencies(const Packaged& package);
+  /// Start enough threads for the queued jobs, mutex must be locked
+  void startWorkers();
+  /// Load a package and queue its dependencies, ignoring errors
+  void loadPackage(const String& name);
+  /// Decode an image into the image pool, ignoring errors
+  void decodeImage(const ImageJob& job);
+  /// Run jobs until there are none left
+  void run(Worker& worker);
+};
+
 // ----------------------------------------------------------------------------- : PackageManager
 
+/// Thrown on a background thread that gives up loading a package, because waiting for it would deadlock
+/** This is not an Error, nothing is reported; the package is loaded by the thread that needs it. */
+class PackageLoadAbandoned {};
+
 /// Package manager, loads data files from the default data directory.
 /** The PackageManager ensures that each package is only loaded once.
  *  There is a single global instance of the PackageManager, called packages
+ *
+ *  Packages can be opened from any thread.
+ *  A thread that opens a package that another thread is loading waits until it is loaded.
+ *  If that other thread is (indirectly) waiting for this one, then one of the background threads throws PackageLoadAbandoned,
+ *  so the main thread never gives up. Only a package that is opened recursively while loading it is returned partially loaded.
  */
 class PackageManager {
   public:
+  PackageManager();
   /// Initialize the package manager
   void init();
   /// Empty the list of packages.
@@ -137,9 +263,15 @@ class PackageManager {
    */
   PackagedP openAny(const String& name, bool just_header = false);
   
-  /// Find all packages that match a filename pattern, store them in out
-  /** Only reads the package headers */
-  void findMatching(const String& pattern, vector<PackagedP>& out);
+  /// Load the dependencies of a package in the background, see PackagePrefetcher
+  inline void prefetch(const PackagedP& package, const vector<String>& images = vector<String>()) {
+    prefetcher.prefetch(package, images);
+  }
+  
+  /// Find all packages that match a filename pattern, store their headers in out
+  /** The packages are not opened, use openAny(header->absoluteFilename()) for that.
+   *  Local packages take precedence over global ones with the same name. */
+  void findMatching(const String& pattern, vector<PackageHeaderP>& out);
   
   /// Open a file from a package, with a name encoded as "/package/file"
   /** If 'package' is set then:
@@ -178,8 +310,17 @@ class PackageManager {
   // --------------------------------------------------- : Packages on a server
   
   private:
+  wxMutex                mutex;           ///< Guards loaded_packages, loading, waiting_for and abandoning
+  wxCondition            loaded;          ///< Signaled when a thread is done loading a package
   map<String, PackagedP> loaded_packages;
+  map<const Packaged*, wxThreadIdType> loading;     ///< Packages that are being loaded, and by which thread
+  map<wxThreadIdType, const Packaged*> waiting_for; ///< Threads waiting for a package to be loaded by another thread
+  set<wxThreadIdType>                  abandoning;  ///< Waiting threads that must give up loading, because the main thread needs their package
   PackageDirectory local, global;
+  PackagePrefetcher prefetcher;
+  
+  /// Would waiting until a package is loaded by another thread lead to a deadlock? mutex must be locked
+  bool waitWouldDeadlock(const Packaged* package, wxThreadIdType self) const;
 };
 
 /// The global PackageManager instance
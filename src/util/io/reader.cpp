@@ -11,6 +11,7 @@
 #include <util/vector2d.hpp>
 #include <util/error.hpp>
 #include <util/io/package_manager.hpp>
+#include <wx/mstream.h>
 #include <boost/logic/tribool.hpp>
 #undef small
 using boost::tribool;
@@ -19,13 +20,78 @@ typedef void (*ReaderPragmaHandler)(String&);
 DECLARE_DYNAMIC_ARG  (ReaderPragmaHandler,reader_pragma_handler);
 IMPLEMENT_DYNAMIC_ARG(ReaderPragmaHandler,reader_pragma_handler,nullptr);
 
+// ----------------------------------------------------------------------------- : KeyIndex
+
+/// Hash of a name, treating '_' and ' ' as the same character
+size_t key_index_hash(const String& name) {
+  size_t hash = 2166136261u;
+  for (size_t i = 0 ; i < name.size() ; ++i) {
+    Char c = name.GetChar(i);
+    if (c == _('_')) c = _(' ');
+    hash = (hash ^ (size_t)c) * 16777619u;
+  }
+  return hash;
+}
+
+/// Are two names equal, treating '_' and ' ' as the same character?
+bool key_index_equal(const String& a, const String& b) {
+  if (a.size() != b.size()) return false;
+  for (size_t i = 0 ; i < a.size() ; ++i) {
+    Char ca = a.GetChar(i), cb = b.GetChar(i);
+    if (ca != cb && !((ca == _('_') || ca == _(' ')) && (cb == _('_') || cb == _(' ')))) return false;
+  }
+  return true;
+}
+
+void KeyIndex::clear() {
+  slots.clear();
+  count = added = 0;
+}
+
+size_t KeyIndex::slotFor(const String& name) const {
+  size_t mask = slots.size() - 1;
+  size_t i = key_index_hash(name) & mask;
+  while (slots[i].index != npos && !key_index_equal(slots[i].name, name)) {
+    i = (i + 1) & mask;
+  }
+  return i;
+}
+
+void KeyIndex::add(const String& name, size_t index) {
+  added += 1;
+  // keep the table at most half full
+  if (2 * (count + 1) > slots.size()) {
+    vector<Slot> old_slots;
+    swap(old_slots, slots);
+    Slot empty;
+    empty.index = npos;
+    slots.resize(max((size_t)16, 2 * old_slots.size()), empty);
+    count = 0;
+    for (size_t i = 0 ; i < old_slots.size() ; ++i) {
+      if (old_slots[i].index != npos) add(old_slots[i].name, old_slots[i].index);
+    }
+    added -= count;
+  }
+  Slot& slot = slots[slotFor(name)];
+  if (slot.index == npos) {
+    slot.name  = name;
+    slot.index = index;
+    count += 1;
+  }
+}
+
+size_t KeyIndex::find(const String& name) const {
+  if (slots.empty()) return npos;
+  return slots[slotFor(name)].index;
+}
+
 // ----------------------------------------------------------------------------- : Reader
 
 Reader::Reader(const InputStreamP& input, Packaged* package, const String& filename, bool ignore_invalid)
   : indent(0), expected_indent(0), state(OUTSIDE)
   , ignore_invalid(ignore_invalid)
   , filename(filename), package(package), line_number(0), previous_line_number(0)
-  , input(input)
+  , lines(input)
 {
   moveNext();
   handleAppVersion();
@@ -35,7 +101,7 @@ Reader::Reader(Reader* parent, Packaged* pkg, const String& filename, bool ignor
   : indent(0), expected_indent(0), state(OUTSIDE)
   , ignore_invalid(ignore_invalid)
   , filename(filename), package(pkg), line_number(0), previous_line_number(0)
-  , input(package_manager.openFileFromPackage(package, filename))
+  , lines(package_manager.openFileFromPackage(package, filename))
 {
   moveNext();
   // in an included file, use the app version of the parent if we have none
@@ -45,7 +111,20 @@ Reader::Reader(Reader* parent, Packaged* pkg, const String& filename, bool ignor
   }
 }
 
+Reader::Reader(const Reader* parent)
+  : file_app_version(parent->file_app_version)
+  , indent(-1), expected_indent(0), state(OUTSIDE)
+  , aliasses(parent->aliasses), added_aliasses(parent->added_aliasses)
+  , ignore_invalid(parent->ignore_invalid)
+  , filename(parent->filename), package(parent->package), line_number(0), previous_line_number(0)
+  , lines(InputStreamP())
+{}
+
 void Reader::addAlias(Version end_version, const Char* a, const Char* b) {
+  pair<const Char*, Version>& added = added_aliasses[a];
+  if (added.first == b && added.second == end_version) return; // nothing changes
+  added.first  = b;
+  added.second = end_version;
   Alias& alias = aliasses[a];
   alias.new_key     = b;
   alias.end_version = end_version;
@@ -73,6 +152,10 @@ void Reader::warning(const String& msg, int line_number_delta, bool warn_on_prev
            << _(": \t") << msg;
 }
 
+void Reader::addWarnings(const ReaderBlock& block) {
+  warnings += block.warnings;
+}
+
 void Reader::showWarnings() {
   if (!warnings.empty()) {
     queue_message(MESSAGE_WARNING, _("Warnings while reading file:\n") + filename + _("\n") + warnings);
@@ -120,72 +203,85 @@ void Reader::moveNext() {
   key.clear();
   indent = -1; // if no line is read it never has the expected indentation
   // repeat until we have a good line
-  while (key.empty() && !input->Eof()) {
+  while (key.empty() && !lines.eof()) {
     readLine();
   }
   // did we reach the end of the file?
-  if (key.empty() && input->Eof()) {
+  if (key.empty() && lines.eof()) {
     line_number += 1;
     indent = -1;
   }
 }
 
-/// Faster vector, uses large local storage
-/** Usually a line from a file doesn't use very many characters.
- *  In that case, allocating a vector is a waste of resources.
- *  2007-09-21: Profiling => Using this class roughly halves the runtime of read_utf8_line,
- *              making startup slightly faster.
- */
-template <typename T> class LocalVector {
-  public:
-  LocalVector() : the_size(0), alloced(SMALL_SIZE), buffer(small) {}
-  ~LocalVector() { if (buffer != small) free(buffer); }
-  void push_back(T t) {
-    if (the_size >= alloced) {
-      // double buffer size
-      if (buffer != small) {
-        buffer = (T*)realloc(buffer, sizeof(T) * alloced * 2);
-      } else {
-        buffer = (T*)malloc(sizeof(T) * alloced * 2);
-        memcpy(buffer, small, alloced * sizeof(T));
-      }
-      alloced *= 2;
+// ----------------------------------------------------------------------------- : LineReader
+
+/// Size of the blocks read from the input stream
+const size_t line_reader_block_size = 64 * 1024;
+
+LineReader::LineReader(const InputStreamP& input)
+  : input(input), buffer(line_reader_block_size)
+  , start(0), end(0), at_eof(false), input_done(false)
+{}
+
+void LineReader::reset(const InputStreamP& input) {
+  this->input = input;
+  start = end = 0;
+  at_eof = input_done = false;
+}
+
+size_t LineReader::refill() {
+  size_t moved = start;
+  if (start > 0) {
+    memmove(&buffer[0], &buffer[start], end - start);
+    end  -= start;
+    start = 0;
+  }
+  // keep room for a terminating 0, a line that doesn't fit needs a bigger buffer
+  if (end + 1 >= buffer.size()) {
+    buffer.resize(buffer.size() * 2);
+  }
+  input->Read(&buffer[end], buffer.size() - end - 1);
+  size_t read = input->LastRead();
+  if (read == 0) input_done = true;
+  end += read;
+  return moved;
+}
+
+char* LineReader::readLine(size_t& size) {
+  size_t i = start; // everything before i has been searched for line endings
+  while (true) {
+    char* data = &buffer[0];
+    for ( ; i < end ; ++i) {
+      char c = data[i];
+      if (c != '\n' && c != '\r') continue;
+      if (c == '\r' && i + 1 == end && !input_done) break; // this could be the first half of "\r\n"
+      char* line = data + start;
+      size  = i - start;
+      start = i + 1;
+      if (c == '\r' && start < end && data[start] == '\n') start += 1;
+      data[i] = '\0';
+      return line;
+    }
+    if (input_done) {
+      // the last line, not terminated by a newline
+      char* line = data + start;
+      size  = end - start;
+      start = end;
+      data[end] = '\0'; // refill always leaves room for this
+      at_eof = true;
+      return line;
     }
-    buffer[the_size++] = t;
+    i -= refill();
   }
-  inline const T* get() const { return buffer; }
-  inline size_t size() const { return the_size; }
-  private:
-  static const int SMALL_SIZE = 1024;
-  size_t the_size, alloced;
-  T* buffer;
-  T small[SMALL_SIZE];
-};
+}
 
-/// Read an UTF-8 encoded line from an input stream
+// ----------------------------------------------------------------------------- : UTF-8
+
+/// Convert 0 terminated UTF-8 data to a String
 /** As opposed to wx functions, this one actually reports errors
  */
-String read_utf8_line(wxInputStream& input, bool eat_bom = true, bool until_eof = false);
-String read_utf8_line(wxInputStream& input, bool eat_bom, bool until_eof) {
-  LocalVector<char> buffer;
-  while (!input.Eof()) {
-    Byte c = input.GetC(); if (input.LastRead() <= 0) break;
-    if (!until_eof) {
-      if (c == '\n') break;
-      if (c == '\r') {
-        if (input.Eof()) break;
-        c = input.GetC(); if (input.LastRead() <= 0) break;
-        if (c != '\n') {
-          input.Ungetch(c); // \r but not \r\n
-        }
-        break; 
-      }
-    }
-    buffer.push_back(c);
-  }
-  // convert to string
-  buffer.push_back('\0');
-  size_t size = wxConvUTF8.MB2WC(nullptr, buffer.get(), 0);
+String decode_utf8(const char* data, size_t data_size, bool eat_bom) {
+  size_t size = wxConvUTF8.MB2WC(nullptr, data, 0);
   if (size == size_t(-1)) {
     throw ParseError(_("Invalid UTF-8 sequence"));
   } else if (size == 0) {
@@ -193,13 +289,13 @@ String read_utf8_line(wxInputStream& input, bool eat_bom, bool until_eof) {
   }
   #ifdef UNICODE
     #if wxVERSION_NUMBER >= 2900
-      String result = wxString::FromUTF8(buffer.get(), buffer.size());
+      String result = wxString::FromUTF8(data, data_size);
       return eat_bom ? decodeUTF8BOM(result) : result;
     #else
       // NOTE: wx doc is wrong, parameter to GetWritableChar is numer of characters, not bytes
       String result;
       Char* result_buf = result.GetWriteBuf(size + 1);
-      wxConvUTF8.MB2WC(result_buf, buffer.get(), size + 1);
+      wxConvUTF8.MB2WC(result_buf, data, size + 1);
       result.UngetWriteBuf(size);
       return eat_bom ? decodeUTF8BOM(result) : result;
     #endif
@@ -207,7 +303,7 @@ String read_utf8_line(wxInputStream& input, bool eat_bom, bool until_eof) {
     String result;
     // first to wchar, then back to local
     vector<wchar_t> buf2; buf2.resize(size+1);
-    wxConvUTF8.MB2WC(&buf2[0], buffer.get(), size + 1);
+    wxConvUTF8.MB2WC(&buf2[0], data, size + 1);
     // eat BOM?
     if (eat_bom && buf2[0]==0xFEFF ) {
       buf2.erase(buf2.begin()); // remove BOM
@@ -234,16 +330,93 @@ String read_utf8_line(wxInputStream& input, bool eat_bom, bool until_eof) {
   #endif
 }
 
+/// Is all the data plain ASCII?
+inline bool is_ascii(const char* data, size_t size) {
+  // a plain loop without early exit, so the compiler can vectorize it
+  Byte all = 0;
+  for (size_t i = 0 ; i < size ; ++i) {
+    all |= (Byte)data[i];
+  }
+  return all < 0x80;
+}
+
+/// Store 0 terminated UTF-8 data in a String, reusing its memory if possible
+void assign_utf8(String& out, const char* data, size_t size) {
+  if (is_ascii(data, size)) {
+    out.clear();
+    for (size_t i = 0 ; i < size ; ++i) {
+      out += (Char)data[i];
+    }
+  } else {
+    out = decode_utf8(data, size, false);
+  }
+}
+
+/// Read an UTF-8 encoded line from an input stream
+/** As opposed to wx functions, this one actually reports errors
+ */
+String read_utf8_line(wxInputStream& input, bool eat_bom = true, bool until_eof = false);
+String read_utf8_line(wxInputStream& input, bool eat_bom, bool until_eof) {
+  vector<char> buffer;
+  if (until_eof) {
+    // read everything in large blocks
+    while (!input.Eof()) {
+      size_t size = buffer.size();
+      buffer.resize(size + line_reader_block_size);
+      input.Read(&buffer[size], line_reader_block_size);
+      buffer.resize(size + input.LastRead());
+      if (input.LastRead() == 0) break;
+    }
+  } else {
+    while (!input.Eof()) {
+      Byte c = input.GetC(); if (input.LastRead() <= 0) break;
+      if (c == '\n') break;
+      if (c == '\r') {
+        if (input.Eof()) break;
+        c = input.GetC(); if (input.LastRead() <= 0) break;
+        if (c != '\n') {
+          input.Ungetch(c); // \r but not \r\n
+        }
+        break; 
+      }
+      buffer.push_back(c);
+    }
+  }
+  // convert to string
+  size_t size = buffer.size();
+  buffer.push_back('\0');
+  return decode_utf8(&buffer[0], size, eat_bom);
+}
+
+// ----------------------------------------------------------------------------- : Reading lines
+
 void Reader::readLine(bool in_string) {
   line_number += 1;
-  // We have to do our own line reading, because wxTextInputStream is insane
+  size_t size;
+  char* data = lines.readLine(size);
+  // skip byte order mark
+  if (line_number == 1 && size >= 3 && (Byte)data[0] == 0xEF && (Byte)data[1] == 0xBB && (Byte)data[2] == 0xBF) {
+    data += 3;
+    size -= 3;
+  }
+  splitLine(data, size, in_string);
+}
+
+void Reader::splitLine(char* data, size_t size, bool in_string) {
+  // We have to do our own line decoding, because wxTextInputStream is insane
   try {
-    line = read_utf8_line(*input, line_number == 1);
+    // most lines are simple key/value pairs, these are split up without converting the whole line
+    if (!in_string && !reader_pragma_handler() && parseLineFast(data, size)) return;
+    line = decode_utf8(data, size, false);
   } catch (const ParseError& e) {
     throw ParseError(e.what() + String(_(" on line ")) << line_number);
   }
   // pragma handler
   if (reader_pragma_handler()) reader_pragma_handler()(line);
+  parseLine(in_string);
+}
+
+void Reader::parseLine(bool in_string) {
   // read indentation
   indent = 0;
   while ((UInt)indent < line.size() && line.GetChar(indent) == _('\t')) {
@@ -270,6 +443,54 @@ void Reader::readLine(bool in_string) {
   if (key.empty() && pos!=String::npos) key = _(" "); // we don't want an empty key if there was a colon
 }
 
+inline bool is_space_or_tab(char c) {
+  return c == ' ' || c == '\t';
+}
+
+bool Reader::parseLineFast(char* data, size_t size) {
+  // read indentation
+  size_t pos = 0;
+  while (pos < size && data[pos] == '\t') ++pos;
+  // empty line or comment
+  size_t first = pos;
+  while (first < size && is_space_or_tab(data[first])) ++first;
+  if (first == size || data[pos] == '#') {
+    indent = (int)pos;
+    key.clear();
+    return true;
+  }
+  // a key starting with a space gets a warning, leave that to parseLine
+  if (data[pos] == ' ' && !ignore_invalid) return false;
+  indent = (int)pos;
+  // find the key, same as canonical_name_form(trim(key)), but in place
+  char* colon = (char*)memchr(data + pos, ':', size - pos);
+  size_t key_end   = colon ? colon - data : size;
+  size_t key_start = first;
+  while (key_end > key_start && is_space_or_tab(data[key_end - 1])) --key_end;
+  bool leading = true;
+  for (size_t i = key_start ; i < key_end ; ++i) {
+    if (data[i] == '_' || data[i] == ' ') {
+      if (!leading) data[i] = ' ';
+    } else {
+      leading = false;
+    }
+  }
+  char after_key = data[key_end];
+  data[key_end] = '\0';
+  assign_utf8(key, data + key_start, key_end - key_start);
+  data[key_end] = after_key;
+  // the value, after the colon
+  if (colon) {
+    size_t value_start = colon - data + 1;
+    while (value_start < size && is_space_or_tab(data[value_start])) ++value_start;
+    assign_utf8(value, data + value_start, size - value_start);
+    if (key.empty()) key = _(" "); // we don't want an empty key if there was a colon
+  } else {
+    value.clear();
+  }
+  return true;
+}
+
 void Reader::unknownKey() {
   // ignore?
   if (ignore_invalid) {
@@ -307,6 +528,103 @@ void Reader::unknownKey() {
   // else: could be a nameless value, which doesn't call exitBlock to move past its own key
 }
 
+// ----------------------------------------------------------------------------- : Blocks
+
+/// Does a line (after the indentation) start with the given key?
+bool starts_with_key(const char* data, size_t size, const Char* key) {
+  size_t i = 0;
+  for ( ; *key ; ++key, ++i) {
+    if (i >= size) return false;
+    Char c = (Byte)data[i];
+    if (c != *key && !(c == _(' ') && *key == _('_'))) return false;
+  }
+  while (i < size && is_space_or_tab(data[i])) ++i;
+  return i == size || data[i] == ':';
+}
+
+bool Reader::captureBlock(const Char* name, ReaderBlock& block, const Char* main_thread_key) {
+  if (!enterBlock(name)) return false;
+  block.data.clear();
+  block.line_number = line_number;
+  block.indent      = expected_indent;
+  block.main_thread = false;
+  block.warnings.clear();
+  // the block consists of the lines that are indented more than its key,
+  // and the empty lines and comments between them
+  while (!lines.eof()) {
+    size_t size;
+    char* data = lines.readLine(size);
+    line_number += 1;
+    // indentation, as determined by splitLine
+    size_t tabs = 0;
+    while (tabs < size && data[tabs] == '\t') ++tabs;
+    size_t pos = tabs;
+    int line_indent = (int)tabs;
+    if (!ignore_invalid) {
+      // 8 spaces is a tab
+      while (pos + 8 <= size && memcmp(data + pos, "        ", 8) == 0) {
+        pos += 8;
+        line_indent += 1;
+      }
+    }
+    size_t first = pos;
+    while (first < size && is_space_or_tab(data[first])) ++first;
+    bool empty = first == size || data[tabs] == '#';
+    if (!empty && line_indent < expected_indent) {
+      // this is the next key after the block
+      previous_line_number = line_number - 1;
+      splitLine(data, size, false);
+      expected_indent -= 1;
+      previous_value.clear();
+      state = HANDLED;
+      return true;
+    }
+    if (!empty && !block.main_thread) {
+      if (starts_with_key(data + first, size - first, _("include file"))) {
+        block.main_thread = true;
+      } else if (main_thread_key && line_indent == expected_indent) {
+        // the key itself, or an alias for it
+        block.main_thread = starts_with_key(data + first, size - first, main_thread_key);
+        for (map<String,Alias>::const_iterator it = aliasses.begin() ; it != aliasses.end() && !block.main_thread ; ++it) {
+          if (cannocial_name_compare(it->second.new_key, main_thread_key)) {
+            block.main_thread = starts_with_key(data + first, size - first, it->first.c_str());
+          }
+        }
+      }
+    }
+    block.data.append(data, size);
+    block.data += '\n';
+  }
+  // end of the file
+  previous_line_number = line_number;
+  line_number += 1;
+  key.clear();
+  indent = -1;
+  expected_indent -= 1;
+  previous_value.clear();
+  state = HANDLED;
+  return true;
+}
+
+void Reader::startBlock(const ReaderBlock& block) {
+  lines.reset(shared(new wxMemoryInputStream(block.data.data(), block.data.size())));
+  line_number     = block.line_number;
+  expected_indent = block.indent;
+  warnings.clear();
+  moveNext();
+}
+
+void Reader::endBlock(ReaderBlock& block) {
+  block.warnings = warnings;
+  warnings.clear();
+}
+
+bool Reader::skipBlock() {
+  if (!enterAnyBlock()) return false;
+  exitBlock();
+  return true;
+}
+
 // ----------------------------------------------------------------------------- : Handling basic types
 
 void Reader::unhandle() {
@@ -326,7 +644,7 @@ const String& Reader::getValue() {
     // read all lines that are indented enough
     readLine(true);
     previous_line_number = line_number;
-    while (indent >= expected_indent && !input->Eof()) {
+    while (indent >= expected_indent && !lines.eof()) {
       previous_value.resize(previous_value.size() + pending_newlines, _('\n'));
       pending_newlines = 0;
       previous_value += line.substr(expected_indent); // strip expected indent
@@ -334,15 +652,15 @@ const String& Reader::getValue() {
         readLine(true);
         pending_newlines++;
         // skip empty lines that are not indented enough
-      } while(trim(line).empty() && indent < expected_indent && !input->Eof());
+      } while(trim(line).empty() && indent < expected_indent && !lines.eof());
     }
     // moveNext(), but without the initial readLine()
     state = HANDLED;
-    while (key.empty() && !input->Eof()) {
+    while (key.empty() && !lines.eof()) {
       readLine();
     }
     // did we reach the end of the file?
-    if (key.empty() && input->Eof()) {
+    if (key.empty() && lines.eof()) {
       line_number += 1;
       indent = -1;
     }
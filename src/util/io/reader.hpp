@@ -18,11 +18,88 @@ DECLARE_POINTER_TYPE(Game);
 DECLARE_POINTER_TYPE(StyleSheet);
 class Packaged;
 
+// ----------------------------------------------------------------------------- : KeyIndex
+
+/// A hash table from key names to indices
+/** Used by the Reader to go directly to the value in an IndexMap for a key,
+ *  instead of comparing the key with the name of every value.
+ *  Names are compared as with cannocial_name_compare, but without distinguishing '_' and ' ',
+ *  so a found index can still be a false match.
+ */
+class KeyIndex {
+  public:
+  inline KeyIndex() : count(0), added(0) {}
+  
+  static const size_t npos = (size_t)-1;
+  
+  /// Number of names that were added, including duplicates
+  inline size_t size() const { return added; }
+  /// Remove all names
+  void clear();
+  /// Add a name, if it is already in the table the first index is kept
+  void add(const String& name, size_t index);
+  /// Find the index of a name, or npos if it is not in the table
+  size_t find(const String& name) const;
+  
+  private:
+  struct Slot {
+    String name;
+    size_t index;
+  };
+  vector<Slot> slots; ///< Open addressing, the size is a power of two, empty slots have index npos
+  size_t count; ///< Number of used slots
+  size_t added;
+  
+  /// The slot for a name, it is either empty or contains that name
+  size_t slotFor(const String& name) const;
+};
+
+// ----------------------------------------------------------------------------- : ReaderBlock
+
+/// The lines of a block in a file, captured by Reader::captureBlock to be read later
+/** Blocks can be read by another Reader with readBlock, possibly on another thread.
+ */
+struct ReaderBlock {
+  std::string data;        ///< The lines of the block, in UTF-8
+  int         line_number; ///< Line number of the key of the block
+  int         indent;      ///< Indentation of the lines in the block
+  bool        main_thread; ///< Should the block be read on the main thread?
+  String      warnings;    ///< Warnings from reading the block, to be added with Reader::addWarnings
+};
+
 // ----------------------------------------------------------------------------- : Reader
 
 typedef wxInputStream  InputStream;
 typedef shared_ptr<wxInputStream> InputStreamP;
 
+/// Splits an input stream into lines, reading it in large blocks
+/** Lines are returned as pointers into the buffer, they stay valid until the next call to readLine.
+ *  Lines can end in "\n", "\r\n" or "\r", the line ending is not included.
+ */
+class LineReader {
+  public:
+  LineReader(const InputStreamP& input);
+  
+  /// Start reading from another input stream, keeping the buffer
+  void reset(const InputStreamP& input);
+  /// Read the next line, returns a pointer to its first byte and sets size to its length
+  char* readLine(size_t& size);
+  /// Has the last line been read?
+  /** Just like wxInputStream::Eof, this only becomes true when a line ends at the end of the stream */
+  inline bool eof() const { return at_eof; }
+  
+  private:
+  InputStreamP input;
+  vector<char> buffer;
+  size_t start, end;  ///< Range of unread data in the buffer
+  bool   at_eof;      ///< Has the last line been returned?
+  bool   input_done;  ///< Has everything been read from the input stream?
+  
+  /// Move the unread data to the front of the buffer, and read more after it
+  /** Returns the number of bytes the data was moved by */
+  size_t refill();
+};
+
 /// The Reader can be used for reading (deserializing) objects
 /** This class makes use of the reflection functionality, in effect
  *  an object tells the Reader what fields it would like to read.
@@ -43,6 +120,10 @@ class Reader {
   /** filename is used only for error messages
    */
   Reader(const InputStreamP& input, Packaged* package = nullptr, const String& filename = wxEmptyString, bool ignore_invalid = false);
+  /// Construct a reader that reads blocks captured by parent, with readBlock
+  /** The parent must not be used while this reader is reading
+   */
+  explicit Reader(const Reader* parent);
   
   ~Reader() { showWarnings(); }
   
@@ -64,6 +145,47 @@ class Reader {
   void warning(const String& msg, int line_number_delta = 0, bool warn_on_previous_line = true);
   /// Show all warning messages, but continue reading
   void showWarnings();
+  /// Add the warnings from reading a block, in the order the blocks appear in the file
+  void addWarnings(const ReaderBlock& block);
+  
+  // --------------------------------------------------- : Blocks
+  /// Capture the block with the given key under the cursor, without reading it
+  /** Returns false if there is no such block.
+   *  If the block contains an "include file" or a key main_thread_key (or an alias of it) directly inside it,
+   *  then the block is marked as main_thread.
+   */
+  bool captureBlock(const Char* name, ReaderBlock& block, const Char* main_thread_key = nullptr);
+  
+  /// Read a captured block into an object, as handle_greedy(object) would have done for the block
+  /** Warnings are stored in the block */
+  template <typename T>
+  void readBlock(ReaderBlock& block, T& object) {
+    startBlock(block);
+    try {
+      handle_greedy(object);
+    } catch (...) {
+      endBlock(block);
+      throw;
+    }
+    endBlock(block);
+  }
+  
+  /// Skip the block under the cursor, whatever its key is
+  /** Returns false if there is no block at the current level */
+  bool skipBlock();
+  
+  /// Read an object from a single value, as if that value was on the line with the given number
+  template <typename T>
+  void handleValue(const String& value, int value_line_number, T& object) {
+    State old_state = state;
+    int   old_line_number = previous_line_number;
+    previous_value       = value;
+    previous_line_number = value_line_number;
+    state = UNHANDLED;
+    handle(object);
+    state = old_state;
+    previous_line_number = old_line_number;
+  }
   
   // --------------------------------------------------- : Handling objects
   /// Handle an object that can read as much as it can eat
@@ -144,6 +266,11 @@ class Reader {
   };
   /// Aliasses for compatability
   map<String, Alias> aliasses;
+  /// The alias added by each call to addAlias, so the same alias is only stored once
+  /** Reflection adds its aliases again for every key it reads */
+  map<const Char*, pair<const Char*, Version> > added_aliasses;
+  /// Indices of names in IndexMaps, by the first key in the map
+  map<const void*, KeyIndex> key_indices;
   /// Should all invalid keys be ignored?
   bool ignore_invalid;
   
@@ -155,8 +282,8 @@ class Reader {
   int line_number;
   /// Line number of the previous_line
   int previous_line_number;
-  /// Input stream we are reading from
-  InputStreamP input;
+  /// Input we are reading lines from
+  LineReader lines;
   /// Accumulated warning messages
   String warnings;
   
@@ -173,10 +300,22 @@ class Reader {
   void moveNext();
   /// Reads the next line from the input, and stores it in line/key/value/indent
   void readLine(bool in_string = false);
+  /// Stores a line of UTF-8 data in line/key/value/indent
+  void splitLine(char* data, size_t size, bool in_string);
+  /// Split the line into key/value/indent, in_string is as for readLine
+  void parseLine(bool in_string);
+  /// Split a line of UTF-8 data into key/value/indent, without first converting it to a String
+  /** Returns false if the line needs the more careful handling of parseLine */
+  bool parseLineFast(char* data, size_t size);
   
   /// Return the value on the current line
   const String& getValue();
   
+  /// Start reading a captured block
+  void startBlock(const ReaderBlock& block);
+  /// Done reading a captured block
+  void endBlock(ReaderBlock& block);
+  
   /// No line was read, because nothing mathes the current key
   /** Maybe the key is "include file" */
   template <typename T>
@@ -233,8 +372,23 @@ void Reader::handle(map<String, V>& m) {
 
 template <typename K, typename V>
 void Reader::handle(IndexMap<K,V>& m) {
-  for (typename IndexMap<K,V>::iterator it = m.begin() ; it != m.end() ; ++it) {
-    handle(get_key_name(*it).c_str(), *it);
+  if (m.empty()) return;
+  KeyIndex& index = key_indices[get_key(m.at(0)).get()];
+  if (index.size() != m.size()) {
+    index.clear();
+    for (size_t i = 0 ; i < m.size() ; ++i) {
+      index.add(get_key_name(m.at(i)), i);
+    }
+  }
+  // read all keys that are in the map, looking them up instead of trying every value
+  while (true) {
+    if (state == ENTERED) moveNext(); // as in enterBlock
+    if (indent != expected_indent) return;
+    size_t i = index.find(key);
+    if (i == KeyIndex::npos) return;
+    const String& name = get_key_name(m.at(i));
+    if (!cannocial_name_compare(key, name.c_str())) return;
+    handle(name.c_str(), m.at(i));
   }
 }
 
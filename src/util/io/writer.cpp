@@ -12,6 +12,7 @@
 #include <util/error.hpp>
 #include <util/version.hpp>
 #include <util/io/package.hpp>
+#include <util/parallel.hpp>
 #include <boost/logic/tribool.hpp>
 using boost::tribool;
 
@@ -19,13 +20,38 @@ using boost::tribool;
 
 Writer::Writer(const OutputStreamP& output, Version file_app_version)
   : indentation(0)
-  , output(output), stream(*output)
+  , output(output)
+  , written_size(0), written_crc(0)
+  , recorded_keys(nullptr), record_indentation(0), record_start(0)
 {
-  stream.WriteString(BYTE_ORDER_MARK);
+  buffer = "\xEF\xBB\xBF"; // byte order mark
   handle(_("mse_version"), file_app_version);
 }
 
+Writer::Writer(int indentation)
+  : indentation(indentation)
+  , written_size(0), written_crc(0)
+  , recorded_keys(nullptr), record_indentation(0), record_start(0)
+{}
 
+Writer::~Writer() {
+  flush();
+}
+
+void Writer::flush() {
+  if (output && !buffer.empty()) {
+    output->Write(buffer.data(), buffer.size());
+    written_size += buffer.size();
+    written_crc   = update_crc32(written_crc, buffer.data(), buffer.size());
+    buffer.clear();
+  }
+}
+
+void Writer::recordKeys(vector<WrittenKey>* keys) {
+  recorded_keys = keys;
+  // the keys in the next block are two levels deeper
+  record_indentation = indentation + (int)pending_opened.size() + 2;
+}
 
 void Writer::enterBlock(const Char* name) {
   // don't write the key yet
@@ -35,6 +61,10 @@ void Writer::enterBlock(const Char* name) {
 void Writer::exitBlock() {
   if (pending_opened.empty()) {
     assert(indentation > 0);
+    if (recorded_keys && indentation == record_indentation) {
+      // the end of a recorded key
+      recorded_keys->back().text.assign(buffer, record_start, std::string::npos);
+    }
     indentation -= 1;
   } else {
     // this block was apparently empty, ignore it
@@ -48,18 +78,60 @@ void Writer::writePending() {
   for (size_t i = 0 ; i < pending_opened.size() ; ++i) {
     if (i > 0) {
       // before entering a sub-block, write a colon after the parent's name
-      stream.WriteString(_(":\n"));
+      buffer += ':';
+      writeNewline();
     }
     indentation += 1;
+    if (recorded_keys && indentation == record_indentation) {
+      recorded_keys->push_back(WrittenKey());
+      recorded_keys->back().key    = canonical_name_form(pending_opened[i]);
+      recorded_keys->back().simple = true;
+      record_start = buffer.size();
+    } else if (recorded_keys && indentation > record_indentation) {
+      recorded_keys->back().simple = false; // a child key
+    }
     writeIndentation();
-    writeUTF8(stream, canonical_name_form(pending_opened[i]));
+    write(canonical_name_form(pending_opened[i]));
   }
   pending_opened.clear();
 }
 
 void Writer::writeIndentation() {
-  for(int i = 1 ; i < indentation ; ++i) {
-    stream.PutChar(_('\t'));
+  if (indentation > 1) buffer.append(indentation - 1, '\t');
+}
+
+void Writer::write(const String& str) {
+  // most text is ASCII, which doesn't need converting
+  size_t size = str.size();
+  size_t old_size = buffer.size();
+  buffer.resize(old_size + size);
+  for (size_t i = 0 ; i < size ; ++i) {
+    Char c = str.GetChar(i);
+    if ((unsigned)c >= 0x80) {
+      buffer.resize(old_size);
+      wxCharBuffer utf8 = str.ToUTF8();
+      buffer.append(utf8.data(), utf8.length());
+      return;
+    }
+    buffer[old_size + i] = (char)c;
+  }
+}
+
+void Writer::writeNewline() {
+  // the same line endings as a wxTextOutputStream
+  #if defined(__WXMSW__)
+    buffer += "\r\n";
+  #else
+    buffer += '\n';
+  #endif
+}
+
+void Writer::referenceFile(const String& file) {
+  if (!output) {
+    // this is a part of the output of another writer, which references the file when it adds this part
+    referenced_files.push_back(file);
+  } else if (writing_package()) {
+    writing_package()->referenceFile(file);
   }
 }
 
@@ -70,10 +142,14 @@ void Writer::handle(const String& value) {
     throw InternalError(_("Can only write a value in a key that was just opened"));
   }
   writePending();
+  if (recorded_keys && indentation == record_indentation) {
+    recorded_keys->back().value = value;
+  }
   // write indentation and key
   if (value.find_first_of(_('\n')) != String::npos || (!value.empty() && isSpace(value.GetChar(0)))) {
     // multiline string, or contains leading whitespace
-    stream.WriteString(_(":\n"));
+    buffer += ':';
+    writeNewline();
     indentation += 1;
     // split lines, and write each line
     size_t start = 0, end, size = value.size();
@@ -81,10 +157,10 @@ void Writer::handle(const String& value) {
       end = value.find_first_of(_("\n\r"), start); // until end of line
       // write the line
       writeIndentation();
-      writeUTF8(stream, value.substr(start, end - start));
+      write(value.substr(start, end - start));
       // Skip \r and \n
       if (end == String::npos) break;
-      stream.PutChar(_('\n'));
+      writeNewline();
       start = end + 1;
       if (start < size) {
         Char c1 = value.GetChar(start - 1);
@@ -95,10 +171,10 @@ void Writer::handle(const String& value) {
     }
     indentation -= 1;
   } else {
-    stream.WriteString(_(": "));
-    writeUTF8(stream, value);
+    buffer += ": ";
+    write(value);
   }
-  stream.PutChar(_('\n'));
+  writeNewline();
 }
 
 template <> void Writer::handle(const int& value) {
@@ -143,8 +219,89 @@ template <> void Writer::handle(const FileName& value) {
     }
   } else {
     handle(static_cast<const String&>(value));
-    if (writing_package()) {
-      writing_package()->referenceFile(value);
+    referenceFile(value);
+  }
+}
+
+// ----------------------------------------------------------------------------- : Writing in parallel
+
+/// Minimum number of items before they are written on worker threads
+const size_t min_items_for_threads = 64;
+
+/// Writes items into separate buffers, using worker threads
+/** The main thread also writes items. Afterwards the buffers are added to the parent writer in order,
+ *  and the files they reference are referenced on the main thread.
+ */
+class ParallelWriter : private ParallelBody {
+  public:
+  ParallelWriter(Writer& parent, const Char* key, const void* items, size_t count, Writer::ItemWriter write_item);
+  
+  /// Write all items to the parent writer
+  void write();
+  
+  private:
+  Writer&                 parent;
+  const Char*             key;        ///< Key of each item
+  const void*             items;      ///< The items to write
+  Writer::ItemWriter      write_item;
+  vector<std::string>     buffers;    ///< The output of each item
+  vector<vector<String> > references; ///< The files referenced by each item
+  vector<ErrorP>          errors;     ///< Error from writing each item, if any
+  vector<char>            unknown;    ///< Did writing an item throw something that is not an Error?
+  
+  /// Write a single item
+  virtual void run(size_t i);
+};
+
+ParallelWriter::ParallelWriter(Writer& parent, const Char* key, const void* items, size_t count, Writer::ItemWriter write_item)
+  : parent(parent), key(key), items(items), write_item(write_item)
+  , buffers(count), references(count), errors(count), unknown(count, false)
+{}
+
+void ParallelWriter::run(size_t i) {
+  try {
+    Writer writer(parent.indentation);
+    write_item(writer, key, items, i);
+    buffers[i].swap(writer.buffer);
+    references[i].swap(writer.referenced_files);
+  } catch (const Error& e) {
+    errors[i] = ErrorP(e.clone());
+  } catch (...) {
+    // we can't keep this exception, the item is written again on the main thread to throw it there
+    unknown[i] = true;
+  }
+}
+
+void ParallelWriter::write() {
+  parallel_for(buffers.size(), min_items_for_threads, *this);
+  // results, in order
+  size_t size = parent.buffer.size();
+  for (size_t i = 0 ; i < buffers.size() ; ++i) size += buffers[i].size();
+  parent.buffer.reserve(size);
+  for (size_t i = 0 ; i < buffers.size() ; ++i) {
+    if (errors[i]) errors[i]->rethrow();
+    if (unknown[i]) {
+      Writer writer(parent.indentation);
+      write_item(writer, key, items, i);
+      buffers[i].swap(writer.buffer);
+      references[i].swap(writer.referenced_files);
+    }
+    parent.buffer += buffers[i];
+    std::string().swap(buffers[i]);
+    for (size_t j = 0 ; j < references[i].size() ; ++j) {
+      parent.referenceFile(references[i][j]);
+    }
+  }
+}
+
+void Writer::writeParallel(const Char* name, const void* items, size_t count, ItemWriter write_item) {
+  String key = singular_form(name);
+  if (count < min_items_for_threads || !pending_opened.empty()) {
+    // not worth the threads, or there are keys that the items would have to write first
+    for (size_t i = 0 ; i < count ; ++i) {
+      write_item(*this, key.c_str(), items, i);
     }
+  } else {
+    ParallelWriter(*this, key.c_str(), items, count, write_item).write();
   }
 }
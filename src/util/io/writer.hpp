@@ -16,6 +16,18 @@ template <typename T> class Defaultable;
 template <typename T> class Scriptable;
 DECLARE_POINTER_TYPE(Game);
 DECLARE_POINTER_TYPE(StyleSheet);
+DECLARE_POINTER_TYPE(Card);
+class ParallelWriter;
+
+// ----------------------------------------------------------------------------- : WrittenKey
+
+/// A key that was written directly in a block, see Writer::recordKeys
+struct WrittenKey {
+  String      key;    ///< The key, as it was written
+  String      value;  ///< The value of the key, if it is simple
+  bool        simple; ///< Was only a value written for the key, without child keys?
+  std::string text;   ///< The lines that were written for the key, in UTF-8
+};
 
 // ----------------------------------------------------------------------------- : Writer
 
@@ -23,10 +35,25 @@ typedef wxOutputStream  OutputStream;
 typedef shared_ptr<wxOutputStream> OutputStreamP;
 
 /// The Writer can be used for writing (serializing) objects
+/** The text is written as UTF-8 into a buffer, which is written to the output stream
+ *  in one go by flush() or when the writer is destroyed.
+ */
 class Writer {
   public:
   /// Construct a writer that writes to the given output stream
   Writer(const OutputStreamP& output, Version file_app_version);
+  ~Writer();
+  
+  /// Write everything written so far to the output stream
+  void flush();
+  
+  /// Number of bytes written to the output stream so far
+  inline size_t writtenSize() const { return written_size; }
+  /// CRC-32 checksum of the bytes written to the output stream so far
+  inline UInt   writtenCrc()  const { return written_crc; }
+  
+  /// Record the keys that are written directly in the next block, or stop recording if keys == nullptr
+  void recordKeys(vector<WrittenKey>* keys);
   
   /// Tell the reflection code we are not reading
   inline bool reading()   const { return false; }
@@ -72,6 +99,8 @@ class Writer {
   // special behaviour
   void handle(const GameP&);
   void handle(const StyleSheetP&);
+  /// Write cards, optionally also record the keys written for each card
+  void handle(const Char* name, const vector<CardP>& cards, vector<vector<WrittenKey> >* card_keys = nullptr);
   
   private:
   // --------------------------------------------------- : Data
@@ -80,10 +109,23 @@ class Writer {
   /// Blocks opened to which nothing has been written
   vector<const Char*> pending_opened;
   
-  /// Output stream we are writing to
+  /// Output stream we are writing to, nullptr for a writer that writes a part of the output of another writer
   OutputStreamP output;
-  /// Text stream wrapping the output stream
-  wxTextOutputStream stream;
+  /// Text that has not been written to the output stream yet, in UTF-8
+  std::string buffer;
+  /// Files referenced while writing a part, they are referenced when the part is added to the output
+  vector<String> referenced_files;
+  /// Size and checksum of what was written to the output stream
+  size_t written_size;
+  UInt   written_crc;
+  /// Where the keys are recorded, see recordKeys
+  vector<WrittenKey>* recorded_keys;
+  int                 record_indentation; ///< Indentation of the recorded keys
+  size_t              record_start;       ///< Start of the last recorded key in the buffer
+  
+  /// Construct a writer for a part of the output, starting at the given indentation
+  Writer(int indentation);
+  friend class ParallelWriter;
   
   // --------------------------------------------------- : Writing to the stream
   
@@ -96,6 +138,21 @@ class Writer {
   void writePending();
   /// Output some taps to represent the indentation level
   void writeIndentation();
+  /// Write a string to the buffer
+  void write(const String& str);
+  /// Write a line ending to the buffer
+  void writeNewline();
+  /// Reference a file that was written, in the writing_package
+  void referenceFile(const String& file);
+  
+  /// Function that writes item i of some items with the given key
+  typedef void (*ItemWriter)(Writer& writer, const Char* key, const void* items, size_t i);
+  /// Write the items of a vector, on multiple threads if there are enough of them
+  /** Each item is written into its own buffer, the buffers are added in order.
+   *  The items must be independent of each other. Of the dynamic arguments only clipboard_package
+   *  is passed on to the other threads, write_item must set any others that it needs.
+   */
+  void writeParallel(const Char* name, const void* items, size_t count, ItemWriter write_item);
 };
 
 // ----------------------------------------------------------------------------- : Container types
@@ -87,6 +87,8 @@ String tr(const Package&, const String& subcat, const String& key, DefaultLocale
 
 /// A localized string for tooltip labels, with 1 argument (printf style)
 #define _LABEL_1_(s,a)    format_string(_LABEL_(s),   a)
+/// A localized string for labels, with 2 argument (printf style)
+#define _LABEL_2_(s,a,b)  format_string(_LABEL_(s),   a, b)
 
 /// A localized string for button text, with 1 argument (printf style)
 #define _BUTTON_1_(s,a)    format_string(_BUTTON_(s), a)
@@ -0,0 +1,108 @@
+//+----------------------------------------------------------------------------+
+//| Description:  Magic Set Editor - Program to make Magic (tm) cards          |
+//| Copyright:    (C) 2001 - 2017 Twan van Laarhoven and Sean Hunt             |
+//| License:      GNU General Public License 2 or later (see file COPYING)     |
+//+----------------------------------------------------------------------------+
+
+// ----------------------------------------------------------------------------- : Includes
+
+#include <util/prec.hpp>
+#include <util/parallel.hpp>
+#include <util/io/package.hpp>
+#include <data/game.hpp>
+#include <data/stylesheet.hpp>
+#include <wx/thread.h>
+
+// ----------------------------------------------------------------------------- : ParallelLoop
+
+/// The state of a parallel_for loop, shared by all threads
+class ParallelLoop {
+  public:
+  ParallelLoop(size_t count, ParallelBody& body);
+  
+  /// Run all items, using at most the given number of threads (including this one)
+  void run(int jobs);
+  
+  private:
+  class Worker : public wxThread {
+    public:
+    Worker(ParallelLoop& owner) : wxThread(wxTHREAD_JOINABLE), owner(owner) {}
+    virtual ExitCode Entry();
+    private:
+    ParallelLoop& owner;
+  };
+  
+  size_t        count;
+  ParallelBody& body;
+  wxMutex       mutex;
+  size_t        next_item;       ///< First item that has not been taken by a thread
+  // dynamic arguments of the calling thread
+  Game*         game;            ///< game_for_reading
+  StyleSheet*   stylesheet;      ///< stylesheet_for_reading
+  Package*      writing;         ///< writing_package
+  Package*      clipboard;       ///< clipboard_package
+  
+  /// Take the next item, returns false if there are none left
+  bool next(size_t& i);
+  /// Take and run items until there are none left
+  void runItems();
+};
+
+ParallelLoop::ParallelLoop(size_t count, ParallelBody& body)
+  : count(count), body(body), next_item(0)
+  , game(game_for_reading()), stylesheet(stylesheet_for_reading())
+  , writing(writing_package()), clipboard(clipboard_package())
+{}
+
+bool ParallelLoop::next(size_t& i) {
+  wxMutexLocker lock(mutex);
+  if (next_item >= count) return false;
+  i = next_item++;
+  return true;
+}
+
+void ParallelLoop::runItems() {
+  size_t i;
+  while (next(i)) body.run(i);
+}
+
+wxThread::ExitCode ParallelLoop::Worker::Entry() {
+  WITH_DYNAMIC_ARG(game_for_reading,       owner.game);
+  WITH_DYNAMIC_ARG(stylesheet_for_reading, owner.stylesheet);
+  WITH_DYNAMIC_ARG(writing_package,        owner.writing);
+  WITH_DYNAMIC_ARG(clipboard_package,      owner.clipboard);
+  owner.runItems();
+  return 0;
+}
+
+void ParallelLoop::run(int jobs) {
+  // start worker threads, the calling thread also runs items
+  vector<Worker*> workers;
+  for (int j = 1 ; j < jobs ; ++j) {
+    Worker* worker = new Worker(*this);
+    if (worker->Create() != wxTHREAD_NO_ERROR || worker->Run() != wxTHREAD_NO_ERROR) {
+      delete worker;
+      break;
+    }
+    workers.push_back(worker);
+  }
+  runItems();
+  for (size_t j = 0 ; j < workers.size() ; ++j) {
+    workers[j]->Wait();
+    delete workers[j];
+  }
+}
+
+// ----------------------------------------------------------------------------- : parallel_for
+
+void parallel_for(size_t count, size_t min_items, ParallelBody& body) {
+  if (count < min_items || count < 2) {
+    // not worth the threads
+    for (size_t i = 0 ; i < count ; ++i) body.run(i);
+    return;
+  }
+  size_t cpus = (size_t)max(1, wxThread::GetCPUCount());
+  int jobs = (int)min(cpus, count * 4 / max((size_t)4, min_items));
+  ParallelLoop loop(count, body);
+  loop.run(jobs);
+}
@@ -0,0 +1,40 @@
+//+----------------------------------------------------------------------------+
+//| Description:  Magic Set Editor - Program to make Magic (tm) cards          |
+//| Copyright:    (C) 2001 - 2017 Twan van Laarhoven and Sean Hunt             |
+//| License:      GNU General Public License 2 or later (see file COPYING)     |
+//+----------------------------------------------------------------------------+
+
+#ifndef HEADER_UTIL_PARALLEL
+#define HEADER_UTIL_PARALLEL
+
+/** @file util/parallel.hpp
+ *
+ *  @brief Running the independent iterations of a loop on multiple threads.
+ */
+
+// ----------------------------------------------------------------------------- : Includes
+
+#include <util/prec.hpp>
+
+// ----------------------------------------------------------------------------- : parallel_for
+
+/// The body of a loop for parallel_for
+class ParallelBody {
+  public:
+  virtual ~ParallelBody() {}
+  /// Run the body for item i
+  /** Can be called from any thread, at the same time as for other items. Must not throw. */
+  virtual void run(size_t i) = 0;
+};
+
+/// Call body.run(i) for all i < count, on multiple threads if there are at least min_items items
+/** Each thread gets at least min_items/4 items. The calling thread also runs items,
+ *  parallel_for returns when all items are done.
+ *
+ *  The worker threads get the values that the dynamic arguments for reading and writing files have on the calling thread:
+ *  game_for_reading, stylesheet_for_reading, writing_package and clipboard_package.
+ */
+void parallel_for(size_t count, size_t min_items, ParallelBody& body);
+
+// ----------------------------------------------------------------------------- : EOF
+#endif
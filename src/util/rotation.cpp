@@ -9,7 +9,9 @@
 #include <util/prec.hpp>
 #include <util/rotation.hpp>
 #include <gfx/gfx.hpp>
+#include <gfx/canvas.hpp>
 #include <data/font.hpp>
+#include <gui/util.hpp>
 
 // ----------------------------------------------------------------------------- : Rotation
 
@@ -172,18 +174,86 @@ Rotater::~Rotater() {
 
 RotatedDC::RotatedDC(DC& dc, Radians angle, const RealRect& rect, double zoom, RenderQuality quality, RotationFlags flags)
   : Rotation(angle, rect, zoom, 1.0, flags)
-  , dc(dc), quality(quality)
+  , dc(&dc), quality(quality), canvas(nullptr)
 {}
 
 RotatedDC::RotatedDC(DC& dc, const Rotation& rotation, RenderQuality quality)
   : Rotation(rotation)
-  , dc(dc), quality(quality)
+  , dc(&dc), quality(quality), canvas(nullptr)
 {}
 
+RotatedDC::RotatedDC(ImageCanvas& canvas, const Rotation& rotation, RenderQuality quality)
+  : Rotation(rotation)
+  , dc(nullptr), quality(max(quality, QUALITY_AA)), canvas(&canvas)
+  , pen(*wxBLACK_PEN), brush(*wxWHITE_BRUSH), text_color(*wxBLACK), font(*wxNORMAL_FONT)
+{}
+
+// ----------------------------------------------------------------------------- : RotatedDC : Canvas helpers
+
+/// Color of a pen, fully transparent if nothing should be drawn
+AColor pen_color(const wxPen& pen) {
+  if (!pen.IsOk() || pen.IsTransparent()) return AColor();
+  return AColor(pen.GetColour());
+}
+AColor brush_color(const wxBrush& brush) {
+  if (!brush.IsOk() || brush.IsTransparent()) return AColor();
+  return AColor(brush.GetColour());
+}
+double pen_width(const wxPen& pen) {
+  return max(1, pen.GetWidth());
+}
+
+/// Add points on an elliptic arc around center, counterclockwise from start to end
+/** If closed the end point is not included, because it is the same as the start point */
+void add_arc_points(vector<RealPoint>& out, const RealPoint& center, double rx, double ry, Radians start, Radians end, bool closed = false) {
+  // about one segment per pixel
+  int steps = max(4, min(256, (int)((rx + ry) * 0.5 * (end - start))));
+  for (int i = 0 ; i < steps + (closed ? 0 : 1) ; ++i) {
+    Radians a = start + (end - start) * i / steps;
+    out.push_back(RealPoint(center.x + rx * cos(a), center.y - ry * sin(a)));
+  }
+}
+
+/// Add the corners of a rectangle with rounded corners
+void add_rounded_rect_points(vector<RealPoint>& out, const RealRect& r, double radius) {
+  radius = min(radius, min(r.width, r.height) * 0.5);
+  if (radius <= 0) {
+    out.push_back(r.topLeft());
+    out.push_back(r.bottomLeft());
+    out.push_back(r.bottomRight());
+    out.push_back(r.topRight());
+  } else {
+    add_arc_points(out, RealPoint(r.left()  + radius, r.top()    + radius), radius, radius, 0.5 * M_PI, 1.0 * M_PI);
+    add_arc_points(out, RealPoint(r.left()  + radius, r.bottom() - radius), radius, radius, 1.0 * M_PI, 1.5 * M_PI);
+    add_arc_points(out, RealPoint(r.right() - radius, r.bottom() - radius), radius, radius, 1.5 * M_PI, 2.0 * M_PI);
+    add_arc_points(out, RealPoint(r.right() - radius, r.top()    + radius), radius, radius, 0.0 * M_PI, 0.5 * M_PI);
+  }
+}
+
+void RotatedDC::canvasShape(const vector<RealPoint>& points, bool closed) {
+  if (closed) canvas->fillPolygon(points, brush_color(brush));
+  canvas->strokePolyline(points, pen_width(pen), pen_color(pen), closed);
+}
+
+/// Draw a straight rectangle with the pixel rectangle r, like wxDC::DrawRoundedRectangle does
+void canvas_rectangle(ImageCanvas& canvas, const wxPen& pen, const wxBrush& brush, const wxRect& r, double radius) {
+  vector<RealPoint> points;
+  if (radius <= 0) {
+    canvas.fillRect(r, brush_color(brush));
+  } else {
+    add_rounded_rect_points(points, RealRect(r.x, r.y, r.width, r.height), radius);
+    canvas.fillPolygon(points, brush_color(brush));
+    points.clear();
+  }
+  // the outline goes through the centers of the outer pixels
+  add_rounded_rect_points(points, RealRect(r.x + 0.5, r.y + 0.5, r.width - 1, r.height - 1), radius - 0.5);
+  canvas.strokePolyline(points, pen_width(pen), pen_color(pen));
+}
+
 // ----------------------------------------------------------------------------- : RotatedDC : Drawing
 
 void RotatedDC::DrawText  (const String& text, const RealPoint& pos, int blur_radius, int boldness, double stretch_) {
-  DrawText(text, pos, dc.GetTextForeground(), blur_radius, boldness, stretch_);
+  DrawText(text, pos, canvas ? text_color : dc->GetTextForeground(), blur_radius, boldness, stretch_);
 }
 
 void RotatedDC::DrawText  (const String& text, const RealPoint& pos, AColor color, int blur_radius, int boldness, double stretch_) {
@@ -202,19 +272,23 @@ void RotatedDC::DrawText  (const String& text, const RealPoint& pos, AColor colo
       r_ext.x = r_ext2.x;
       r_ext.y = r_ext2.y;
     }
-    draw_resampled_text(dc, pos2, r_ext, stretch_, angle, color, text, blur_radius, boldness);
+    if (canvas) {
+      draw_resampled_text(*canvas, font, pos2, r_ext, stretch_, angle, color, text, blur_radius, boldness);
+    } else {
+      draw_resampled_text(*dc, pos2, r_ext, stretch_, angle, color, text, blur_radius, boldness);
+    }
   } else if (quality >= QUALITY_SUB_PIXEL) {
     RealPoint p_ext = tr(pos)*text_scaling;
     double usx,usy;
-    dc.GetUserScale(&usx, &usy);
-    dc.SetUserScale(usx/text_scaling, usy/text_scaling);
-    dc.SetTextForeground(color);
-    dc.DrawRotatedText(text, (int) p_ext.x, (int) p_ext.y, rad_to_deg(angle));
-    dc.SetUserScale(usx, usy);
+    dc->GetUserScale(&usx, &usy);
+    dc->SetUserScale(usx/text_scaling, usy/text_scaling);
+    dc->SetTextForeground(color);
+    dc->DrawRotatedText(text, (int) p_ext.x, (int) p_ext.y, rad_to_deg(angle));
+    dc->SetUserScale(usx, usy);
   } else {
     RealPoint p_ext = tr(pos);
-    dc.SetTextForeground(color);
-    dc.DrawRotatedText(text, (int) p_ext.x, (int) p_ext.y, rad_to_deg(angle));
+    dc->SetTextForeground(color);
+    dc->DrawRotatedText(text, (int) p_ext.x, (int) p_ext.y, rad_to_deg(angle));
   }
 }
 
@@ -224,9 +298,9 @@ void RotatedDC::DrawTextWithShadow(const String& text, const Font& font, const R
 }
 
 void RotatedDC::DrawBitmap(const Bitmap& bitmap, const RealPoint& pos) {
-  if (is_rad0(angle)) {
+  if (is_rad0(angle) && !canvas) {
     RealPoint p_ext = tr(pos);
-    dc.DrawBitmap(bitmap, to_int(p_ext.x), to_int(p_ext.y), true);
+    dc->DrawBitmap(bitmap, to_int(p_ext.x), to_int(p_ext.y), true);
   } else {
     DrawImage(bitmap.ConvertToImage(), pos);
   }
@@ -237,64 +311,193 @@ void RotatedDC::DrawImage(const Image& image, const RealPoint& pos, ImageCombine
 }
 void RotatedDC::DrawPreRotatedBitmap(const Bitmap& bitmap, const RealRect& rect) {
   RealPoint p_ext = tr(rect.position()) + boundingBoxCorner(rect.size());
-  dc.DrawBitmap(bitmap, to_int(p_ext.x), to_int(p_ext.y), true);
+  if (canvas) {
+    canvas->drawImage(bitmap.ConvertToImage(), to_int(p_ext.x), to_int(p_ext.y));
+  } else {
+    dc->DrawBitmap(bitmap, to_int(p_ext.x), to_int(p_ext.y), true);
+  }
 }
 void RotatedDC::DrawPreRotatedImage (const Image& image, const RealRect& rect, ImageCombine combine) {
   RealPoint p_ext = tr(rect.position()) + boundingBoxCorner(rect.size());
-  draw_combine_image(dc, to_int(p_ext.x), to_int(p_ext.y), image, combine);
+  if (canvas) {
+    canvas->drawImage(image, to_int(p_ext.x), to_int(p_ext.y), combine);
+  } else {
+    draw_combine_image(*dc, to_int(p_ext.x), to_int(p_ext.y), image, combine);
+  }
 }
 
 void RotatedDC::DrawLine  (const RealPoint& p1,  const RealPoint& p2) {
   wxPoint p1_ext = tr(p1), p2_ext = tr(p2);
-  dc.DrawLine(p1_ext.x, p1_ext.y, p2_ext.x, p2_ext.y);
+  if (canvas) {
+    vector<RealPoint> points;
+    points.push_back(RealPoint(p1_ext.x + 0.5, p1_ext.y + 0.5));
+    points.push_back(RealPoint(p2_ext.x + 0.5, p2_ext.y + 0.5));
+    canvasShape(points, false);
+  } else {
+    dc->DrawLine(p1_ext.x, p1_ext.y, p2_ext.x, p2_ext.y);
+  }
 }
 
 void RotatedDC::DrawRectangle(const RealRect& r) {
-  if (is_straight(angle)) {
+  if (is_straight(angle) && canvas) {
+    canvas_rectangle(*canvas, pen, brush, trRectToBB(r), 0);
+  } else if (is_straight(angle)) {
     wxRect r_ext = trRectToBB(r);
-    dc.DrawRectangle(r_ext.x, r_ext.y, r_ext.width, r_ext.height);
+    dc->DrawRectangle(r_ext.x, r_ext.y, r_ext.width, r_ext.height);
+  } else if (canvas) {
+    vector<RealPoint> points;
+    points.push_back(tr(RealPoint(r.left(),  r.top()   )));
+    points.push_back(tr(RealPoint(r.left(),  r.bottom())));
+    points.push_back(tr(RealPoint(r.right(), r.bottom())));
+    points.push_back(tr(RealPoint(r.right(), r.top()   )));
+    canvasShape(points);
   } else {
     wxPoint points[4] = {trPixel(RealPoint(r.left(),  r.top()   ))
                         ,trPixel(RealPoint(r.left(),  r.bottom()))
                         ,trPixel(RealPoint(r.right(), r.bottom()))
                         ,trPixel(RealPoint(r.right(), r.top()   ))};
-    dc.DrawPolygon(4,points);
+    dc->DrawPolygon(4,points);
   }
 }
 
 void RotatedDC::DrawRoundedRectangle(const RealRect& r, double radius) {
-  if (is_straight(angle)) {
+  if (is_straight(angle) && canvas) {
+    canvas_rectangle(*canvas, pen, brush, trRectToBB(r), trS(radius));
+  } else if (is_straight(angle)) {
     wxRect r_ext = trRectToBB(r);
-    dc.DrawRoundedRectangle(r_ext.x, r_ext.y, r_ext.width, r_ext.height, trS(radius));
+    dc->DrawRoundedRectangle(r_ext.x, r_ext.y, r_ext.width, r_ext.height, trS(radius));
   } else {
     // TODO
     DrawRectangle(r);
   }
 }
 
+void RotatedDC::DrawRoundedRectangleFrame(const RealRect& outer, const RealRect& inner, double radius) {
+  if (canvas) {
+    // a single even-odd polygon: the outer outline, then the inner one as a hole
+    vector<RealPoint> points;
+    if (is_straight(angle)) {
+      wxRect o = trRectToBB(outer), i = trRectToBB(inner);
+      add_rounded_rect_points(points, RealRect(o.x, o.y, o.width, o.height), trS(radius));
+      points.push_back(points.front());
+      add_rounded_rect_points(points, RealRect(i.x, i.y, i.width, i.height), 0);
+    } else {
+      points.push_back(tr(RealPoint(outer.left(),  outer.top()   )));
+      points.push_back(tr(RealPoint(outer.left(),  outer.bottom())));
+      points.push_back(tr(RealPoint(outer.right(), outer.bottom())));
+      points.push_back(tr(RealPoint(outer.right(), outer.top()   )));
+      points.push_back(points.front());
+      points.push_back(tr(RealPoint(inner.left(),  inner.top()   )));
+      points.push_back(tr(RealPoint(inner.left(),  inner.bottom())));
+      points.push_back(tr(RealPoint(inner.right(), inner.bottom())));
+      points.push_back(tr(RealPoint(inner.right(), inner.top()   )));
+    }
+    points.push_back(points[points.size() - 4]);
+    canvas->fillPolygon(points, brush_color(brush));
+  } else {
+    // clip away the inside of the rectangle
+    wxRegion r = trRectToRegion(outer);
+    r.Subtract(trRectToRegion(inner));
+    dc->SetDeviceClippingRegion(r);
+    DrawRoundedRectangle(outer, radius);
+    dc->DestroyClippingRegion();
+  }
+}
+
+void RotatedDC::DrawPreRotatedPolygon(const vector<wxPoint>& points) {
+  if (points.empty()) return;
+  if (canvas) {
+    vector<RealPoint> real_points;
+    real_points.reserve(points.size());
+    for (size_t i = 0 ; i < points.size() ; ++i) {
+      real_points.push_back(RealPoint(points[i].x + 0.5, points[i].y + 0.5));
+    }
+    canvasShape(real_points);
+  } else {
+    dc->DrawPolygon((int)points.size(), &points[0]);
+  }
+}
+
+void RotatedDC::DrawCheckbox(const RealRect& r, bool checked) {
+  wxRect r_ext = trRectToBB(r);
+  if (canvas) {
+    // same as the portable version of draw_checkbox
+    Color color = wxSystemSettings::GetColour(wxSYS_COLOUR_WINDOWTEXT);
+    if (checked) {
+      vector<RealPoint> points;
+      points.push_back(RealPoint(r_ext.x + r_ext.width * 0.25, r_ext.y + r_ext.height * 0.5 ));
+      points.push_back(RealPoint(r_ext.x + r_ext.width * 0.45, r_ext.y + r_ext.height * 0.75));
+      points.push_back(RealPoint(r_ext.x + r_ext.width * 0.8,  r_ext.y + r_ext.height * 0.25));
+      canvas->strokePolyline(points, max(1.0, r_ext.width / 6.0), color, false);
+    }
+    SetPen(color);
+    SetBrush(*wxTRANSPARENT_BRUSH);
+    canvas_rectangle(*canvas, pen, brush, r_ext, 0);
+  } else {
+    draw_checkbox(nullptr, *dc, r_ext, checked);
+  }
+}
+
 void RotatedDC::DrawCircle(const RealPoint& center, double radius) {
+  if (canvas) {
+    vector<RealPoint> points;
+    add_arc_points(points, tr(center), trS(radius), trS(radius), 0, 2 * M_PI, true);
+    canvasShape(points);
+    return;
+  }
   wxPoint p = tr(center);
-  dc.DrawCircle(p.x + 1, p.y + 1, int(trS(radius)));
+  dc->DrawCircle(p.x + 1, p.y + 1, int(trS(radius)));
 }
 
 void RotatedDC::DrawEllipse(const RealPoint& center, const RealSize& size) {
+  if (canvas) {
+    RealSize s_ext = trSizeToBB(size);
+    vector<RealPoint> points;
+    add_arc_points(points, tr(center), 0.5 * s_ext.width, 0.5 * s_ext.height, 0, 2 * M_PI, true);
+    canvasShape(points);
+    return;
+  }
   wxPoint c_ext = tr(center - size/2);
   wxSize  s_ext = trSizeToBB(size);
-  dc.DrawEllipse(c_ext.x, c_ext.y, s_ext.x, s_ext.y);
+  dc->DrawEllipse(c_ext.x, c_ext.y, s_ext.x, s_ext.y);
 }
 void RotatedDC::DrawEllipticArc(const RealPoint& center, const RealSize& size, Radians start, Radians end) {
+  if (canvas) {
+    RealSize  s_ext = trSizeToBB(size);
+    RealPoint c_ext = tr(center);
+    start += angle;
+    end   += angle;
+    if (end <= start) end += 2 * M_PI;
+    // the pie is filled with the brush, only the arc itself is drawn with the pen
+    vector<RealPoint> points;
+    add_arc_points(points, c_ext, 0.5 * s_ext.width, 0.5 * s_ext.height, start, end);
+    points.push_back(c_ext);
+    canvas->fillPolygon(points, brush_color(brush));
+    points.pop_back();
+    canvasShape(points, false);
+    return;
+  }
   wxPoint c_ext = tr(center - size/2);
   wxSize  s_ext = trSizeToBB(size);
-  dc.DrawEllipticArc(c_ext.x, c_ext.y, s_ext.x, s_ext.y, rad_to_deg(start + angle), rad_to_deg(end + angle));
+  dc->DrawEllipticArc(c_ext.x, c_ext.y, s_ext.x, s_ext.y, rad_to_deg(start + angle), rad_to_deg(end + angle));
 }
 void RotatedDC::DrawEllipticSpoke(const RealPoint& center, const RealSize& size, Radians angle) {
-  wxPoint c_ext = tr(center - size/2);
-  wxSize  s_ext = trSizeToBB(size);
   Radians rot_angle = angle + this->angle;
   Radians sin_angle = sin(rot_angle), cos_angle = cos(rot_angle);
+  if (canvas) {
+    RealSize  s_ext = trSizeToBB(size);
+    RealPoint c_ext = tr(center);
+    vector<RealPoint> points;
+    points.push_back(c_ext);
+    points.push_back(RealPoint(c_ext.x + 0.5 * s_ext.width * cos_angle, c_ext.y - 0.5 * s_ext.height * sin_angle));
+    canvasShape(points, false);
+    return;
+  }
+  wxPoint c_ext = tr(center - size/2);
+  wxSize  s_ext = trSizeToBB(size);
   // position of center and of point on the boundary can vary because of rounding errors,
   // this code matches DrawEllipticArc (at least on windows xp).
-  dc.DrawLine(
+  dc->DrawLine(
     c_ext.x + int(       0.5 * (s_ext.x + cos_angle) ), // center
     c_ext.y + int(       0.5 * (s_ext.y - sin_angle) ),
     c_ext.x + int( 0.5 + 0.5 * (s_ext.x-1) * (1 + cos_angle) ), // boundary
@@ -302,28 +505,54 @@ void RotatedDC::DrawEllipticSpoke(const RealPoint& center, const RealSize& size,
   );
 }
 
+void RotatedDC::Fill() {
+  SetPen(*wxTRANSPARENT_PEN);
+  if (canvas) {
+    canvas->clear(brush_color(brush));
+  } else {
+    wxSize size = dc->GetSize();
+    wxPoint pos = dc->GetDeviceOrigin();
+    dc->DrawRectangle(-pos.x, -pos.y, size.GetWidth(), size.GetHeight());
+  }
+}
+
 // ----------------------------------------------------------------------------- : Forwarded properties
 
-void RotatedDC::SetPen(const wxPen& pen)              { dc.SetPen(pen); }
-void RotatedDC::SetBrush(const wxBrush& brush)        { dc.SetBrush(brush); }
-void RotatedDC::SetTextForeground(const Color& color) { dc.SetTextForeground(color); }
-void RotatedDC::SetLogicalFunction(wxRasterOperationMode function)      { dc.SetLogicalFunction(function); }
+void RotatedDC::SetPen(const wxPen& pen) {
+  if (canvas) this->pen = pen;
+  else        dc->SetPen(pen);
+}
+void RotatedDC::SetBrush(const wxBrush& brush) {
+  if (canvas) this->brush = brush;
+  else        dc->SetBrush(brush);
+}
+void RotatedDC::SetTextForeground(const Color& color) {
+  if (canvas) text_color = color;
+  else        dc->SetTextForeground(color);
+}
+void RotatedDC::SetLogicalFunction(wxRasterOperationMode function) {
+  if (!canvas) dc->SetLogicalFunction(function); // the canvas only draws normally
+}
 
 void RotatedDC::SetFont(const wxFont& font) {
+  wxFont scaled = font;
   if (quality == QUALITY_LOW && zoomX == 1 && zoomY == 1) {
-    dc.SetFont(font);
+    // no scaling needed
+  } else if (quality == QUALITY_LOW) {
+    scaled.SetPointSize((int)  trY(font.GetPointSize()));
   } else {
-    wxFont scaled = font;
-    if (quality == QUALITY_LOW) {
-      scaled.SetPointSize((int)  trY(font.GetPointSize()));
-    } else {
-      scaled.SetPointSize((int) (trY(font.GetPointSize()) * text_scaling));
-    }
-    dc.SetFont(scaled);
+    scaled.SetPointSize((int) (trY(font.GetPointSize()) * text_scaling));
   }
+  if (canvas) this->font = scaled;
+  else        dc->SetFont(scaled);
 }
 void RotatedDC::SetFont(const Font& font, double scale) {
-  dc.SetFont(font.toWxFont(trS(scale) * (quality == QUALITY_LOW ? 1 : text_scaling)));
+  wxFont scaled = font.toWxFont(trS(scale) * (quality == QUALITY_LOW ? 1 : text_scaling));
+  if (canvas) this->font = scaled;
+  else        dc->SetFont(scaled);
+}
+const wxFont& RotatedDC::GetFont() const {
+  return canvas ? font : dc->GetFont();
 }
 
 double RotatedDC::getFontSizeStep() const {
@@ -334,12 +563,20 @@ double RotatedDC::getFontSizeStep() const {
   }
 }
 
+void RotatedDC::measureText(const String& text, int* w, int* h) const {
+  if (canvas) get_text_extent(font, text, w, h);
+  else        dc->GetTextExtent(text, w, h);
+}
+int RotatedDC::measureCharHeight() const {
+  return canvas ? get_char_height(font) : dc->GetCharHeight();
+}
+
 RealSize RotatedDC::GetTextExtent(const String& text) const {
   int w, h;
-  dc.GetTextExtent(text, &w, &h);
+  measureText(text, &w, &h);
   #ifdef __WXGTK__
     // HACK: Some fonts don't get the descender height set correctly.
-    int charHeight = dc.GetCharHeight();
+    int charHeight = measureCharHeight();
     if (charHeight != h)
       h += h - charHeight;
   #endif
@@ -350,11 +587,11 @@ RealSize RotatedDC::GetTextExtent(const String& text) const {
   }
 }
 double RotatedDC::GetCharHeight() const {
-  int h = dc.GetCharHeight();
+  int h = measureCharHeight();
   #ifdef __WXGTK__
     // See above HACK
     int extent;
-    dc.GetTextExtent(_("H"), 0, &extent);
+    measureText(_("H"), 0, &extent);
     if (h != extent)
       h = 2 * extent - h;
   #endif
@@ -366,20 +603,30 @@ double RotatedDC::GetCharHeight() const {
 }
 
 void RotatedDC::SetClippingRegion(const RealRect& rect) {
-  dc.SetDeviceClippingRegion(trRectToRegion(rect));
+  if (canvas) {
+    // the canvas can only clip to rectangles, use the bounding box
+    canvas->setClip(trRectToBB(rect));
+  } else {
+    dc->SetDeviceClippingRegion(trRectToRegion(rect));
+  }
 }
 void RotatedDC::DestroyClippingRegion() {
-  dc.DestroyClippingRegion();
+  if (canvas) {
+    canvas->resetClip();
+  } else {
+    dc->DestroyClippingRegion();
+  }
 }
 
 // ----------------------------------------------------------------------------- : Other
 
 Bitmap RotatedDC::GetBackground(const RealRect& r) {
   wxRect wr = trRectToBB(r);
+  if (canvas) return Bitmap(canvas->getSubImage(wr));
   Bitmap background(wr.width, wr.height);
   wxMemoryDC mdc;
   mdc.SelectObject(background);
-  mdc.Blit(0, 0, wr.width, wr.height, &dc, wr.x, wr.y);
+  mdc.Blit(0, 0, wr.width, wr.height, dc, wr.x, wr.y);
   mdc.SelectObject(wxNullBitmap);
   return background;
 }
@@ -14,6 +14,7 @@
 #include <gfx/gfx.hpp>
 
 class Font;
+class ImageCanvas;
 
 // ----------------------------------------------------------------------------- : Rotation
 
@@ -149,11 +150,17 @@ enum RenderQuality {
 
 /// A DC with rotation applied
 /** All draw** functions take internal coordinates.
+ *
+ *  Instead of to a DC, drawing can go to an ImageCanvas.
+ *  The font, pen and brush are then kept by the RotatedDC itself,
+ *  and text is measured with get_text_extent, the same way it is rendered.
  */
 class RotatedDC : public Rotation {
   public:
   RotatedDC(DC& dc, Radians angle, const RealRect& rect, double zoom, RenderQuality quality, RotationFlags flags = ROTATION_NORMAL);
   RotatedDC(DC& dc, const Rotation& rotation, RenderQuality quality);
+  /// Draw to a canvas, text is always anti aliased
+  RotatedDC(ImageCanvas& canvas, const Rotation& rotation, RenderQuality quality);
   
   // --------------------------------------------------- : Drawing
   
@@ -174,6 +181,12 @@ class RotatedDC : public Rotation {
   void DrawLine  (const RealPoint& p1,  const RealPoint& p2);
   void DrawRectangle(const RealRect& r);
   void DrawRoundedRectangle(const RealRect& r, double radius);
+  /// Fill a rounded rectangle with the brush, except for the inner rectangle
+  void DrawRoundedRectangleFrame(const RealRect& outer, const RealRect& inner, double radius);
+  /// Draw a polygon with corners that are already in external coordinates
+  void DrawPreRotatedPolygon(const vector<wxPoint>& points);
+  /// Draw a checkbox like draw_checkbox, changes the pen and brush
+  void DrawCheckbox(const RealRect& r, bool checked);
   void DrawCircle(const RealPoint& center, double radius);
   void DrawEllipse(const RealPoint& center, const RealSize& size);
   /// Draw an arc of an ellipse, angles are in radians
@@ -181,7 +194,7 @@ class RotatedDC : public Rotation {
   /// Draw spokes of an ellipse
   void DrawEllipticSpoke(const RealPoint& center, const RealSize& size, Radians start);
   
-  // Fill the dc with the color of the current brush
+  /// Fill the dc with the color of the current brush
   void Fill();
   
   // --------------------------------------------------- : Properties
@@ -193,6 +206,8 @@ class RotatedDC : public Rotation {
   void SetLogicalFunction(wxRasterOperationMode function);
   
   void SetFont(const wxFont& font);
+  /// The current font, as scaled by SetFont
+  const wxFont& GetFont() const;
   /// Set the font, scales for zoom and high_quality
   /** The font size will be multiplied by 'scale' */
   void SetFont(const Font& font, double scale);
@@ -210,11 +225,27 @@ class RotatedDC : public Rotation {
   /// Get the current contents of the given ractangle, for later restoring
   Bitmap GetBackground(const RealRect& r);
   
-  inline wxDC& getDC() { return dc; }
+  /// The dc, there is none when drawing to a canvas
+  inline wxDC& getDC() { assert(dc); return *dc; }
+  /// The quality used for rendering text
+  inline RenderQuality getQuality() const { return quality; }
   
   private:
-  wxDC& dc;        ///< The actual dc
+  wxDC* dc;        ///< The actual dc, or nullptr when drawing to a canvas
   RenderQuality quality;  ///< Quality of the text
+  ImageCanvas* canvas;  ///< Canvas to draw on instead of the dc, if any
+  // state when drawing to a canvas
+  wxPen   pen;
+  wxBrush brush;
+  Color   text_color;
+  wxFont  font;
+  
+  /// Measure text in the current font, in external coordinates
+  void measureText(const String& text, int* w, int* h) const;
+  int  measureCharHeight() const;
+  
+  /// Fill a polygon in external coordinates with the brush, and draw its outline with the pen, on the canvas
+  void canvasShape(const vector<RealPoint>& points, bool closed = true);
 };
 
 // ----------------------------------------------------------------------------- : EOF